@@ -23,6 +23,16 @@
 #define IncludeSonyGetName 1
 #define IncludeSonyNew 0
 #define IncludeSonyNameNew 0
+#define IncludeSCSIDisks 1
+#ifndef WantSaveStates
+#define WantSaveStates 1
+#endif
+#ifndef WantRewind
+#define WantRewind 1
+#endif
+#ifndef WantVarRAMSize
+#define WantVarRAMSize 1
+#endif
 
 //#define vMacScreenWidth 512
 //#define vMacScreenHeight 384
@@ -31,3 +31,8 @@
 #define UseControlKeys 1
 #define UseActvCode 0
 #define EnableDemoMsg 0
+#define WantScreenRecord 0
+#define WantCompressedDisks 1
+#define WantDiskOverlays 1
+#define WantFolderVolumes 1
+#define WantFastBoot 1
@@ -25,12 +25,22 @@
 
 #define WantCycByPriOp 1
 #define WantCloserCyc 0
+#define WantFastDelayLoops 1
 
 #define kAutoSlowSubTicks 16384
 #define kAutoSlowTime 34
 
+#if WantVarRAMSize
+#define kRAMa_Size RAMa_Size
+#define kRAMb_Size RAMb_Size
+#else
 #define kRAMa_Size 0x00200000
 #define kRAMb_Size 0x00200000
+#endif
+#define WantRAMDirtyMap 1
+#define kRewindBufSize 0x00100000
+#define kRewindTicks 30
+#define kRewindMaxStates 20
 
 #if vMacScreenWidth != 512
 #define IncludeVidMem 1
@@ -45,8 +55,9 @@
 
 #define Sony_SupportDC42 1
 #define Sony_SupportTags 0
-#define Sony_WantChecksumsUpdated 0
+#define Sony_WantChecksumsUpdated 1
 #define Sony_VerifyChecksums 0
+#define Sony_AsyncIO 1
 #define CaretBlinkTime 0x03
 #define SpeakerVol 0x07
 #define DoubleClickTime 0x05
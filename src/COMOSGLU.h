@@ -41,6 +41,9 @@ LOCALVAR blnr ROM_loaded = falseblnr;
 
 GLOBALVAR ui5b vSonyWritableMask = 0;
 GLOBALVAR ui5b vSonyInsertedMask = 0;
+#if IncludeSCSIDisks
+GLOBALVAR ui5b vSCSIDiskMask = 0;
+#endif
 
 #if IncludeSonyRawMode
 GLOBALVAR blnr vSonyRawMode = falseblnr;
@@ -252,6 +255,9 @@ LOCALPROC DiskEjectedNotify(tDrive Drive_No)
 {
 	vSonyWritableMask &= ~ ((ui5b)1 << Drive_No);
 	vSonyInsertedMask &= ~ ((ui5b)1 << Drive_No);
+#if IncludeSCSIDisks
+	vSCSIDiskMask &= ~ ((ui5b)1 << Drive_No);
+#endif
 }
 
 /*
@@ -652,6 +658,23 @@ LOCALVAR si4b ScreenChangedQuietBottom = 0;
 LOCALVAR si4b ScreenChangedQuietRight = 0;
 #endif
 
+#ifndef WantScreenRecord
+#define WantScreenRecord 0
+#endif
+
+#if WantScreenRecord
+#include "SCRNRCRD.h"
+#endif
+
+#ifndef MayAsyncVideo
+#define MayAsyncVideo 0
+#endif
+
+#if MayAsyncVideo
+LOCALVAR blnr UseAsyncVideo = falseblnr;
+FORWARDPROC AsyncVideo_Publish(ui3p screencurrentbuff);
+#endif
+
 GLOBALOSGLUPROC Screen_OutputFrame(ui3p screencurrentbuff)
 {
 	si4b top;
@@ -659,10 +682,25 @@ GLOBALOSGLUPROC Screen_OutputFrame(ui3p screencurrentbuff)
 	si4b bottom;
 	si4b right;
 
+#if WantScreenRecord
+	++ScrnRecTick;
+#endif
+#if MayAsyncVideo
+	if (UseAsyncVideo) {
+		/* finding changes is done by the video thread */
+		if (! EmVideoDisable) {
+			AsyncVideo_Publish(screencurrentbuff);
+		}
+		return;
+	}
+#endif
 	if (! EmVideoDisable) {
 		if (ScreenFindChanges(screencurrentbuff, EmLagTime,
 			&top, &left, &bottom, &right))
 		{
+#if WantScreenRecord
+			ScrnRec_Frame(screencurrentbuff, top, left, bottom, right);
+#endif
 			if (top < ScreenChangedTop) {
 				ScreenChangedTop = top;
 			}
@@ -65,9 +65,27 @@ typedef si5r simr;
 #define my_osglu_call
 #endif
 
-#define LOCALVAR static
-#define GLOBALVAR
-#define EXPORTVAR(t, v) extern t v;
+#ifndef WantMachinePerThread
+#define WantMachinePerThread 0
+#endif
+
+#if WantMachinePerThread
+/*
+	Every variable declared with the macros below, in the
+	emulator and in the OSGLU, is thread local. So each thread
+	that initializes and runs the emulation has a machine of its
+	own, and a host can run several at once on several threads.
+	An OSGLU that starts threads of its own to share its
+	variables with can't be used like this.
+*/
+#define MyThreadLocal _Thread_local
+#else
+#define MyThreadLocal
+#endif
+
+#define LOCALVAR static MyThreadLocal
+#define GLOBALVAR MyThreadLocal
+#define EXPORTVAR(t, v) extern MyThreadLocal t v;
 
 #define LOCALFUNC static MayNotInline
 #define FORWARDFUNC LOCALFUNC
@@ -0,0 +1,116 @@
+/*
+	DISKMMAP.h
+
+	Copyright (C) 2023 Jesús A. Álvarez
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	DISK images Memory MAPped
+
+	Included by POSIX OSGLUs when MayMapDisks is set. Each inserted
+	image is mapped with mmap, and vSonyTransfer copies directly
+	between the mapping and the emulated memory that SONYEMDV.c
+	passes in, instead of a seek and a read or write system call
+	for every request. Images that can't be mapped keep using
+	the file.
+
+	Changes are written back by the system, and forced out with
+	msync when the disk is ejected, including on quitting. As with
+	any mapping, the image file must not be truncated by another
+	program while it is inserted.
+
+	An image can also be mapped copy-on-write (MAP_PRIVATE), from
+	a file opened read only: the Mac can write to it, but the
+	changes stay in this process and are gone when it is ejected.
+*/
+
+#ifdef DISKMMAP_H
+#error "header already included"
+#else
+#define DISKMMAP_H
+#endif
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+LOCALVAR ui3p DriveMaps[NumDrives]; /* nullpr if not mapped */
+LOCALVAR ui5r DriveMapSizes[NumDrives];
+
+/* returns false if not mapped, the file is used instead */
+LOCALFUNC blnr DiskMap_Open(tDrive Drive_No, int fd, blnr locked,
+	blnr private_copy)
+{
+	struct stat st;
+	void *p;
+
+	DriveMaps[Drive_No] = nullpr;
+	if ((0 == fstat(fd, &st)) && (st.st_size > 0)
+		&& (st.st_size <= (off_t)0xFFFFFFFF))
+	{
+		p = mmap(NULL, st.st_size,
+			locked ? PROT_READ : (PROT_READ | PROT_WRITE),
+			private_copy ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+		if (MAP_FAILED != p) {
+#ifdef MADV_SEQUENTIAL
+			/* Sony_Prime mostly reads files front to back */
+			(void) madvise(p, st.st_size, MADV_SEQUENTIAL);
+#endif
+			DriveMaps[Drive_No] = (ui3p)p;
+			DriveMapSizes[Drive_No] = st.st_size;
+		}
+	}
+
+	return nullpr != DriveMaps[Drive_No];
+}
+
+LOCALFUNC tMacErr DiskMap_Transfer(blnr IsWrite, ui3p Buffer,
+	tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count,
+	ui5r *Sony_ActCount)
+{
+	tMacErr err = mnvm_miscErr;
+	ui3p p = DriveMaps[Drive_No];
+	ui5r size = DriveMapSizes[Drive_No];
+	ui5r n = 0;
+
+	if (Sony_Start <= size) {
+		n = size - Sony_Start;
+		if (n > Sony_Count) {
+			n = Sony_Count;
+		}
+		if (IsWrite) {
+			(void) memcpy(p + Sony_Start, Buffer, n);
+		} else {
+			(void) memcpy(Buffer, p + Sony_Start, n);
+		}
+		if (n == Sony_Count) {
+			err = mnvm_noErr;
+		}
+	}
+
+	if (nullpr != Sony_ActCount) {
+		*Sony_ActCount = n;
+	}
+
+	return err;
+}
+
+LOCALPROC DiskMap_Close(tDrive Drive_No)
+{
+	ui3p p = DriveMaps[Drive_No];
+
+	if (nullpr != p) {
+		(void) msync(p, DriveMapSizes[Drive_No], MS_SYNC);
+		(void) munmap(p, DriveMapSizes[Drive_No]);
+		DriveMaps[Drive_No] = nullpr;
+	}
+}
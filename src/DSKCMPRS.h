@@ -0,0 +1,304 @@
+/*
+	DSKCMPRS.h
+
+	Copyright (C) 2023 Jesús A. Álvarez
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	DiSK image CoMPReSsion
+
+	Container for disk images compressed in independent chunks,
+	so any part of the image can be read by decompressing only
+	the chunks it covers. Made by tools/mkdsz.c. The contents are
+	the bytes of the original image file, including any Disk Copy
+	4.2 header, so SONYEMDV.c sees no difference.
+
+	File format (all numbers big endian):
+
+	header:
+		"vMacDSZ1"
+		ui5b size of the uncompressed image
+		ui5b chunk size, a power of two from 4K to 32K
+		ui5b offset of chunk i from the start of the file,
+			for i = 0 to n, where n is the number of chunks
+			and entry n is the end of the file
+
+	Every chunk except maybe the last holds chunk size bytes of
+	the image. If the stored length of a chunk equals its
+	uncompressed length it is stored as is, otherwise it is an
+	LZ4 block (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md).
+
+	Define DskCmp_WantEncode to also get the encoder, a greedy one
+	with a single hash table, fast rather than small.
+*/
+
+#ifdef DSKCMPRS_H
+#error "header already included"
+#else
+#define DSKCMPRS_H
+#endif
+
+#define DskCmp_HeaderSize 16
+#define DskCmp_MinChunkSize 0x1000
+#define DskCmp_MaxChunkSize 0x8000
+
+LOCALFUNC ui5r DskCmp_Get32(ui3p p)
+{
+	return ((ui5r)p[0] << 24) | ((ui5r)p[1] << 16)
+		| ((ui5r)p[2] << 8) | (ui5r)p[3];
+}
+
+/*
+	Check a header, and return the image size, chunk size
+	and number of chunks.
+*/
+LOCALFUNC blnr DskCmp_CheckHeader(ui3p p,
+	ui5r *ImageSize, ui5r *ChunkSize, ui5r *NumChunks)
+{
+	ui5r size;
+	ui5r chunk;
+
+	if (0 != memcmp(p, "vMacDSZ1", 8)) {
+		return falseblnr;
+	}
+	size = DskCmp_Get32(p + 8);
+	chunk = DskCmp_Get32(p + 12);
+	if ((chunk < DskCmp_MinChunkSize) || (chunk > DskCmp_MaxChunkSize)
+		|| (0 != (chunk & (chunk - 1))) || (0 == size))
+	{
+		return falseblnr;
+	}
+	*ImageSize = size;
+	*ChunkSize = chunk;
+	*NumChunks = (size + chunk - 1) / chunk;
+	return trueblnr;
+}
+
+/*
+	Decode one chunk. Fails, instead of writing outside dst,
+	on corrupt input, or if it doesn't produce exactly dstLen bytes.
+*/
+LOCALFUNC blnr DskCmp_Decode(ui3p src, ui5r srcLen,
+	ui3p dst, ui5r dstLen)
+{
+	ui3p ip = src;
+	ui3p iend = src + srcLen;
+	ui3p op = dst;
+	ui3p oend = dst + dstLen;
+	ui3p m;
+	ui5r token;
+	ui5r len;
+	ui5r offset;
+	ui3r b;
+
+	if (srcLen == dstLen) {
+		MyMoveBytes((anyp)src, (anyp)dst, dstLen);
+		return trueblnr;
+	}
+
+	for (;;) {
+		if (ip >= iend) {
+			return falseblnr;
+		}
+		token = *ip++;
+
+		len = token >> 4;
+		if (15 == len) {
+			do {
+				if (ip >= iend) {
+					return falseblnr;
+				}
+				b = *ip++;
+				len += b;
+			} while (255 == b);
+		}
+		if ((len > (ui5r)(iend - ip)) || (len > (ui5r)(oend - op))) {
+			return falseblnr;
+		}
+		MyMoveBytes((anyp)ip, (anyp)op, len);
+		ip += len;
+		op += len;
+
+		if (ip == iend) {
+			/* last sequence is only literals */
+			break;
+		}
+
+		if (iend - ip < 2) {
+			return falseblnr;
+		}
+		offset = ip[0] | ((ui5r)ip[1] << 8);
+		ip += 2;
+		if ((0 == offset) || (offset > (ui5r)(op - dst))) {
+			return falseblnr;
+		}
+
+		len = token & 15;
+		if (15 == len) {
+			do {
+				if (ip >= iend) {
+					return falseblnr;
+				}
+				b = *ip++;
+				len += b;
+			} while (255 == b);
+		}
+		len += 4;
+		if (len > (ui5r)(oend - op)) {
+			return falseblnr;
+		}
+
+		/* may overlap, copy forward a byte at a time */
+		m = op - offset;
+		do {
+			*op++ = *m++;
+		} while (--len != 0);
+	}
+
+	return op == oend;
+}
+
+#ifndef DskCmp_WantEncode
+#define DskCmp_WantEncode 0
+#endif
+
+#if DskCmp_WantEncode
+
+#define DskCmp_HashBits 13
+#define DskCmp_MinMatch 4
+#define DskCmp_LastLiterals 5
+#define DskCmp_MatchFindLimit 12
+
+LOCALVAR ui5r DskCmp_HashTable[1 << DskCmp_HashBits];
+
+LOCALFUNC ui5r DskCmp_Read32(ui3p p)
+{
+	return p[0] | ((ui5r)p[1] << 8) | ((ui5r)p[2] << 16)
+		| ((ui5r)p[3] << 24);
+}
+
+LOCALFUNC ui3p DskCmp_PutLength(ui3p op, ui3p oend, ui5r len)
+{
+	while (len >= 255) {
+		if (op >= oend) {
+			return nullpr;
+		}
+		*op++ = 255;
+		len -= 255;
+	}
+	if (op >= oend) {
+		return nullpr;
+	}
+	*op++ = len;
+	return op;
+}
+
+/*
+	Emit one sequence. With no match (offset 0) it is the final
+	sequence, of literals only. Returns nullpr if it doesn't fit.
+*/
+LOCALFUNC ui3p DskCmp_PutSequence(ui3p op, ui3p oend,
+	ui3p lit, ui5r litLen, ui5r offset, ui5r matchLen)
+{
+	ui3p token;
+	ui5r m;
+
+	if (op >= oend) {
+		return nullpr;
+	}
+	token = op++;
+	*token = (litLen >= 15 ? 15 : litLen) << 4;
+	if (litLen >= 15) {
+		op = DskCmp_PutLength(op, oend, litLen - 15);
+		if (nullpr == op) {
+			return nullpr;
+		}
+	}
+	if (litLen > (ui5r)(oend - op)) {
+		return nullpr;
+	}
+	MyMoveBytes((anyp)lit, (anyp)op, litLen);
+	op += litLen;
+
+	if (0 != offset) {
+		m = matchLen - DskCmp_MinMatch;
+		if (oend - op < 2) {
+			return nullpr;
+		}
+		*op++ = offset;
+		*op++ = offset >> 8;
+		*token |= (m >= 15 ? 15 : m);
+		if (m >= 15) {
+			op = DskCmp_PutLength(op, oend, m - 15);
+		}
+	}
+	return op;
+}
+
+/*
+	Encode one chunk into dst, which has room for n bytes.
+	Returns the encoded length, or 0 if it isn't smaller than n,
+	in which case the chunk should be stored as is.
+*/
+LOCALFUNC ui5r DskCmp_Encode(ui3p src, ui5r n, ui3p dst)
+{
+	ui3p oend = dst + n - 1;
+	ui3p op = dst;
+	ui5r ip = 0;
+	ui5r anchor = 0;
+	ui5r i;
+	ui5r v;
+	ui5r h;
+	ui5r ref;
+	ui5r len;
+
+	for (i = 0; i < (1 << DskCmp_HashBits); ++i) {
+		DskCmp_HashTable[i] = 0;
+	}
+	if (n > DskCmp_MatchFindLimit) {
+		while (ip + DskCmp_MatchFindLimit <= n) {
+			v = DskCmp_Read32(src + ip);
+			h = (ui5b)(v * 2654435761u) >> (32 - DskCmp_HashBits);
+			ref = DskCmp_HashTable[h];
+
+			DskCmp_HashTable[h] = ip + 1;
+			if ((0 != ref) && (ip + 1 - ref <= 0xFFFF)
+				&& (DskCmp_Read32(src + ref - 1) == v))
+			{
+				len = DskCmp_MinMatch;
+				--ref;
+				while ((ip + len < n - DskCmp_LastLiterals)
+					&& (src[ref + len] == src[ip + len]))
+				{
+					++len;
+				}
+				op = DskCmp_PutSequence(op, oend, src + anchor,
+					ip - anchor, ip - ref, len);
+				if (nullpr == op) {
+					return 0;
+				}
+				ip += len;
+				anchor = ip;
+			} else {
+				++ip;
+			}
+		}
+	}
+	op = DskCmp_PutSequence(op, oend, src + anchor, n - anchor, 0, 0);
+	if (nullpr == op) {
+		return 0;
+	}
+	return op - dst;
+}
+
+#endif /* DskCmp_WantEncode */
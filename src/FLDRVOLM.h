@@ -0,0 +1,1092 @@
+/*
+	FLDRVOLM.h
+
+	Copyright (C) 2023 Jesús A. Álvarez
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	FoLDeR VOLuMe
+
+	Included by OSGLUs when WantFolderVolumes is set. Presents a
+	host folder as a locked HFS volume, without building a disk
+	image. Mounting only lists the folder and its subfolders. The
+	master directory block, volume bitmap and catalog B-tree nodes
+	are made when they are read, and file contents are read from
+	the host files.
+
+	Every file gets a single extent, one after the other in
+	allocation block order, so the extents B-tree is always empty.
+	Catalog records are sorted when the folder is listed and then
+	packed into leaf nodes, so that any node can be made on its own
+	from its first record.
+
+	A file named "*.bin" holding a MacBinary header appears with its
+	Mac name, type, creator, Finder flags and resource fork. Other
+	files get only a data fork. Names are made printable ASCII, and
+	a name that is the same as one already in its folder, ignoring
+	case, is left out.
+
+	The OSGLU provides:
+
+	FldrVol_ListHost(v, Parent, path)
+		call FldrVol_Add for each entry of host folder path
+	FldrVol_OpenHost(path), FldrVol_ReadHost, FldrVol_CloseHost
+		read host files
+*/
+
+#ifdef FLDRVOLM_H
+#error "header already included"
+#else
+#define FLDRVOLM_H
+#endif
+
+#define FldrVol_MaxItems 1024
+#define FldrVol_MaxBytes 0x40000000
+#define FldrVol_MinBytes 0x64000 /* at least as big as a 400K disk */
+#define FldrVol_PathMax 512
+#define FldrVol_RootID 2
+#define FldrVol_FirstID 16
+#define FldrVol_Fanout 11 /* index records per index node */
+
+struct FldrVolItem {
+	char *HostName;
+	ui5r Parent;
+	ui5r Slot; /* position among the items in Parent */
+	ui5r Valence; /* for folders, number of items in it */
+	ui5r DataLen;
+	ui5r RsrcLen;
+	ui5r DataOffset; /* of the forks in the host file */
+	ui5r RsrcOffset;
+	ui4r DataStart; /* first allocation block */
+	ui4r RsrcStart;
+	ui3b Type[4];
+	ui3b Creator[4];
+	ui4r FinderFlags;
+	blnr IsFolder;
+	ui3b Name[32]; /* pascal string */
+};
+typedef struct FldrVolItem FldrVolItem;
+
+struct FldrVolRec {
+	ui5r Parent; /* of the key */
+	si4r Item; /* -1 for the root folder */
+	ui3b Kind; /* cdrType */
+};
+typedef struct FldrVolRec FldrVolRec;
+
+#define FldrVol_kFolder 1
+#define FldrVol_kFile 2
+#define FldrVol_kThread 3
+
+struct FldrVolFork {
+	ui4r Start;
+	ui4r Item;
+	blnr IsRsrc;
+};
+typedef struct FldrVolFork FldrVolFork;
+
+struct FldrVolR {
+	char *HostPath;
+	ui3b Name[28]; /* volume name */
+	ui5r Date;
+	ui5r NumItems;
+	FldrVolItem *Items;
+	ui5r RootValence;
+	ui5r TotalBytes; /* of all forks */
+	ui5r NumFiles;
+	ui5r NumFolders;
+
+	ui5r NumRecs;
+	FldrVolRec *Recs;
+	ui5r NumLeaves;
+	ui5r *LeafFirst; /* first record of each leaf, then NumRecs */
+	ui3r Depth;
+	ui5r LevelStart[6]; /* first node of each level */
+	ui5r LevelCount[6];
+	ui5r CatUsedNodes;
+	ui5r CatNodes;
+
+	ui5r NumForks;
+	FldrVolFork *Forks;
+
+	ui5r AlBlkSiz;
+	ui5r NmAlBlks;
+	ui5r UsedAlBlks; /* the rest are free */
+	ui5r VBMBlocks;
+	ui5r AlBlSt;
+	ui5r CatBlocks;
+	ui5r Size;
+
+	anyp HostFile;
+	si5r HostItem;
+	ui3b Node[512];
+};
+typedef struct FldrVolR FldrVolR;
+
+FORWARDPROC FldrVol_ListHost(FldrVolR *v, ui5r Parent, char *path);
+FORWARDFUNC anyp FldrVol_OpenHost(char *path);
+FORWARDFUNC tMacErr FldrVol_ReadHost(anyp f, ui5r Offset,
+	ui3p Buffer, ui5r Count);
+FORWARDPROC FldrVol_CloseHost(anyp f);
+
+LOCALPROC FldrVol_Put16(ui3p p, ui4r v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+LOCALPROC FldrVol_Put32(ui3p p, ui5r v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+LOCALFUNC ui5r FldrVol_Get32(ui3p p)
+{
+	return ((ui5r)p[0] << 24) | ((ui5r)p[1] << 16)
+		| ((ui5r)p[2] << 8) | (ui5r)p[3];
+}
+
+/* host name (UTF-8) to a pascal string of at most n characters */
+LOCALPROC FldrVol_MacName(ui3p r, char *s, ui3r n)
+{
+	ui3r L = 0;
+	ui3r c;
+
+	while ((0 != (c = (ui3b)*s++)) && ('/' != c) && (L < n)) {
+		if ((c & 0xC0) == 0x80) {
+			/* rest of a multibyte character */
+			continue;
+		}
+		if ((c < 0x20) || (c >= 0x7F)) {
+			c = '?';
+		} else if (':' == c) {
+			c = '-';
+		}
+		r[++L] = c;
+	}
+	r[0] = L;
+}
+
+/*
+	Sort order of each Mac Roman character in the catalog, as used by
+	HFS (RelString ignoring case but not diacritics): lower case sorts
+	with upper case, and accented letters right after their base letter.
+*/
+LOCALVAR const ui3b FldrVol_CaseOrder[256] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+	0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,
+	0x20, 0x22, 0x23, 0x28, 0x29, 0x2A, 0x2B, 0x2C,
+	0x2F, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36,
+	0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E,
+	0x3F, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46,
+	0x47, 0x48, 0x57, 0x59, 0x5D, 0x5F, 0x66, 0x68,
+	0x6A, 0x6C, 0x72, 0x74, 0x76, 0x78, 0x7A, 0x7E,
+	0x8C, 0x8E, 0x90, 0x92, 0x95, 0x97, 0x9E, 0xA0,
+	0xA2, 0xA4, 0xA7, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD,
+	0x4E, 0x48, 0x57, 0x59, 0x5D, 0x5F, 0x66, 0x68,
+	0x6A, 0x6C, 0x72, 0x74, 0x76, 0x78, 0x7A, 0x7E,
+	0x8C, 0x8E, 0x90, 0x92, 0x95, 0x97, 0x9E, 0xA0,
+	0xA2, 0xA4, 0xA7, 0xAF, 0xB0, 0xB1, 0xB2, 0xB3,
+	0x4A, 0x4C, 0x5A, 0x60, 0x7B, 0x7F, 0x98, 0x4F,
+	0x49, 0x51, 0x4A, 0x4B, 0x4C, 0x5A, 0x60, 0x63,
+	0x64, 0x65, 0x6E, 0x6F, 0x70, 0x71, 0x7B, 0x84,
+	0x85, 0x86, 0x7F, 0x80, 0x9A, 0x9B, 0x9C, 0x98,
+	0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0x94,
+	0xBB, 0xBC, 0xBD, 0xBE, 0xBF, 0xC0, 0x4D, 0x81,
+	0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8,
+	0xC9, 0xCA, 0xCB, 0x55, 0x8A, 0xCC, 0x4D, 0x81,
+	0xCD, 0xCE, 0xCF, 0xD0, 0xD1, 0xD2, 0xD3, 0x26,
+	0x27, 0xD4, 0x20, 0x49, 0x4B, 0x80, 0x82, 0x82,
+	0xD5, 0xD6, 0x24, 0x25, 0x2D, 0x2E, 0xD7, 0xD8,
+	0xA6, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDE, 0xDF,
+	0xE0, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7,
+	0xE8, 0xE9, 0xEA, 0xEB, 0xEC, 0xED, 0xEE, 0xEF,
+	0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7,
+	0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF
+};
+
+/* Order of names in the catalog */
+LOCALFUNC int FldrVol_CmpName(ui3p a, ui3p b)
+{
+	ui3r i;
+	ui3r n = (a[0] < b[0]) ? a[0] : b[0];
+
+	for (i = 1; i <= n; ++i) {
+		ui3r ca = FldrVol_CaseOrder[a[i]];
+		ui3r cb = FldrVol_CaseOrder[b[i]];
+		if (ca != cb) {
+			return (ca < cb) ? -1 : 1;
+		}
+	}
+	return (int)a[0] - (int)b[0];
+}
+
+LOCALFUNC ui3p FldrVol_RecName(FldrVolR *v, FldrVolRec *r)
+{
+	if (FldrVol_kThread == r->Kind) {
+		return (ui3p)"";
+	} else if (r->Item < 0) {
+		return v->Name;
+	} else {
+		return v->Items[r->Item].Name;
+	}
+}
+
+/* catalog node id of an item */
+LOCALFUNC ui5r FldrVol_ItemID(ui5r i)
+{
+	return FldrVol_FirstID + i;
+}
+
+LOCALFUNC blnr FldrVol_HostPath(FldrVolR *v, si5r i,
+	char *s, int n)
+{
+	int L;
+
+	if (i < 0) {
+		L = snprintf(s, n, "%s", v->HostPath);
+	} else {
+		FldrVolItem *p = &v->Items[i];
+		si5r parent = (FldrVol_RootID == p->Parent) ? -1
+			: (si5r)(p->Parent - FldrVol_FirstID);
+
+		if (! FldrVol_HostPath(v, parent, s, n)) {
+			return falseblnr;
+		}
+		L = strlen(s);
+		L += snprintf(s + L, n - L, "/%s", p->HostName);
+	}
+	return (L >= 0) && (L < n);
+}
+
+LOCALPROC FldrVol_MacBinary(FldrVolR *v, ui5r i, ui5r Size)
+{
+	FldrVolItem *p = &v->Items[i];
+	char path[FldrVol_PathMax];
+	ui3b h[128];
+	anyp f;
+	ui5r DataLen;
+	ui5r RsrcLen;
+	ui5r RsrcOffset;
+	ui3r j;
+
+	if ((Size < 128) || ! FldrVol_HostPath(v, i, path, sizeof(path))) {
+		return;
+	}
+	f = FldrVol_OpenHost(path);
+	if (nullpr == f) {
+		return;
+	}
+	if (mnvm_noErr == FldrVol_ReadHost(f, 0, h, 128))
+	if ((0 == h[0]) && (0 == h[74]) && (0 == h[82]))
+	if ((h[1] >= 1) && (h[1] <= 31))
+	{
+		DataLen = FldrVol_Get32(&h[83]);
+		RsrcLen = FldrVol_Get32(&h[87]);
+		RsrcOffset = 128 + ((DataLen + 127) & ~ 127);
+		if ((DataLen <= Size) && (RsrcOffset <= Size)
+			&& (RsrcLen <= Size - RsrcOffset))
+		{
+			MyMoveBytes((anyp)&h[1], (anyp)p->Name, h[1] + 1);
+			for (j = 1; j <= p->Name[0]; ++j) {
+				if (':' == p->Name[j]) {
+					p->Name[j] = '-';
+				}
+			}
+			MyMoveBytes((anyp)&h[65], (anyp)p->Type, 4);
+			MyMoveBytes((anyp)&h[69], (anyp)p->Creator, 4);
+			p->FinderFlags = (h[73] << 8) | h[101];
+			p->DataOffset = 128;
+			p->DataLen = DataLen;
+			p->RsrcOffset = RsrcOffset;
+			p->RsrcLen = RsrcLen;
+		}
+	}
+	FldrVol_CloseHost(f);
+}
+
+LOCALPROC FldrVol_FileType(FldrVolItem *p)
+{
+	char *s = strrchr(p->HostName, '.');
+
+	if ((NULL != s) && ((0 == strcasecmp(s, ".txt"))
+		|| (0 == strcasecmp(s, ".text"))))
+	{
+		MyMoveBytes((anyp)"TEXT", (anyp)p->Type, 4);
+		MyMoveBytes((anyp)"ttxt", (anyp)p->Creator, 4);
+	} else {
+		MyMoveBytes((anyp)"????", (anyp)p->Type, 4);
+		MyMoveBytes((anyp)"????", (anyp)p->Creator, 4);
+	}
+}
+
+/*
+	Add a host folder entry, called by FldrVol_ListHost. Size is
+	ignored for folders. Hidden entries, and anything past the
+	limits, are left out.
+*/
+LOCALPROC FldrVol_Add(FldrVolR *v, ui5r Parent, char *HostName,
+	blnr IsFolder, ui5r Size)
+{
+	FldrVolItem *p;
+	ui5r i;
+	ui5r Parent0 = (FldrVol_RootID == Parent) ? (ui5r)-1
+		: (Parent - FldrVol_FirstID);
+
+	if (('.' == HostName[0]) || (v->NumItems >= FldrVol_MaxItems)) {
+		return;
+	}
+	if ((! IsFolder) && (Size > FldrVol_MaxBytes)) {
+		return;
+	}
+
+	p = &v->Items[v->NumItems];
+	memset(p, 0, sizeof(*p));
+	p->HostName = strdup(HostName);
+	if (NULL == p->HostName) {
+		return;
+	}
+	if (IsFolder) {
+		/* drop the trailing '/' some hosts list folders with */
+		char *s = strchr(p->HostName, '/');
+		if (NULL != s) {
+			*s = 0;
+		}
+	}
+	p->Parent = Parent;
+	p->IsFolder = IsFolder;
+	FldrVol_MacName(p->Name, HostName, 31);
+	if (! IsFolder) {
+		FldrVol_FileType(p);
+		p->DataLen = Size;
+		if ((NULL != strrchr(HostName, '.'))
+			&& (0 == strcasecmp(strrchr(HostName, '.'), ".bin")))
+		{
+			FldrVol_MacBinary(v, v->NumItems, Size);
+		}
+		if (p->DataLen + p->RsrcLen
+			> FldrVol_MaxBytes - v->TotalBytes)
+		{
+			goto label_fail;
+		}
+	}
+
+	for (i = 0; i < v->NumItems; ++i) {
+		if ((v->Items[i].Parent == Parent)
+			&& (0 == FldrVol_CmpName(v->Items[i].Name, p->Name)))
+		{
+			goto label_fail;
+		}
+	}
+
+	if ((ui5r)-1 == Parent0) {
+		p->Slot = v->RootValence++;
+	} else {
+		p->Slot = v->Items[Parent0].Valence++;
+	}
+	if (IsFolder) {
+		++v->NumFolders;
+	} else {
+		++v->NumFiles;
+		v->TotalBytes += p->DataLen + p->RsrcLen;
+	}
+	++v->NumItems;
+	return;
+
+label_fail:
+	free(p->HostName);
+}
+
+LOCALVAR FldrVolR *FldrVolSorting;
+
+LOCALFUNC int FldrVol_CmpRec(const void *a0, const void *b0)
+{
+	FldrVolRec *a = (FldrVolRec *)a0;
+	FldrVolRec *b = (FldrVolRec *)b0;
+
+	if (a->Parent != b->Parent) {
+		return (a->Parent < b->Parent) ? -1 : 1;
+	}
+	return FldrVol_CmpName(FldrVol_RecName(FldrVolSorting, a),
+		FldrVol_RecName(FldrVolSorting, b));
+}
+
+LOCALFUNC ui5r FldrVol_KeySize(ui3p Name)
+{
+	return (7 + Name[0] + 1) & ~ 1;
+}
+
+LOCALFUNC ui5r FldrVol_DataSize(FldrVolRec *r)
+{
+	switch (r->Kind) {
+		case FldrVol_kFolder:
+			return 70;
+		case FldrVol_kFile:
+			return 102;
+		default:
+			return 46;
+	}
+}
+
+LOCALPROC FldrVol_PutRec(FldrVolRec *r, ui5r Parent, si4r Item,
+	ui3b Kind)
+{
+	r->Parent = Parent;
+	r->Item = Item;
+	r->Kind = Kind;
+}
+
+LOCALFUNC blnr FldrVol_MakeCatalog(FldrVolR *v)
+{
+	ui5r i;
+	ui5r n = 0;
+	ui5r used;
+	ui5r k;
+	ui3r level;
+
+	v->Recs = malloc((2 + 2 * v->NumItems) * sizeof(FldrVolRec));
+	v->LeafFirst = malloc((3 + 2 * v->NumItems) * sizeof(ui5r));
+	if ((NULL == v->Recs) || (NULL == v->LeafFirst)) {
+		return falseblnr;
+	}
+
+	FldrVol_PutRec(&v->Recs[n++], 1, -1, FldrVol_kFolder);
+	FldrVol_PutRec(&v->Recs[n++], FldrVol_RootID, -1,
+		FldrVol_kThread);
+	for (i = 0; i < v->NumItems; ++i) {
+		FldrVolItem *p = &v->Items[i];
+		if (p->IsFolder) {
+			FldrVol_PutRec(&v->Recs[n++], p->Parent, i,
+				FldrVol_kFolder);
+			FldrVol_PutRec(&v->Recs[n++], FldrVol_ItemID(i), i,
+				FldrVol_kThread);
+		} else {
+			FldrVol_PutRec(&v->Recs[n++], p->Parent, i,
+				FldrVol_kFile);
+		}
+	}
+	v->NumRecs = n;
+	FldrVolSorting = v;
+	qsort(v->Recs, n, sizeof(FldrVolRec), FldrVol_CmpRec);
+
+	/* pack into leaf nodes */
+	v->NumLeaves = 0;
+	k = 0;
+	used = 512;
+	for (i = 0; i < n; ++i) {
+		FldrVolRec *r = &v->Recs[i];
+		ui5r sz = FldrVol_KeySize(FldrVol_RecName(v, r))
+			+ FldrVol_DataSize(r);
+
+		/* descriptor, records, and an offset for each plus one */
+		if (used + sz + 2 * (k + 2) > 512) {
+			v->LeafFirst[v->NumLeaves++] = i;
+			used = 14;
+			k = 0;
+		}
+		used += sz;
+		++k;
+	}
+	v->LeafFirst[v->NumLeaves] = n;
+
+	/* index levels, bottom up, each after the one below */
+	v->LevelStart[0] = 1;
+	v->LevelCount[0] = v->NumLeaves;
+	level = 0;
+	while (v->LevelCount[level] > 1) {
+		++level;
+		v->LevelStart[level] = v->LevelStart[level - 1]
+			+ v->LevelCount[level - 1];
+		v->LevelCount[level] = (v->LevelCount[level - 1]
+			+ FldrVol_Fanout - 1) / FldrVol_Fanout;
+	}
+	v->Depth = level + 1;
+	v->CatUsedNodes = v->LevelStart[level] + 1;
+
+	return v->CatUsedNodes <= 2048 - 128;
+}
+
+LOCALPROC FldrVol_AddFork(FldrVolR *v, ui5r i, blnr IsRsrc,
+	ui5r Len, ui5r *Next)
+{
+	ui4r Start = 0;
+
+	if (0 != Len) {
+		FldrVolFork *f = &v->Forks[v->NumForks++];
+
+		Start = *Next;
+		f->Start = Start;
+		f->Item = i;
+		f->IsRsrc = IsRsrc;
+		*Next += (Len + v->AlBlkSiz - 1) / v->AlBlkSiz;
+	}
+	if (IsRsrc) {
+		v->Items[i].RsrcStart = Start;
+	} else {
+		v->Items[i].DataStart = Start;
+	}
+}
+
+LOCALFUNC blnr FldrVol_Layout(FldrVolR *v)
+{
+	ui5r i;
+	ui5r n;
+	ui5r ab = 512;
+
+	for (;;) {
+		n = 1 + (v->CatUsedNodes * 512 + ab - 1) / ab;
+		for (i = 0; i < v->NumItems; ++i) {
+			n += (v->Items[i].DataLen + ab - 1) / ab;
+			n += (v->Items[i].RsrcLen + ab - 1) / ab;
+		}
+		if (n <= 0xFFFF) {
+			break;
+		}
+		ab <<= 1;
+	}
+	v->AlBlkSiz = ab;
+	v->UsedAlBlks = n;
+	if (n < FldrVol_MinBytes / ab) {
+		n = FldrVol_MinBytes / ab;
+	}
+	v->NmAlBlks = n;
+	v->VBMBlocks = (n + 4095) / 4096;
+	v->AlBlSt = 3 + v->VBMBlocks;
+	v->CatBlocks = (v->CatUsedNodes * 512 + ab - 1) / ab;
+	v->CatNodes = v->CatBlocks * (ab / 512);
+	v->Size = v->AlBlSt * 512 + n * ab + 1024;
+
+	v->Forks = malloc((2 * v->NumItems + 1) * sizeof(FldrVolFork));
+	if (NULL == v->Forks) {
+		return falseblnr;
+	}
+	v->NumForks = 0;
+	n = 1 + v->CatBlocks;
+	for (i = 0; i < v->NumItems; ++i) {
+		if (! v->Items[i].IsFolder) {
+			FldrVol_AddFork(v, i, falseblnr, v->Items[i].DataLen, &n);
+			FldrVol_AddFork(v, i, trueblnr, v->Items[i].RsrcLen, &n);
+		}
+	}
+
+	return trueblnr;
+}
+
+LOCALPROC FldrVol_Dispose(FldrVolR *v)
+{
+	ui5r i;
+
+	if (nullpr != v->HostFile) {
+		FldrVol_CloseHost(v->HostFile);
+	}
+	if (NULL != v->Items) {
+		for (i = 0; i < v->NumItems; ++i) {
+			free(v->Items[i].HostName);
+		}
+	}
+	free(v->Items);
+	free(v->Recs);
+	free(v->LeafFirst);
+	free(v->Forks);
+	free(v->HostPath);
+	free(v);
+}
+
+/*
+	List the host folder at path, and lay out the volume.
+	Returns nullpr if it can't be done.
+*/
+LOCALFUNC FldrVolR *FldrVol_Open(char *path)
+{
+	FldrVolR *v = calloc(1, sizeof(FldrVolR));
+	char s[FldrVol_PathMax];
+	char *name;
+	ui5r i;
+
+	if (NULL == v) {
+		return nullpr;
+	}
+	v->HostPath = strdup(path);
+	v->Items = malloc(FldrVol_MaxItems * sizeof(FldrVolItem));
+	if ((NULL == v->HostPath) || (NULL == v->Items)) {
+		goto label_fail;
+	}
+	/* trailing '/' isn't part of the name */
+	i = strlen(v->HostPath);
+	while ((i > 1) && ('/' == v->HostPath[i - 1])) {
+		v->HostPath[--i] = 0;
+	}
+	name = strrchr(v->HostPath, '/');
+	name = (NULL == name) ? v->HostPath : name + 1;
+	FldrVol_MacName(v->Name, name, 27);
+	if (0 == v->Name[0]) {
+		FldrVol_MacName(v->Name, "Untitled", 27);
+	}
+	v->Date = CurMacDateInSeconds;
+	v->HostItem = -1;
+
+	FldrVol_ListHost(v, FldrVol_RootID, v->HostPath);
+	/* the list grows as subfolders are listed */
+	for (i = 0; i < v->NumItems; ++i) {
+		if (v->Items[i].IsFolder
+			&& FldrVol_HostPath(v, i, s, sizeof(s)))
+		{
+			FldrVol_ListHost(v, FldrVol_ItemID(i), s);
+		}
+	}
+
+	if (FldrVol_MakeCatalog(v) && FldrVol_Layout(v)) {
+		return v;
+	}
+
+label_fail:
+	FldrVol_Dispose(v);
+	return nullpr;
+}
+
+LOCALPROC FldrVol_MakeMDB(FldrVolR *v, ui3p p)
+{
+	memset(p, 0, 512);
+	FldrVol_Put16(p + 0, 0x4244); /* drSigWord */
+	FldrVol_Put32(p + 2, v->Date); /* drCrDate */
+	FldrVol_Put32(p + 6, v->Date); /* drLsMod */
+	FldrVol_Put16(p + 10, 0x8100); /* drAtrb, locked and unmounted */
+	FldrVol_Put16(p + 14, 3); /* drVBMSt */
+	FldrVol_Put16(p + 18, v->NmAlBlks); /* drNmAlBlks */
+	FldrVol_Put32(p + 20, v->AlBlkSiz); /* drAlBlkSiz */
+	FldrVol_Put32(p + 24, v->AlBlkSiz); /* drClpSiz */
+	FldrVol_Put16(p + 28, v->AlBlSt); /* drAlBlSt */
+	FldrVol_Put32(p + 30, FldrVol_ItemID(v->NumItems)); /* drNxtCNID */
+	FldrVol_Put16(p + 34, v->NmAlBlks - v->UsedAlBlks); /* drFreeBks */
+	/* drVN */
+	MyMoveBytes((anyp)v->Name, (anyp)(p + 36), v->Name[0] + 1);
+	FldrVol_Put32(p + 74, v->AlBlkSiz); /* drXTClpSiz */
+	FldrVol_Put32(p + 78, v->AlBlkSiz); /* drCTClpSiz */
+	FldrVol_Put32(p + 84, v->NumFiles); /* drFilCnt */
+	FldrVol_Put32(p + 88, v->NumFolders); /* drDirCnt */
+	FldrVol_Put32(p + 130, v->AlBlkSiz); /* drXTFlSize */
+	FldrVol_Put16(p + 136, 1); /* drXTExtRec, at block 0 */
+	FldrVol_Put32(p + 146, v->CatBlocks * v->AlBlkSiz); /* drCTFlSize */
+	FldrVol_Put16(p + 150, 1); /* drCTExtRec */
+	FldrVol_Put16(p + 152, v->CatBlocks);
+
+	{
+		/* drNmFls and drNmRtDirs count files and folders in root */
+		ui5r i;
+		ui5r nf = 0;
+		ui5r nd = 0;
+
+		for (i = 0; i < v->NumItems; ++i) {
+			if (FldrVol_RootID == v->Items[i].Parent) {
+				if (v->Items[i].IsFolder) {
+					++nd;
+				} else {
+					++nf;
+				}
+			}
+		}
+		FldrVol_Put16(p + 12, nf);
+		FldrVol_Put16(p + 82, nd);
+	}
+}
+
+LOCALPROC FldrVol_MakeBitmap(FldrVolR *v, ui5r Block, ui3p p)
+{
+	ui5r first = Block * 4096;
+	ui5r i;
+
+	memset(p, 0, 512);
+	for (i = 0; (i < 4096) && (first + i < v->UsedAlBlks); ++i) {
+		p[i >> 3] |= 0x80 >> (i & 7);
+	}
+}
+
+/* write a B-tree node descriptor */
+LOCALPROC FldrVol_NodeDesc(ui3p p, ui5r FLink, ui5r BLink,
+	ui3r Type, ui3r Height, ui4r NRecs)
+{
+	memset(p, 0, 512);
+	FldrVol_Put32(p + 0, FLink);
+	FldrVol_Put32(p + 4, BLink);
+	p[8] = Type;
+	p[9] = Height;
+	FldrVol_Put16(p + 10, NRecs);
+}
+
+/* header node, for either B-tree */
+LOCALPROC FldrVol_HeaderNode(ui3p p, ui3r Depth, ui5r Root,
+	ui5r NRecs, ui5r FNode, ui5r LNode, ui4r KeyLen,
+	ui5r NNodes, ui5r UsedNodes)
+{
+	ui5r i;
+
+	FldrVol_NodeDesc(p, 0, 0, 1, 0, 3);
+	FldrVol_Put16(p + 14, Depth);
+	FldrVol_Put32(p + 16, Root);
+	FldrVol_Put32(p + 20, NRecs);
+	FldrVol_Put32(p + 24, FNode);
+	FldrVol_Put32(p + 28, LNode);
+	FldrVol_Put16(p + 32, 512); /* bthNodeSize */
+	FldrVol_Put16(p + 34, KeyLen);
+	FldrVol_Put32(p + 36, NNodes);
+	FldrVol_Put32(p + 40, NNodes - UsedNodes); /* bthFree */
+
+	/* map record */
+	for (i = 0; i < UsedNodes; ++i) {
+		p[248 + (i >> 3)] |= 0x80 >> (i & 7);
+	}
+
+	/* offsets of header, user data and map records, and free space */
+	FldrVol_Put16(p + 510, 14);
+	FldrVol_Put16(p + 508, 120);
+	FldrVol_Put16(p + 506, 248);
+	FldrVol_Put16(p + 504, 504);
+}
+
+LOCALFUNC ui5r FldrVol_PutKey(ui3p p, ui5r Parent, ui3p Name,
+	blnr IsIndex)
+{
+	ui5r n = IsIndex ? 38 : FldrVol_KeySize(Name);
+
+	memset(p, 0, n);
+	p[0] = IsIndex ? 37 : (6 + Name[0]);
+	FldrVol_Put32(p + 2, Parent);
+	MyMoveBytes((anyp)Name, (anyp)(p + 6), Name[0] + 1);
+	return n;
+}
+
+LOCALPROC FldrVol_PutExtent(ui3p p, ui4r Start, ui5r Len, ui5r ab)
+{
+	if (0 != Len) {
+		FldrVol_Put16(p, Start);
+		FldrVol_Put16(p + 2, (Len + ab - 1) / ab);
+	}
+}
+
+LOCALFUNC ui5r FldrVol_PutData(FldrVolR *v, ui3p p, FldrVolRec *r)
+{
+	ui5r n = FldrVol_DataSize(r);
+	ui5r ab = v->AlBlkSiz;
+	FldrVolItem *t = (r->Item < 0) ? nullpr : &v->Items[r->Item];
+	ui5r Slot = (nullpr == t) ? 0 : t->Slot;
+	ui4r IconV = 16 + (Slot / 4) * 56;
+	ui4r IconH = 24 + (Slot % 4) * 88;
+
+	memset(p, 0, n);
+	p[0] = r->Kind;
+	switch (r->Kind) {
+		case FldrVol_kFolder:
+			FldrVol_Put16(p + 4, (nullpr == t)
+				? v->RootValence : t->Valence); /* dirVal */
+			FldrVol_Put32(p + 6, (nullpr == t)
+				? FldrVol_RootID : FldrVol_ItemID(r->Item));
+			FldrVol_Put32(p + 10, v->Date); /* dirCrDat */
+			FldrVol_Put32(p + 14, v->Date); /* dirMdDat */
+			/* dirUsrInfo.frRect, a window that fits four across */
+			FldrVol_Put16(p + 22, 60);
+			FldrVol_Put16(p + 24, 40);
+			FldrVol_Put16(p + 26, 300);
+			FldrVol_Put16(p + 28, 420);
+			FldrVol_Put16(p + 30, 0x0100); /* frFlags, hasBeenInited */
+			FldrVol_Put16(p + 32, IconV); /* frLocation */
+			FldrVol_Put16(p + 34, IconH);
+			break;
+		case FldrVol_kFile:
+			MyMoveBytes((anyp)t->Type, (anyp)(p + 4), 4);
+			MyMoveBytes((anyp)t->Creator, (anyp)(p + 8), 4);
+			/* fdFlags, with hasBeenInited since placed here */
+			FldrVol_Put16(p + 12, (t->FinderFlags & ~ 0x0001)
+				| 0x0100);
+			FldrVol_Put16(p + 14, IconV); /* fdLocation */
+			FldrVol_Put16(p + 16, IconH);
+			FldrVol_Put32(p + 20, FldrVol_ItemID(r->Item));
+			FldrVol_Put16(p + 24, t->DataStart); /* filStBlk */
+			FldrVol_Put32(p + 26, t->DataLen);
+			FldrVol_Put32(p + 30, (t->DataLen + ab - 1) / ab * ab);
+			FldrVol_Put16(p + 34, t->RsrcStart); /* filRStBlk */
+			FldrVol_Put32(p + 36, t->RsrcLen);
+			FldrVol_Put32(p + 40, (t->RsrcLen + ab - 1) / ab * ab);
+			FldrVol_Put32(p + 44, v->Date); /* filCrDat */
+			FldrVol_Put32(p + 48, v->Date); /* filMdDat */
+			FldrVol_PutExtent(p + 74, t->DataStart, t->DataLen, ab);
+			FldrVol_PutExtent(p + 86, t->RsrcStart, t->RsrcLen, ab);
+			break;
+		default:
+			/* thread, from a folder to its parent and name */
+			if (nullpr == t) {
+				FldrVol_Put32(p + 10, 1);
+				MyMoveBytes((anyp)v->Name, (anyp)(p + 14),
+					v->Name[0] + 1);
+			} else {
+				FldrVol_Put32(p + 10, t->Parent);
+				MyMoveBytes((anyp)t->Name, (anyp)(p + 14),
+					t->Name[0] + 1);
+			}
+			break;
+	}
+	return n;
+}
+
+/* the records in a node start at 14, offsets are from the end */
+LOCALPROC FldrVol_SetOffset(ui3p p, ui4r i, ui4r offset)
+{
+	FldrVol_Put16(p + 510 - 2 * i, offset);
+}
+
+LOCALPROC FldrVol_LeafNode(FldrVolR *v, ui5r Leaf, ui3p p)
+{
+	ui5r first = v->LeafFirst[Leaf];
+	ui5r last = v->LeafFirst[Leaf + 1];
+	ui5r offset = 14;
+	ui5r i;
+
+	FldrVol_NodeDesc(p,
+		(Leaf + 1 < v->NumLeaves) ? (Leaf + 2) : 0,
+		(0 != Leaf) ? Leaf : 0,
+		0xFF, 1, last - first);
+	for (i = first; i < last; ++i) {
+		FldrVolRec *r = &v->Recs[i];
+
+		FldrVol_SetOffset(p, i - first, offset);
+		offset += FldrVol_PutKey(p + offset, r->Parent,
+			FldrVol_RecName(v, r), falseblnr);
+		offset += FldrVol_PutData(v, p + offset, r);
+	}
+	FldrVol_SetOffset(p, last - first, offset);
+}
+
+/* an index node points to the first record of each child */
+LOCALPROC FldrVol_IndexNode(FldrVolR *v, ui3r level, ui5r j, ui3p p)
+{
+	ui5r n = v->LevelCount[level - 1];
+	ui5r first = j * FldrVol_Fanout;
+	ui5r last = first + FldrVol_Fanout;
+	ui5r span = 1; /* leaves under each child */
+	ui5r offset = 14;
+	ui5r i;
+	ui3r k;
+
+	if (last > n) {
+		last = n;
+	}
+	for (k = 1; k < level; ++k) {
+		span *= FldrVol_Fanout;
+	}
+	FldrVol_NodeDesc(p,
+		(j + 1 < v->LevelCount[level])
+			? (v->LevelStart[level] + j + 1) : 0,
+		(0 != j) ? (v->LevelStart[level] + j - 1) : 0,
+		0, level + 1, last - first);
+	for (i = first; i < last; ++i) {
+		FldrVolRec *r = &v->Recs[v->LeafFirst[i * span]];
+
+		FldrVol_SetOffset(p, i - first, offset);
+		offset += FldrVol_PutKey(p + offset, r->Parent,
+			FldrVol_RecName(v, r), trueblnr);
+		FldrVol_Put32(p + offset, v->LevelStart[level - 1] + i);
+		offset += 4;
+	}
+	FldrVol_SetOffset(p, last - first, offset);
+}
+
+LOCALPROC FldrVol_CatalogNode(FldrVolR *v, ui5r Node, ui3p p)
+{
+	ui3r level;
+
+	if (0 == Node) {
+		FldrVol_HeaderNode(p, v->Depth,
+			v->LevelStart[v->Depth - 1], v->NumRecs,
+			1, v->NumLeaves, 37, v->CatNodes, v->CatUsedNodes);
+	} else if (Node >= v->CatUsedNodes) {
+		memset(p, 0, 512);
+	} else if (Node <= v->NumLeaves) {
+		FldrVol_LeafNode(v, Node - 1, p);
+	} else {
+		level = 1;
+		while (Node >= v->LevelStart[level] + v->LevelCount[level]) {
+			++level;
+		}
+		FldrVol_IndexNode(v, level, Node - v->LevelStart[level], p);
+	}
+}
+
+LOCALFUNC FldrVolFork *FldrVol_FindFork(FldrVolR *v, ui5r Block)
+{
+	ui5r lo = 0;
+	ui5r hi = v->NumForks;
+
+	/* last fork starting at or before Block */
+	while (hi - lo > 1) {
+		ui5r mid = (lo + hi) / 2;
+		if (v->Forks[mid].Start <= Block) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	if ((0 == v->NumForks) || (v->Forks[lo].Start > Block)) {
+		return nullpr;
+	}
+	return &v->Forks[lo];
+}
+
+LOCALFUNC tMacErr FldrVol_ReadFork(FldrVolR *v, FldrVolFork *f,
+	ui3p Buffer, ui5r Offset, ui5r Count)
+{
+	FldrVolItem *t = &v->Items[f->Item];
+	ui5r Len = f->IsRsrc ? t->RsrcLen : t->DataLen;
+	ui5r n;
+	char path[FldrVol_PathMax];
+
+	if (Offset >= Len) {
+		n = 0;
+	} else {
+		n = Len - Offset;
+		if (n > Count) {
+			n = Count;
+		}
+	}
+	memset(Buffer + n, 0, Count - n); /* rest of last block */
+	if (0 == n) {
+		return mnvm_noErr;
+	}
+
+	if (v->HostItem != f->Item) {
+		if (nullpr != v->HostFile) {
+			FldrVol_CloseHost(v->HostFile);
+			v->HostFile = nullpr;
+		}
+		v->HostItem = -1;
+		if (FldrVol_HostPath(v, f->Item, path, sizeof(path))) {
+			v->HostFile = FldrVol_OpenHost(path);
+		}
+		if (nullpr == v->HostFile) {
+			return mnvm_miscErr;
+		}
+		v->HostItem = f->Item;
+	}
+	return FldrVol_ReadHost(v->HostFile,
+		(f->IsRsrc ? t->RsrcOffset : t->DataOffset) + Offset,
+		Buffer, n);
+}
+
+/* read from the allocation blocks */
+LOCALFUNC tMacErr FldrVol_ReadAlloc(FldrVolR *v, ui3p Buffer,
+	ui5r Start, ui5r *Count)
+{
+	ui5r ab = v->AlBlkSiz;
+	ui5r Block = Start / ab;
+	ui5r n;
+
+	if (0 == Block) {
+		/* extents B-tree, only the header node */
+		n = 512 - (Start & 511);
+		if (Start < 512) {
+			FldrVol_HeaderNode(v->Node, 0, 0, 0, 0, 0, 7,
+				ab / 512, 1);
+		} else {
+			memset(v->Node, 0, 512);
+		}
+	} else if (Block <= v->CatBlocks) {
+		ui5r Node = (Start - ab) / 512;
+
+		n = 512 - (Start & 511);
+		FldrVol_CatalogNode(v, Node, v->Node);
+	} else if (Block >= v->UsedAlBlks) {
+		/* free space */
+		n = *Count;
+		memset(Buffer, 0, n);
+		return mnvm_noErr;
+	} else {
+		FldrVolFork *f = FldrVol_FindFork(v, Block);
+		ui5r Offset;
+		ui5r Blocks;
+
+		if (nullpr == f) {
+			return mnvm_miscErr;
+		}
+		Offset = Start - f->Start * ab;
+		{
+			FldrVolItem *t = &v->Items[f->Item];
+			ui5r Len = f->IsRsrc ? t->RsrcLen : t->DataLen;
+			Blocks = (Len + ab - 1) / ab;
+		}
+		if (Offset >= Blocks * ab) {
+			return mnvm_miscErr;
+		}
+		n = Blocks * ab - Offset;
+		if (n > *Count) {
+			n = *Count;
+		}
+		*Count = n;
+		return FldrVol_ReadFork(v, f, Buffer, Offset, n);
+	}
+
+	if (n > *Count) {
+		n = *Count;
+	}
+	MyMoveBytes((anyp)(v->Node + (Start & 511)), (anyp)Buffer, n);
+	*Count = n;
+	return mnvm_noErr;
+}
+
+LOCALFUNC tMacErr FldrVol_Read(FldrVolR *v, ui3p Buffer,
+	ui5r Start, ui5r Count)
+{
+	tMacErr err = mnvm_noErr;
+	ui5r AllocStart = v->AlBlSt * 512;
+	ui5r AllocEnd = AllocStart + v->NmAlBlks * v->AlBlkSiz;
+	ui5r n;
+
+	if ((Start > v->Size) || (Count > v->Size - Start)) {
+		return mnvm_eofErr;
+	}
+
+	while ((0 != Count) && (mnvm_noErr == err)) {
+		if ((Start >= AllocStart) && (Start < AllocEnd)) {
+			n = AllocEnd - Start;
+			if (n > Count) {
+				n = Count;
+			}
+			err = FldrVol_ReadAlloc(v, Buffer, Start - AllocStart, &n);
+		} else {
+			ui5r Block = Start / 512;
+
+			if ((2 == Block) || (v->Size / 512 - 2 == Block)) {
+				/* the master directory block, and its copy */
+				FldrVol_MakeMDB(v, v->Node);
+			} else if ((Block >= 3) && (Block < v->AlBlSt)) {
+				FldrVol_MakeBitmap(v, Block - 3, v->Node);
+			} else {
+				/* boot blocks, and last block */
+				memset(v->Node, 0, 512);
+			}
+			n = 512 - (Start & 511);
+			if (n > Count) {
+				n = Count;
+			}
+			MyMoveBytes((anyp)(v->Node + (Start & 511)),
+				(anyp)Buffer, n);
+		}
+		Buffer += n;
+		Start += n;
+		Count -= n;
+	}
+
+	return err;
+}
@@ -27,7 +27,7 @@
 #include "PICOMMON.h"
 
 /*
-	ReportAbnormalID unused 0x111D - 0x11FF
+	ReportAbnormalID unused 0x111E - 0x11FF
 */
 
 /*
@@ -85,7 +85,12 @@ IMPORTPROC put_vm_byte(CPTR addr, ui3r b);
 IMPORTPROC put_vm_word(CPTR addr, ui4r w);
 IMPORTPROC put_vm_long(CPTR addr, ui5r l);
 
+IMPORTPROC get_vm_block(CPTR addr, ui3p Buffer, ui5r L);
+
 GLOBALVAR ui5r my_disk_icon_addr;
+#if Sony_AsyncIO
+GLOBALVAR ui5r sony_async_done_addr = 0;
+#endif
 
 GLOBALPROC customreset(void)
 {
@@ -113,6 +118,12 @@ GLOBALPROC customreset(void)
 #endif
 }
 
+#if WantVarRAMSize
+/* 4M until EmulationSetRAMSize says otherwise */
+GLOBALVAR ui5r RAMa_Size = 0x00200000;
+GLOBALVAR ui5r RAMb_Size = 0x00200000;
+#endif
+
 GLOBALVAR ui3p RAM = nullpr;
 
 #if EmVidCard
@@ -341,8 +352,12 @@ label_1:
 LOCALPROC ExtnParamBuffers_Access(CPTR p)
 {
 	tMacErr result = mnvm_controlErr;
+	ui3b pb[ExtnDat_params + 18];
 
-	switch (get_vm_word(p + ExtnDat_commnd)) {
+	/* the command and all the parameters, in one go */
+	get_vm_block(p, pb, sizeof(pb));
+
+	switch (do_get_mem_word(pb + ExtnDat_commnd)) {
 		case kCmndVersion:
 			put_vm_word(p + ExtnDat_version, 1);
 			result = mnvm_noErr;
@@ -354,7 +369,7 @@ LOCALPROC ExtnParamBuffers_Access(CPTR p)
 		case kCmndPbufNew:
 			{
 				tPbuf Pbuf_No;
-				ui5b count = get_vm_long(p + ExtnDat_params + 4);
+				ui5b count = do_get_mem_long(pb + ExtnDat_params + 4);
 				/* reserved word at offset 2, should be zero */
 				result = PbufNew(count, &Pbuf_No);
 				put_vm_word(p + ExtnDat_params + 0, Pbuf_No);
@@ -362,7 +377,7 @@ LOCALPROC ExtnParamBuffers_Access(CPTR p)
 			break;
 		case kCmndPbufDispose:
 			{
-				tPbuf Pbuf_No = get_vm_word(p + ExtnDat_params + 0);
+				tPbuf Pbuf_No = do_get_mem_word(pb + ExtnDat_params + 0);
 				/* reserved word at offset 2, should be zero */
 				result = CheckPbuf(Pbuf_No);
 				if (mnvm_noErr == result) {
@@ -373,7 +388,7 @@ LOCALPROC ExtnParamBuffers_Access(CPTR p)
 		case kCmndPbufGetSize:
 			{
 				ui5r Count;
-				tPbuf Pbuf_No = get_vm_word(p + ExtnDat_params + 0);
+				tPbuf Pbuf_No = do_get_mem_word(pb + ExtnDat_params + 0);
 				/* reserved word at offset 2, should be zero */
 
 				result = PbufGetSize(Pbuf_No, &Count);
@@ -385,13 +400,13 @@ LOCALPROC ExtnParamBuffers_Access(CPTR p)
 		case kCmndPbufTransfer:
 			{
 				ui5r PbufCount;
-				tPbuf Pbuf_No = get_vm_word(p + ExtnDat_params + 0);
+				tPbuf Pbuf_No = do_get_mem_word(pb + ExtnDat_params + 0);
 				/* reserved word at offset 2, should be zero */
-				ui5r offset = get_vm_long(p + ExtnDat_params + 4);
-				ui5r count = get_vm_long(p + ExtnDat_params + 8);
-				CPTR Buffera = get_vm_long(p + ExtnDat_params + 12);
+				ui5r offset = do_get_mem_long(pb + ExtnDat_params + 4);
+				ui5r count = do_get_mem_long(pb + ExtnDat_params + 8);
+				CPTR Buffera = do_get_mem_long(pb + ExtnDat_params + 12);
 				blnr IsWrite =
-					(get_vm_word(p + ExtnDat_params + 16) != 0);
+					(do_get_mem_word(pb + ExtnDat_params + 16) != 0);
 				result = PbufGetSize(Pbuf_No, &PbufCount);
 				if (mnvm_noErr == result) {
 					ui5r endoff = offset + count;
@@ -1145,33 +1160,39 @@ LOCALPROC SetUp_RAM24(void)
 {
 	ATTer r;
 
-#if (0 == kRAMb_Size) || (kRAMa_Size == kRAMb_Size)
-	r.cmpmask = 0x00FFFFFF & ~ ((1 << kRAM_ln2Spc) - 1);
-	r.cmpvalu = kRAM_Base;
-	r.usemask = kRAM_Size - 1;
-	r.usebase = RAM;
-	r.Access = kATTA_readwritereadymask;
-	AddToATTListWithMTB(&r);
-#else
-	/* unbalanced memory */
-
-#if 0 != (0x00FFFFFF & kRAMa_Size)
-	/* condition should always be true if configuration file right */
-	r.cmpmask = 0x00FFFFFF & (kRAMa_Size | ~ ((1 << kRAM_ln2Spc) - 1));
-	r.cmpvalu = kRAM_Base + kRAMa_Size;
-	r.usemask = kRAMb_Size - 1;
-	r.usebase = kRAMa_Size + RAM;
-	r.Access = kATTA_readwritereadymask;
-	AddToATTListWithMTB(&r);
-#endif
+	/*
+		tests rather than #if, so that this also works when
+		the sizes are only known at run time (WantVarRAMSize)
+	*/
+	if ((0 == kRAMb_Size) || (kRAMa_Size == kRAMb_Size)) {
+		r.cmpmask = 0x00FFFFFF & ~ ((1 << kRAM_ln2Spc) - 1);
+		r.cmpvalu = kRAM_Base;
+		r.usemask = kRAM_Size - 1;
+		r.usebase = RAM;
+		r.Access = kATTA_readwritereadymask;
+		AddToATTListWithMTB(&r);
+	} else {
+		/* unbalanced memory */
 
-	r.cmpmask = 0x00FFFFFF & (kRAMa_Size | ~ ((1 << kRAM_ln2Spc) - 1));
-	r.cmpvalu = kRAM_Base;
-	r.usemask = kRAMa_Size - 1;
-	r.usebase = RAM;
-	r.Access = kATTA_readwritereadymask;
-	AddToATTListWithMTB(&r);
-#endif
+		if (0 != (0x00FFFFFF & kRAMa_Size)) {
+			/* should always be true if configuration right */
+			r.cmpmask = 0x00FFFFFF
+				& (kRAMa_Size | ~ ((1 << kRAM_ln2Spc) - 1));
+			r.cmpvalu = kRAM_Base + kRAMa_Size;
+			r.usemask = kRAMb_Size - 1;
+			r.usebase = kRAMa_Size + RAM;
+			r.Access = kATTA_readwritereadymask;
+			AddToATTListWithMTB(&r);
+		}
+
+		r.cmpmask = 0x00FFFFFF
+			& (kRAMa_Size | ~ ((1 << kRAM_ln2Spc) - 1));
+		r.cmpvalu = kRAM_Base;
+		r.usemask = kRAMa_Size - 1;
+		r.usebase = RAM;
+		r.Access = kATTA_readwritereadymask;
+		AddToATTListWithMTB(&r);
+	}
 }
 #endif
 
@@ -1212,17 +1233,16 @@ LOCALPROC SetUp_address(void)
 	if (MemOverlay) {
 		r.cmpmask = 0x00E00000;
 		r.cmpvalu = kRAM_Overlay_Base;
-#if (0 == kRAMb_Size) || (kRAMa_Size == kRAMb_Size)
-		r.usemask = kRAM_Size - 1;
-			/* note that cmpmask and usemask overlap for 4M */
-		r.usebase = RAM;
-		r.Access = kATTA_readwritereadymask;
-#else
-		/* unbalanced memory */
-		r.usemask = kRAMb_Size - 1;
-		r.usebase = kRAMa_Size + RAM;
+		if ((0 == kRAMb_Size) || (kRAMa_Size == kRAMb_Size)) {
+			r.usemask = kRAM_Size - 1;
+				/* note that cmpmask and usemask overlap for 4M */
+			r.usebase = RAM;
+		} else {
+			/* unbalanced memory */
+			r.usemask = kRAMb_Size - 1;
+			r.usebase = kRAMa_Size + RAM;
+		}
 		r.Access = kATTA_readwritereadymask;
-#endif
 		AddToATTListWithMTB(&r);
 	}
 
@@ -1483,7 +1503,14 @@ GLOBALFUNC ui5b MMDV_Access(ATTep p, ui5b Data,
 						"access SCSI nonstandard address");
 				}
 #endif
+#if IncludeSCSIDisks \
+	&& ! ((CurEmMd == kEmMd_II) || (CurEmMd == kEmMd_IIx))
+				/* with address bit 9 (DACK) as 8, for pseudo-DMA */
+				Data = SCSI_Access(Data, WriteMem,
+					((addr >> 4) & 0x07) | ((addr >> 6) & 0x08));
+#else
 				Data = SCSI_Access(Data, WriteMem, (addr >> 4) & 0x07);
+#endif
 			}
 
 			break;
@@ -1592,6 +1619,92 @@ Label_Retry:
 	return p;
 }
 
+#if WantRAMDirtyMap
+GLOBALVAR ui3p RAMDirtyMap = nullpr;
+GLOBALVAR ui5r RAMDirty_nClears = 0;
+GLOBALVAR ui5r RAMDirty_nPagesCleared = 0;
+
+GLOBALFUNC ui3p RAMDirty_Base(ui3p usebase)
+{
+	/*
+		where the MATC for a bank starting at usebase should
+		record writes. Banks of RAM start on a page boundary.
+	*/
+	if ((usebase >= RAM) && (usebase < RAM + kRAM_Size)) {
+		return RAMDirtyMap
+			+ ((ui5r)(usebase - RAM) >> ln2RAMDirtyPageSz);
+	} else {
+		return RAMDirtyMap + kRAMDirtyNumPages;
+	}
+}
+
+GLOBALPROC RAMDirty_MarkRange(ui5r offset, ui5r L)
+{
+	ui5r i;
+	ui5r n;
+
+	if ((L != 0) && (offset < kRAM_Size)) {
+		n = offset + L - 1;
+		if (n >= kRAM_Size) {
+			n = kRAM_Size - 1;
+		}
+		n >>= ln2RAMDirtyPageSz;
+		for (i = offset >> ln2RAMDirtyPageSz; i <= n; ++i) {
+			RAMDirtyMap[i] = 1;
+		}
+	}
+}
+
+GLOBALPROC RAMDirty_MarkAll(void)
+{
+	RAMDirty_MarkRange(0, kRAM_Size);
+}
+
+GLOBALFUNC ui5r RAMDirty_Count(void)
+{
+	ui5r i;
+	ui5r n = 0;
+
+	for (i = 0; i < kRAMDirtyNumPages; ++i) {
+		if (0 != RAMDirtyMap[i]) {
+			++n;
+		}
+	}
+
+	return n;
+}
+
+GLOBALFUNC ui5r RAMDirty_Next(ui5r page)
+{
+	/*
+		first dirty page at or after page,
+		kRAMDirtyNumPages if there is none.
+	*/
+	while ((page < kRAMDirtyNumPages) && (0 == RAMDirtyMap[page])) {
+		++page;
+	}
+
+	return page;
+}
+
+GLOBALFUNC ui5r RAMDirty_Clear(void)
+{
+	ui5r i;
+	ui5r n = 0;
+
+	for (i = 0; i < kRAMDirtyNumPages; ++i) {
+		if (0 != RAMDirtyMap[i]) {
+			RAMDirtyMap[i] = 0;
+			++n;
+		}
+	}
+	++RAMDirty_nClears;
+	RAMDirty_nPagesCleared += n;
+
+	return n;
+}
+#endif
+
 GLOBALFUNC ui3p get_real_address0(ui5b L, blnr WritableMem, CPTR addr,
 	ui5b *actL)
 {
@@ -1614,6 +1727,11 @@ GLOBALFUNC ui3p get_real_address0(ui5b L, blnr WritableMem, CPTR addr,
 		} else {
 			*actL = bankleft;
 		}
+#if WantRAMDirtyMap
+		if (WritableMem && (p >= RAM) && (p < RAM + kRAM_Size)) {
+			RAMDirty_MarkRange(p - RAM, *actL);
+		}
+#endif
 	}
 
 	return p;
@@ -1677,6 +1795,9 @@ GLOBALPROC Memory_Reset(void)
 {
 	MemOverlay = 1;
 	SetUpMemBanks();
+#if WantRAMDirtyMap
+	RAMDirty_MarkAll();
+#endif
 }
 
 #if (CurEmMd == kEmMd_II) || (CurEmMd == kEmMd_IIx)
@@ -1723,25 +1844,90 @@ GLOBALFUNC blnr FindKeyEvent(int *VirtualKey, blnr *KeyDown)
 
 /* task management */
 
+/*
+	Tasks (ICTs) run when the instruction count reaches the
+	time they were set for. ICTqueue holds the active ones
+	sorted by that time, the soonest last, so finding and
+	taking the next one doesn't look at the others. Ties go
+	to the lower task number, as they always have. There are
+	only a few tasks, so adding one just moves the later ones
+	up. A task with a period is set again each time it runs,
+	until ICT_Cancel. What each task does is registered with
+	ICT_SetProc.
+*/
+
 #ifdef _VIA_Debug
 #include <stdio.h>
 #endif
 
 GLOBALVAR uimr ICTactive;
 GLOBALVAR iCountt ICTwhen[kNumICTs];
+LOCALVAR ui5b ICTperiod[kNumICTs];
+LOCALVAR ui3b ICTqueue[kNumICTs];
+LOCALVAR ui3r ICTqCount;
+LOCALVAR ICT_TaskProc ICTproc[kNumICTs];
+
+GLOBALVAR iCountt NextiCount = 0;
+
+GLOBALPROC ICT_SetProc(int taskid, ICT_TaskProc p)
+{
+	ICTproc[taskid] = p;
+}
 
 GLOBALPROC ICT_Zap(void)
 {
+	int i;
+
 	ICTactive = 0;
+	ICTqCount = 0;
+	for (i = 0; i < kNumICTs; ++i) {
+		ICTperiod[i] = 0;
+	}
 }
 
-LOCALPROC InsertICT(int taskid, iCountt when)
+LOCALPROC ICT_Remove(int taskid)
 {
+	ui3r i = ICTqCount;
+
+	do {
+		--i;
+	} while (ICTqueue[i] != taskid);
+	--ICTqCount;
+	for (; i < ICTqCount; ++i) {
+		ICTqueue[i] = ICTqueue[i + 1];
+	}
+	ICTactive &= ~ (1 << taskid);
+}
+
+LOCALPROC InsertICT(int taskid, iCountt when, iCountt base)
+{
+	/*
+		no task is set for before base, so
+		times can be compared from there
+	*/
+	ui5b d = when - base;
+	ui3r i;
+	ui3b t;
+
+	if (0 != (ICTactive & (1 << taskid))) {
+		ICT_Remove(taskid);
+	}
 	ICTwhen[taskid] = when;
 	ICTactive |= (1 << taskid);
-}
 
-GLOBALVAR iCountt NextiCount = 0;
+	for (i = ICTqCount; i != 0; --i) {
+		t = ICTqueue[i - 1];
+		if ((ICTwhen[t] - base < d)
+			|| ((ICTwhen[t] - base == d) && (t < taskid)))
+		{
+			ICTqueue[i] = t;
+		} else {
+			break;
+		}
+	}
+	ICTqueue[i] = taskid;
+	++ICTqCount;
+}
 
 GLOBALFUNC iCountt GetCuriCount(void)
 {
@@ -1757,10 +1943,171 @@ GLOBALPROC ICT_add(int taskid, ui5b n)
 #ifdef _VIA_Debug
 	fprintf(stderr, "ICT_add: %d, %d, %d\n", when, taskid, n);
 #endif
-	InsertICT(taskid, when);
+	ICTperiod[taskid] = 0;
+	/*
+		x may be negative in the instruction that ends
+		the slice, the tasks due at NextiCount haven't
+		run yet then.
+	*/
+	InsertICT(taskid, when, (x > 0) ? NextiCount - x : NextiCount);
 
 	if (x > (si5r)n) {
 		SetCyclesRemaining(n);
 		NextiCount = when;
 	}
 }
+
+GLOBALPROC ICT_addPeriodic(int taskid, ui5b n)
+{
+	ICT_add(taskid, n);
+	ICTperiod[taskid] = n;
+}
+
+GLOBALPROC ICT_Cancel(int taskid)
+{
+	if (0 != (ICTactive & (1 << taskid))) {
+		ICT_Remove(taskid);
+	}
+	ICTperiod[taskid] = 0;
+}
+
+/*
+	Called by the main loop with no cycles remaining,
+	NextiCount is now.
+*/
+GLOBALPROC ICT_DoCurrentTasks(void)
+{
+	int i;
+	ICT_TaskProc p;
+
+	while ((0 != ICTqCount)
+		&& (ICTwhen[i = ICTqueue[ICTqCount - 1]] == NextiCount))
+	{
+		--ICTqCount;
+		ICTactive &= ~ (1 << i);
+		if (0 != ICTperiod[i]) {
+			/*
+				before the task, which may change it. from
+				the current count, as ICT_add would.
+			*/
+			InsertICT(i, GetCuriCount() + ICTperiod[i], NextiCount);
+		}
+#ifdef _VIA_Debug
+		fprintf(stderr, "doing task %d, %d\n", NextiCount, i);
+#endif
+		p = ICTproc[i];
+		if (nullpr != p) {
+			p();
+		} else {
+			ReportAbnormalID(0x111D, "no proc for task");
+		}
+
+		/*
+			A Task may set the time of
+			any task, including itself.
+			But it cannot set any task
+			to execute immediately, so
+			this ends.
+		*/
+	}
+}
+
+GLOBALFUNC ui5b ICT_DoGetNext(ui5b maxn)
+{
+	ui5b d;
+
+	if (0 != ICTqCount) {
+		d = ICTwhen[ICTqueue[ICTqCount - 1]] - NextiCount;
+		/* at this point d must be > 0 */
+		if (d < maxn) {
+#ifdef _VIA_Debug
+			fprintf(stderr, "coming task %d, %d, %d\n",
+				NextiCount, ICTqueue[ICTqCount - 1], d);
+#endif
+			return d;
+		}
+	}
+
+	return maxn;
+}
+
+#if WantSaveStates
+
+/*
+	save states, see EmulationStateIO in PROGMAIN.c.
+
+	Every module passes its variables to StateIO_Bytes in a fixed
+	order, which copies them into the buffer when saving, or back
+	out of it when loading. With no buffer it only counts bytes,
+	to find the size needed. The layout is that of this build,
+	so a state is only good for the same program.
+*/
+
+GLOBALVAR blnr StateIO_Loading = falseblnr;
+LOCALVAR ui3p StateIO_Ptr;
+LOCALVAR ui5r StateIO_Size;
+LOCALVAR ui5r StateIO_Pos;
+LOCALVAR blnr StateIO_Overrun;
+
+GLOBALPROC StateIO_Begin(ui3p p, ui5r n, blnr Loading)
+{
+	StateIO_Ptr = p;
+	StateIO_Size = n;
+	StateIO_Pos = 0;
+	StateIO_Overrun = falseblnr;
+	StateIO_Loading = Loading;
+}
+
+GLOBALFUNC ui5r StateIO_End(void)
+{
+	StateIO_Loading = falseblnr;
+	return StateIO_Overrun ? 0 : StateIO_Pos;
+}
+
+GLOBALPROC StateIO_Bytes(anyp p, ui5r n)
+{
+	if (nullpr != StateIO_Ptr) {
+		if (n > StateIO_Size - StateIO_Pos) {
+			StateIO_Overrun = trueblnr;
+			return;
+		}
+		if (StateIO_Loading) {
+			MyMoveBytes((anyp)(StateIO_Ptr + StateIO_Pos), p, n);
+		} else {
+			MyMoveBytes(p, (anyp)(StateIO_Ptr + StateIO_Pos), n);
+		}
+	}
+	StateIO_Pos += n;
+}
+
+GLOBALPROC Glue_StateIO(void)
+{
+	StateIO_Var(Wires);
+	StateIO_Var(ICTactive);
+	StateIO_Var(ICTwhen);
+	StateIO_Var(ICTperiod);
+	StateIO_Var(ICTqueue);
+	StateIO_Var(ICTqCount);
+	StateIO_Var(NextiCount);
+	StateIO_Var(InterruptButton);
+	StateIO_Var(CurIPL);
+#if HaveMasterMyEvtQLock
+	StateIO_Var(MasterMyEvtQLock);
+#endif
+	StateIO_Var(ParamAddrHi);
+	StateIO_Var(my_disk_icon_addr);
+#if Sony_AsyncIO
+	StateIO_Var(sony_async_done_addr);
+#endif
+#if IncludeVidMem
+	StateIO_Bytes((anyp)VidMem, kVidMemRAM_Size);
+#endif
+	/* RAM is left to the caller, it is much bigger */
+
+	if (StateIO_Loading) {
+		/* the memory map depends on Wires */
+		SetUpMemBanks();
+	}
+}
+
+#endif /* WantSaveStates */
@@ -35,6 +35,16 @@
 
 #define RAMSafetyMarginFudge 4
 
+#if WantVarRAMSize
+/*
+	kRAMa_Size and kRAMb_Size are these variables, set by
+	EmulationSetRAMSize before memory is allocated and fixed
+	from then on.
+*/
+EXPORTVAR(ui5r, RAMa_Size)
+EXPORTVAR(ui5r, RAMb_Size)
+#endif
+
 #define kRAM_Size (kRAMa_Size + kRAMb_Size)
 EXPORTVAR(ui3p, RAM)
 	/*
@@ -70,6 +80,46 @@ typedef ui5b CPTR;
 EXPORTFUNC ui3p get_real_address0(ui5b L, blnr WritableMem, CPTR addr,
 	ui5b *actL);
 
+#ifndef WantRAMDirtyMap
+#define WantRAMDirtyMap 0
+#endif
+
+#if WantRAMDirtyMap
+/*
+	One byte per page of RAM, set nonzero whenever the emulated
+	computer (or a device, through get_real_address0) may have
+	written to that page since it was last cleared. Lets code that
+	keeps copies of RAM, such as save states, look at only the
+	pages that changed.
+*/
+#define ln2RAMDirtyPageSz 10
+#define kRAMDirtyPageSz (1 << ln2RAMDirtyPageSz)
+#define kRAMDirtyNumPages (kRAM_Size >> ln2RAMDirtyPageSz)
+#if IncludeVidMem
+#define kRAMDirtyMapSize (kRAMDirtyNumPages \
+	+ (kVidMemRAM_Size >> ln2RAMDirtyPageSz) + 1)
+#else
+#define kRAMDirtyMapSize (kRAMDirtyNumPages + 1)
+#endif
+	/*
+		followed by a sink, so that writes to other writable
+		memory (video memory) can be recorded without a test.
+	*/
+
+EXPORTVAR(ui3p, RAMDirtyMap)
+EXPORTVAR(ui5r, RAMDirty_nClears)
+EXPORTVAR(ui5r, RAMDirty_nPagesCleared)
+
+#define RAMDirty_Test(page) (0 != RAMDirtyMap[page])
+
+EXPORTFUNC ui3p RAMDirty_Base(ui3p usebase);
+EXPORTPROC RAMDirty_MarkRange(ui5r offset, ui5r L);
+EXPORTPROC RAMDirty_MarkAll(void);
+EXPORTFUNC ui5r RAMDirty_Count(void);
+EXPORTFUNC ui5r RAMDirty_Next(ui5r page);
+EXPORTFUNC ui5r RAMDirty_Clear(void);
+#endif
+
 /*
 	memory access routines that can use when have address
 	that is known to be in RAM (and that is in the first
@@ -82,9 +132,21 @@ EXPORTFUNC ui3p get_real_address0(ui5b L, blnr WritableMem, CPTR addr,
 #define get_ram_word(addr) do_get_mem_word((addr) + RAM)
 #define get_ram_long(addr) do_get_mem_long((addr) + RAM)
 
+#if WantRAMDirtyMap
+#define RAMDirty_Mark(addr) \
+	(RAMDirtyMap[(addr) >> ln2RAMDirtyPageSz] = 1)
+#define put_ram_byte(addr, b) \
+	(RAMDirty_Mark(addr), do_put_mem_byte((addr) + RAM, (b)))
+#define put_ram_word(addr, w) \
+	(RAMDirty_Mark(addr), do_put_mem_word((addr) + RAM, (w)))
+#define put_ram_long(addr, l) \
+	(RAMDirty_Mark((addr) + 3), RAMDirty_Mark(addr), \
+		do_put_mem_long((addr) + RAM, (l)))
+#else
 #define put_ram_byte(addr, b) do_put_mem_byte((addr) + RAM, (b))
 #define put_ram_word(addr, w) do_put_mem_word((addr) + RAM, (w))
 #define put_ram_long(addr, l) do_put_mem_long((addr) + RAM, (l))
+#endif
 
 #else
 
@@ -173,15 +235,25 @@ enum {
 	kICT_VIA2_Timer1Check,
 	kICT_VIA2_Timer2Check,
 #endif
+#if Sony_AsyncIO
+	kICT_Sony_Async,
+#endif
 
 	kNumICTs
 };
 
+typedef void (*ICT_TaskProc) (void);
+
+EXPORTPROC ICT_SetProc(int taskid, ICT_TaskProc p);
 EXPORTPROC ICT_add(int taskid, ui5b n);
+EXPORTPROC ICT_addPeriodic(int taskid, ui5b n);
+EXPORTPROC ICT_Cancel(int taskid);
 
 #define iCountt ui5b
 EXPORTFUNC iCountt GetCuriCount(void);
 EXPORTPROC ICT_Zap(void);
+EXPORTPROC ICT_DoCurrentTasks(void);
+EXPORTFUNC ui5b ICT_DoGetNext(ui5b maxn);
 
 EXPORTVAR(uimr, ICTactive)
 EXPORTVAR(iCountt, ICTwhen[kNumICTs])
@@ -239,6 +311,9 @@ enum {
 #define kcom_callcheck 0x5B17
 
 EXPORTVAR(ui5r, my_disk_icon_addr)
+#if Sony_AsyncIO
+EXPORTVAR(ui5r, sony_async_done_addr)
+#endif
 
 EXPORTPROC Memory_Reset(void);
 
@@ -276,3 +351,13 @@ typedef ATTer *ATTep;
 EXPORTFUNC ui5b MMDV_Access(ATTep p, ui5b Data,
 	blnr WriteMem, blnr ByteSize, CPTR addr);
 EXPORTFUNC blnr MemAccessNtfy(ATTep pT);
+
+#if WantSaveStates
+EXPORTVAR(blnr, StateIO_Loading)
+EXPORTPROC StateIO_Begin(ui3p p, ui5r n, blnr Loading);
+EXPORTFUNC ui5r StateIO_End(void);
+EXPORTPROC StateIO_Bytes(anyp p, ui5r n);
+#define StateIO_Var(v) StateIO_Bytes((anyp)&(v), sizeof(v))
+
+EXPORTPROC Glue_StateIO(void);
+#endif
@@ -212,3 +212,10 @@ GLOBALFUNC ui5b IWM_Access(ui5b Data, blnr WriteMem, CPTR addr)
 
 	return Data;
 }
+
+#if WantSaveStates
+GLOBALPROC IWM_StateIO(void)
+{
+	StateIO_Var(IWM);
+}
+#endif
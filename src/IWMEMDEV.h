@@ -23,3 +23,7 @@
 EXPORTPROC IWM_Reset(void);
 
 EXPORTFUNC ui5b IWM_Access(ui5b Data, blnr WriteMem, CPTR addr);
+
+#if WantSaveStates
+EXPORTPROC IWM_StateIO(void);
+#endif
@@ -210,4 +210,15 @@ GLOBALPROC KeyBoard_Update(void)
 	}
 }
 
+#if WantSaveStates
+GLOBALPROC Kybd_StateIO(void)
+{
+	StateIO_Var(KybdState);
+	StateIO_Var(HaveKeyBoardResult);
+	StateIO_Var(KeyBoardResult);
+	StateIO_Var(InstantCommandData);
+	StateIO_Var(InquiryCommandTimer);
+}
+#endif
+
 #endif /* EmClassicKbrd */
@@ -25,3 +25,7 @@ EXPORTPROC Kybd_DataLineChngNtfy(void);
 EXPORTPROC DoKybd_ReceiveEndCommand(void);
 EXPORTPROC DoKybd_ReceiveCommand(void);
 EXPORTPROC KeyBoard_Update(void);
+
+#if WantSaveStates
+EXPORTPROC Kybd_StateIO(void);
+#endif
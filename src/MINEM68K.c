@@ -88,10 +88,21 @@ struct MATCr {
 	ui5r cmpvalu;
 	ui5r usemask;
 	ui3p usebase;
+#if WantRAMDirtyMap
+	ui3p dirtybase; /* RAMDirtyMap entry for usebase */
+#endif
 };
 typedef struct MATCr MATCr;
 typedef MATCr *MATCp;
 
+#if WantRAMDirtyMap
+/* after a write through a MATC, see RAMDirtyMap in GLOBGLUE.h */
+#define MATC_NoteWrite(matc, addr) \
+	((matc).dirtybase[((addr) & (matc).usemask) >> ln2RAMDirtyPageSz] = 1)
+#else
+#define MATC_NoteWrite(matc, addr)
+#endif
+
 #ifndef USE_PCLIMIT
 #define USE_PCLIMIT 1
 #endif
@@ -242,7 +253,7 @@ LOCALVAR struct regstruct
 #endif
 
 #define disp_table_sz (256 * 256)
-#if SmallGlobals
+#if SmallGlobals || WantMachinePerThread
 	DecOpR *disp_table;
 #else
 	DecOpR disp_table[disp_table_sz];
@@ -866,6 +877,7 @@ LOCALPROC my_reg_call put_byte(CPTR addr, ui5r b)
 	ui3p m = (addr & V_regs.MATCwrB.usemask) + V_regs.MATCwrB.usebase;
 	if ((addr & V_regs.MATCwrB.cmpmask) == V_regs.MATCwrB.cmpvalu) {
 		*m = b;
+		MATC_NoteWrite(V_regs.MATCwrB, addr);
 	} else {
 		put_byte_ext(addr, b);
 	}
@@ -890,6 +902,7 @@ LOCALPROC my_reg_call put_word(CPTR addr, ui5r w)
 	ui3p m = (addr & V_regs.MATCwrW.usemask) + V_regs.MATCwrW.usebase;
 	if ((addr & V_regs.MATCwrW.cmpmask) == V_regs.MATCwrW.cmpvalu) {
 		do_put_mem_word(m, w);
+		MATC_NoteWrite(V_regs.MATCwrW, addr);
 	} else {
 		put_word_ext(addr, w);
 	}
@@ -951,6 +964,8 @@ LOCALPROC my_reg_call put_long_misaligned(CPTR addr, ui5r l)
 	{
 		do_put_mem_word(m, l >> 16);
 		do_put_mem_word(m2, l);
+		MATC_NoteWrite(V_regs.MATCwrW, addr);
+		MATC_NoteWrite(V_regs.MATCwrW, addr2);
 	} else {
 		put_long_misaligned_ext(addr, l);
 	}
@@ -968,6 +983,7 @@ LOCALPROC my_reg_call put_long(CPTR addr, ui5r l)
 			+ V_regs.MATCwrL.usebase;
 		if ((addr & V_regs.MATCwrL.cmpmask) == V_regs.MATCwrL.cmpvalu) {
 			do_put_mem_long(m, l);
+			MATC_NoteWrite(V_regs.MATCwrL, addr);
 		} else {
 			put_long_ext(addr, l);
 		}
@@ -4124,6 +4140,40 @@ LOCALIPROC DoCodeBccW(void)
 }
 
 
+#ifndef WantFastDelayLoops
+#define WantFastDelayLoops 0
+#endif
+
+#if WantFastDelayLoops
+/*
+	"DBcc Dn,*" (branching to itself) is a delay loop that only
+	counts down. Do as many further turns of it at once as would
+	be done before anything else can happen, charging the same
+	cycles, so that the emulated machine sees no difference, but
+	less time is spent on the host. The ROM runs such loops while
+	starting up.
+*/
+LOCALPROC DoDelayLoopTurns(ui5r *dstp, ui5r dstvalue)
+{
+	ui5r c = V_regs.disp_table[do_get_mem_word(V_pc_p - 2)].x.Cycles;
+	ui5r n = dstvalue & 0xffff; /* turns left that branch back */
+	ui5r m;
+
+#if WantCloserCyc
+	c += (10 * kCycleScale + 2 * RdAvgXtraCyc);
+#endif
+
+	if (V_MaxCyclesToGo > (si5rr)c) {
+		m = (V_MaxCyclesToGo - 1) / c;
+		if (n > m) {
+			n = m;
+		}
+		V_MaxCyclesToGo -= n * c;
+		*dstp = (*dstp & ~ 0xffff) | ((dstvalue - n) & 0xffff);
+	}
+}
+#endif
+
 LOCALIPROC DoCodeDBF(void)
 {
 	/* DBcc 0101cccc11001ddd */
@@ -4147,6 +4197,11 @@ LOCALIPROC DoCodeDBF(void)
 	} else {
 #if WantCloserCyc
 		V_MaxCyclesToGo -= (10 * kCycleScale + 2 * RdAvgXtraCyc);
+#endif
+#if WantFastDelayLoops
+		if (-2 == (si4b)do_get_mem_word(V_pc_p)) {
+			DoDelayLoopTurns(dstp, dstvalue);
+		}
 #endif
 		DoCodeBraW();
 	}
@@ -8338,6 +8393,9 @@ LOCALPROC SetUpMATC(
 	CurMATC->usemask = p->usemask;
 	CurMATC->cmpvalu = p->cmpvalu;
 	CurMATC->usebase = p->usebase;
+#if WantRAMDirtyMap
+	CurMATC->dirtybase = RAMDirty_Base(p->usebase);
+#endif
 }
 
 LOCALFUNC ui5r my_reg_call get_byte_ext(CPTR addr)
@@ -8385,6 +8443,7 @@ Label_Retry:
 		SetUpMATC(&V_regs.MATCwrB, p);
 		m = p->usebase + (addr & p->usemask);
 		*m = b;
+		MATC_NoteWrite(V_regs.MATCwrB, addr);
 	} else if (0 != (AccFlags & kATTA_mmdvmask)) {
 		(void) LocalMMDV_Access(p, b & 0x00FF,
 			trueblnr, trueblnr, addr);
@@ -8457,6 +8516,7 @@ Label_Retry:
 			V_regs.MATCwrW.cmpmask |= 0x01;
 			m = p->usebase + (addr & p->usemask);
 			do_put_mem_word(m, w);
+			MATC_NoteWrite(V_regs.MATCwrW, addr);
 		} else if (0 != (AccFlags & kATTA_mmdvmask)) {
 			(void) LocalMMDV_Access(p, w & 0x0000FFFF,
 				trueblnr, falseblnr, addr);
@@ -8554,6 +8614,7 @@ Label_Retry:
 			V_regs.MATCwrL.cmpmask |= 0x03;
 			m = p->usebase + (addr & p->usemask);
 			do_put_mem_long(m, l);
+			MATC_NoteWrite(V_regs.MATCwrL, addr);
 		} else if (0 != (AccFlags & kATTA_mmdvmask)) {
 			(void) LocalMMDV_Access(p, (l >> 16) & 0x0000FFFF,
 				trueblnr, falseblnr, addr);
@@ -8778,6 +8839,73 @@ GLOBALPROC put_vm_long(CPTR addr, ui5r l)
 	Em_Exit();
 }
 
+/*
+	Block access, for device code that reads or writes a whole
+	parameter block. Each run of real memory is found with
+	get_real_address0 and copied at once, instead of going through
+	the MATC for every field. Anything else, such as memory mapped
+	hardware, is still accessed a byte at a time.
+*/
+
+GLOBALPROC get_vm_block(CPTR addr, ui3p Buffer, ui5r L)
+{
+	ui5b contig;
+	ui3p p;
+
+	while (0 != L) {
+		p = get_real_address0(L, falseblnr, addr, &contig);
+		if (nullpr == p) {
+			*Buffer = get_vm_byte(addr);
+			contig = 1;
+		} else {
+			MyMoveBytes((anyp)p, (anyp)Buffer, contig);
+		}
+		addr += contig;
+		Buffer += contig;
+		L -= contig;
+	}
+}
+
+GLOBALPROC put_vm_block(CPTR addr, ui3p Buffer, ui5r L)
+{
+	ui5b contig;
+	ui3p p;
+
+	while (0 != L) {
+		p = get_real_address0(L, trueblnr, addr, &contig);
+		if (nullpr == p) {
+			put_vm_byte(addr, *Buffer);
+			contig = 1;
+		} else {
+			MyMoveBytes((anyp)Buffer, (anyp)p, contig);
+		}
+		addr += contig;
+		Buffer += contig;
+		L -= contig;
+	}
+}
+
+/*
+	Host pointer to L bytes at addr, to use a structure in place.
+	If they aren't all in one block of real memory, they are
+	copied into Scratch, which must hold L bytes, and Scratch
+	is returned. Then changes must be written back with
+	put_vm_block.
+*/
+GLOBALFUNC ui3p with_vm_span(CPTR addr, ui5r L, blnr WritableMem,
+	ui3p Scratch)
+{
+	ui5b contig;
+	ui3p p = get_real_address0(L, WritableMem, addr, &contig);
+
+	if ((nullpr == p) || (contig != L)) {
+		get_vm_block(addr, Scratch, L);
+		p = Scratch;
+	}
+
+	return p;
+}
+
 GLOBALPROC SetHeadATTel(ATTep p)
 {
 	Em_Enter();
@@ -8818,6 +8946,17 @@ GLOBALPROC DiskInsertedPsuedoException(CPTR newpc, ui5b data)
 	Em_Exit();
 }
 
+GLOBALFUNC ui3r GetInterruptMask(void)
+{
+	ui3r v;
+
+	Em_Enter();
+	v = V_regs.intmask;
+	Em_Exit();
+
+	return v;
+}
+
 GLOBALPROC m68k_IPLchangeNtfy(void)
 {
 	Em_Enter();
@@ -8912,7 +9051,85 @@ GLOBALPROC m68k_reset(void)
 	Em_Exit();
 }
 
-#if SmallGlobals
+#if WantSaveStates
+/*
+	Only the state a real 68000 has goes in a save state. The
+	pointers into host memory (pc_p, the MATC caches, HeadATTel)
+	are recalculated when loading, after the memory map has been
+	set up again by Glue_StateIO.
+*/
+GLOBALPROC m68k_StateIO(void)
+{
+	CPTR pc = 0;
+
+	Em_Enter();
+
+	if (! StateIO_Loading) {
+		NeedDefaultLazyAllFlags();
+		pc = m68k_getpc();
+	}
+
+	StateIO_Var(V_regs.regs);
+	StateIO_Var(pc);
+	StateIO_Var(V_regs.intmask);
+	StateIO_Var(V_regs.t1);
+	StateIO_Var(V_regs.s);
+	StateIO_Var(V_regs.x);
+	StateIO_Var(V_regs.n);
+	StateIO_Var(V_regs.z);
+	StateIO_Var(V_regs.v);
+	StateIO_Var(V_regs.c);
+	StateIO_Var(V_regs.usp);
+	StateIO_Var(V_regs.isp);
+#if Use68020
+	StateIO_Var(V_regs.t0);
+	StateIO_Var(V_regs.m);
+	StateIO_Var(V_regs.msp);
+	StateIO_Var(V_regs.sfc);
+	StateIO_Var(V_regs.dfc);
+	StateIO_Var(V_regs.vbr);
+	StateIO_Var(V_regs.cacr);
+	StateIO_Var(V_regs.caar);
+#endif
+	StateIO_Var(V_regs.TracePending);
+	StateIO_Var(V_regs.ExternalInterruptPending);
+	StateIO_Var(V_MaxCyclesToGo);
+	StateIO_Var(V_regs.MoreCyclesToGo);
+	StateIO_Var(V_regs.ResidualCycles);
+
+	if (StateIO_Loading) {
+		V_regs.LazyFlagKind = kLazyFlagsDefault;
+		V_regs.LazyXFlagKind = kLazyFlagsDefault;
+
+		/* force Recalc_PC_Block, as in m68k_reset */
+		V_regs.pc = 0;
+		V_pc_p = (ui3p)nullpr;
+		V_pc_pHi = (ui3p)nullpr;
+		V_regs.pc_pLo = (ui3p)nullpr;
+		m68k_setpc(pc);
+	}
+
+	Em_Exit();
+}
+#endif
+
+#if WantMachinePerThread
+#include <pthread.h>
+
+/*
+	Not thread local. The decode table only depends on the
+	configuration, so all the machines share the one built first.
+*/
+static DecOpR SharedDispTable[disp_table_sz];
+static pthread_once_t SharedDispTableOnce = PTHREAD_ONCE_INIT;
+
+LOCALPROC SharedDispTable_Setup(void)
+{
+	M68KITAB_setup(SharedDispTable);
+}
+#endif
+
+#if SmallGlobals && ! WantMachinePerThread
 GLOBALPROC MINEM68K_ReserveAlloc(void)
 {
 	ReserveAllocOneBlock((ui3p *)&regs.disp_table,
@@ -8928,5 +9145,10 @@ GLOBALPROC MINEM68K_Init(
 	regs.save_regs = &regs;
 #endif
 
+#if WantMachinePerThread
+	(void) pthread_once(&SharedDispTableOnce, SharedDispTable_Setup);
+	regs.disp_table = SharedDispTable;
+#else
 	M68KITAB_setup(regs.disp_table);
+#endif
 }
@@ -22,13 +22,17 @@
 
 EXPORTPROC MINEM68K_Init(
 	ui3b *fIPL);
-#if SmallGlobals
+#if SmallGlobals && ! WantMachinePerThread
 EXPORTPROC MINEM68K_ReserveAlloc(void);
 #endif
 
 EXPORTPROC m68k_IPLchangeNtfy(void);
 EXPORTPROC DiskInsertedPsuedoException(CPTR newpc, ui5b data);
+EXPORTFUNC ui3r GetInterruptMask(void);
 EXPORTPROC m68k_reset(void);
+#if WantSaveStates
+EXPORTPROC m68k_StateIO(void);
+#endif
 
 EXPORTFUNC si5r GetCyclesRemaining(void);
 EXPORTPROC SetCyclesRemaining(si5r n);
@@ -49,5 +53,10 @@ EXPORTPROC put_vm_byte(CPTR addr, ui3r b);
 EXPORTPROC put_vm_word(CPTR addr, ui4r w);
 EXPORTPROC put_vm_long(CPTR addr, ui5r l);
 
+EXPORTPROC get_vm_block(CPTR addr, ui3p Buffer, ui5r L);
+EXPORTPROC put_vm_block(CPTR addr, ui3p Buffer, ui5r L);
+EXPORTFUNC ui3p with_vm_span(CPTR addr, ui5r L, blnr WritableMem,
+	ui3p Scratch);
+
 EXPORTPROC SetHeadATTel(ATTep p);
 EXPORTFUNC ATTep FindATTel(CPTR addr);
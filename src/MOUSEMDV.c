@@ -29,6 +29,14 @@
 
 #include "MOUSEMDV.h"
 
+/*
+	The low memory globals for the mouse, from MTemp to CrsrNew,
+	are accessed together with with_vm_span.
+*/
+#define MouseVarsBase 0x0828
+#define MouseVarsSize (0x08D0 - MouseVarsBase)
+#define MouseVar(a) (mv + ((a) - MouseVarsBase))
+
 GLOBALPROC Mouse_Update(void)
 {
 #if HaveMasterMyEvtQLock
@@ -56,17 +64,25 @@ GLOBALPROC Mouse_Update(void)
 #endif
 			(nullpr != (p = MyEvtQOutP())))
 		{
+			ui3b scratch[MouseVarsSize];
+			ui3p mv;
+			blnr Changed = falseblnr;
+
 #if EmClassicKbrd
 #if EnableMouseMotion
 			if (MyEvtQElKindMouseDelta == p->kind) {
 
 				if ((p->u.pos.h != 0) || (p->u.pos.v != 0)) {
-					put_ram_word(0x0828,
-						get_ram_word(0x0828) + p->u.pos.v);
-					put_ram_word(0x082A,
-						get_ram_word(0x082A) + p->u.pos.h);
-					put_ram_byte(0x08CE, get_ram_byte(0x08CF));
+					mv = with_vm_span(MouseVarsBase, MouseVarsSize,
+						trueblnr, scratch);
+					do_put_mem_word(MouseVar(0x0828),
+						do_get_mem_word(MouseVar(0x0828)) + p->u.pos.v);
+					do_put_mem_word(MouseVar(0x082A),
+						do_get_mem_word(MouseVar(0x082A)) + p->u.pos.h);
+					do_put_mem_byte(MouseVar(0x08CE),
+						do_get_mem_byte(MouseVar(0x08CF)));
 						/* Tell MacOS to redraw the Mouse */
+					Changed = trueblnr;
 				}
 				MyEvtQOutDone();
 			} else
@@ -75,21 +91,29 @@ GLOBALPROC Mouse_Update(void)
 			if (MyEvtQElKindMousePos == p->kind) {
 				ui5r NewMouse = (p->u.pos.v << 16) | p->u.pos.h;
 
-				if (get_ram_long(0x0828) != NewMouse) {
-					put_ram_long(0x0828, NewMouse);
+				mv = with_vm_span(MouseVarsBase, MouseVarsSize,
+					trueblnr, scratch);
+				if (do_get_mem_long(MouseVar(0x0828)) != NewMouse) {
+					do_put_mem_long(MouseVar(0x0828), NewMouse);
 						/* Set Mouse Position */
-					put_ram_long(0x082C, NewMouse);
+					do_put_mem_long(MouseVar(0x082C), NewMouse);
 #if EmClassicKbrd
-					put_ram_byte(0x08CE, get_ram_byte(0x08CF));
+					do_put_mem_byte(MouseVar(0x08CE),
+						do_get_mem_byte(MouseVar(0x08CF)));
 						/* Tell MacOS to redraw the Mouse */
 #else
-					put_ram_long(0x0830, NewMouse);
-					put_ram_byte(0x08CE, 0xFF);
+					do_put_mem_long(MouseVar(0x0830), NewMouse);
+					do_put_mem_byte(MouseVar(0x08CE), 0xFF);
 						/* Tell MacOS to redraw the Mouse */
 #endif
+					Changed = trueblnr;
 				}
 				MyEvtQOutDone();
 			}
+
+			if (Changed && (scratch == mv)) {
+				put_vm_block(MouseVarsBase, scratch, MouseVarsSize);
+			}
 		}
 	}
 
@@ -135,6 +135,27 @@ EXPORTVAR(ui5b, vSonyInsertedMask)
 #define vSonyIsInserted(Drive_No) \
 	((vSonyInsertedMask & ((ui5b)1 << (Drive_No))) != 0)
 
+#ifndef IncludeSCSIDisks
+#define IncludeSCSIDisks 0
+#endif
+
+#if IncludeSCSIDisks
+/* drives that are SCSI hard disks instead of Sony disks */
+EXPORTVAR(ui5b, vSCSIDiskMask)
+#endif
+
+#ifndef WantSaveStates
+#define WantSaveStates 0
+#endif
+
+#ifndef WantRewind
+#define WantRewind 0
+#endif
+
+#ifndef WantVarRAMSize
+#define WantVarRAMSize 0
+#endif
+
 EXPORTOSGLUFUNC tMacErr vSonyTransfer(blnr IsWrite, ui3p Buffer,
 	tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count,
 	ui5r *Sony_ActCount);
@@ -0,0 +1,1011 @@
+/*
+	OSGLUBAT.c
+
+	Copyright (C) 2023 Jesús A. Álvarez
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	Operating System GLUe for BATch runs
+
+	Runs many Macs at once, with no screen or sound, for test
+	matrices: every set of disk images on the command line is
+	started with every script, each combination being a job.
+	Jobs are run by a pool of threads, each Mac on a thread of
+	its own, so this needs WantMachinePerThread (see DFCNFCMP.h).
+	Nothing here rewinds, so WantRewind is turned off, to not
+	keep captures of every Mac.
+
+	Build on the host, from the top of the repository:
+		cc -O2 -DWantOSGLUBAT -DWantMachinePerThread=1 \
+			-DWantRewind=0 -Isrc \
+			-o minivmac-batch src/OSGLUBAT.c src/SCSIEMDV.c \
+			src/MINEM68K.c src/GLOBGLUE.c src/M68KITAB.c \
+			src/PROGMAIN.c src/IWMEMDEV.c src/VIAEMDEV.c \
+			src/SCRNEMDV.c src/SONYEMDV.c src/SNDEMDEV.c \
+			src/ROMEMDEV.c src/RTCEMDEV.c src/KBRDEMDV.c \
+			src/SCCEMDEV.c src/MOUSEMDV.c -lpthread
+
+	Run:
+		minivmac-batch [-j threads] [-r rom] [-o summary]
+			[-s script ...] disks ...
+	where each disks argument is one or more images, separated by
+	commas, to insert together (.hda images are SCSI hard disks).
+
+	The ROM is loaded and patched once, and then only read by all
+	the Macs, as is the 68000 decode table (see MINEM68K.c). Disk
+	images are mapped copy-on-write, so a job can write to its
+	disks without changing the files or the other jobs.
+
+	Scripts have one command per line, '#' starts a comment:
+		wait N          run N ticks (1/60 s)
+		launched [M]    run until an application has been launched
+		quiet N [M]     run until the screen has not changed for
+		                N ticks
+		mouse H V       move the mouse to H, V
+		down, up        press or release the mouse button
+		click           press and release the mouse button
+		keydown KEY, keyup KEY
+		key KEY         press and release a key, a letter, digit,
+		                or one of the names in BatchKeyNames
+	launched and quiet give up after M ticks, 3 emulated minutes
+	by default. With no script, each job runs "launched" and then
+	"quiet 90".
+
+	The Mac's clock starts at BatchMacStartDate and follows the
+	emulated time, so that the same job gives the same result
+	every time. The summary has one line per job, in the order
+	they were given, with tab separated fields:
+		status      ok, timeout (launched or quiet gave up),
+		            off (the Mac was shut down), or failed
+		ticks       emulated, including one more at the end,
+		            with the video on, to see the screen
+		seconds     wall time
+		screen      hash (32 bit FNV-1a) of the final screen
+		disks, script
+	Jobs are handed out longest first, as far as the scripts
+	tell, from a single queue that threads take from as they get
+	free, so a long job doesn't hold up the rest.
+*/
+
+#include "OSGCOMUI.h"
+#include "OSGCOMUD.h"
+
+#ifdef WantOSGLUBAT
+
+#if ! WantMachinePerThread
+#error "OSGLUBAT.c needs WantMachinePerThread"
+#endif
+
+#include <pthread.h>
+#include <strings.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if ! defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* --- some simple utilities --- */
+
+GLOBALOSGLUPROC MyMoveBytes(anyp srcPtr, anyp destPtr, si5b byteCount)
+{
+	(void) memcpy((char *)destPtr, (char *)srcPtr, byteCount);
+}
+
+LOCALFUNC double BatchNow(void)
+{
+	struct timespec t;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* --- sending debugging info to file --- */
+
+#if dbglog_HAVE
+
+LOCALFUNC blnr dbglog_open0(void)
+{
+	return trueblnr;
+}
+
+LOCALPROC dbglog_write0(char *s, uimr L)
+{
+	(void) fwrite(s, 1, L, stderr);
+}
+
+LOCALPROC dbglog_close0(void)
+{
+}
+
+#endif
+
+#include "COMOSGLU.h"
+#include "PBUFSTDC.h"
+#include "PROGMAIN.h"
+
+EXPORTVAR(ui3p, RAM)
+
+IMPORTFUNC blnr InitEmulation(void);
+IMPORTPROC DoEmulateOneTick(void);
+IMPORTFUNC blnr ROM_Init(void);
+EXPORTVAR(blnr, ROM_AlreadyPatched)
+
+/* --- jobs --- */
+
+/*
+	Everything in this section is set up before any Mac is
+	started and shared by all of them, so it is declared static
+	and not LOCALVAR, which is thread local.
+*/
+
+#define kCmdWait 0
+#define kCmdLaunched 1
+#define kCmdQuiet 2
+#define kCmdMouse 3
+#define kCmdButton 4
+#define kCmdKey 5
+
+typedef struct {
+	ui3r op;
+	ui5r a;
+	ui5r b;
+} BatchCmd;
+
+typedef struct {
+	char *name;
+	BatchCmd *cmds;
+	int n;
+	ui5r ticks; /* at least, to order the jobs */
+} BatchScript;
+
+typedef struct {
+	char *name;
+	char *paths[NumDrives];
+	int n;
+} BatchDisks;
+
+#define kBatchOk 0
+#define kBatchTimeout 1
+#define kBatchOff 2
+#define kBatchFailed 3
+
+static const char *BatchStatusNames[] = {
+	"ok", "timeout", "off", "failed"
+};
+
+typedef struct {
+	BatchDisks *disks;
+	BatchScript *script;
+
+	int status;
+	ui5r ticks;
+	double seconds;
+	ui5b hash;
+} BatchJob;
+
+static BatchJob *Jobs = NULL;
+static int *JobOrder = NULL;
+static int NumJobs = 0;
+
+static ui3p SharedROM = nullpr;
+
+static pthread_mutex_t JobLock = PTHREAD_MUTEX_INITIALIZER;
+static int JobNext = 0; /* in JobOrder */
+static int JobsDone = 0;
+
+/* --- drives --- */
+
+/*
+	Each image is mapped MAP_PRIVATE, writable: the pages are
+	shared with every other job using the same image until the
+	Mac writes to them, and what it writes is lost at the end.
+*/
+
+LOCALVAR ui3p DriveMaps[NumDrives];
+LOCALVAR ui5r DriveSizes[NumDrives];
+LOCALVAR char *DriveNames[NumDrives];
+
+#if IncludeSCSIDisks
+LOCALFUNC blnr IsSCSIDiskName(char *path)
+{
+	char *s = strrchr(path, '.');
+
+	return (NULL != s) && (0 == strcasecmp(s, ".hda"));
+}
+#endif
+
+LOCALFUNC blnr Sony_Insert(char *path)
+{
+	tDrive Drive_No;
+	struct stat st;
+	void *p = MAP_FAILED;
+	int fd;
+
+	if (! FirstFreeDisk(&Drive_No)) {
+		fprintf(stderr, "%s: too many disk images\n", path);
+		return falseblnr;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		if ((0 == fstat(fd, &st)) && (st.st_size > 0)
+			&& (st.st_size <= (off_t)0xFFFFFFFF))
+		{
+			p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE, fd, 0);
+		}
+		(void) close(fd); /* the mapping stays */
+	}
+	if (MAP_FAILED == p) {
+		perror(path);
+		return falseblnr;
+	}
+
+	DriveMaps[Drive_No] = (ui3p)p;
+	DriveSizes[Drive_No] = st.st_size;
+	DriveNames[Drive_No] = path;
+#if IncludeSCSIDisks
+	if (IsSCSIDiskName(path)) {
+		vSCSIDiskMask |= ((ui5b)1 << Drive_No);
+	}
+#endif
+	DiskInsertNotify(Drive_No, falseblnr);
+
+	return trueblnr;
+}
+
+GLOBALOSGLUFUNC tMacErr vSonyTransfer(blnr IsWrite, ui3p Buffer,
+	tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count,
+	ui5r *Sony_ActCount)
+{
+	tMacErr err = mnvm_miscErr;
+	ui5r size = DriveSizes[Drive_No];
+	ui5r n = 0;
+
+	if (Sony_Start <= size) {
+		n = size - Sony_Start;
+		if (n > Sony_Count) {
+			n = Sony_Count;
+		}
+#if WantRewind
+		if (IsWrite) {
+			EmulationRewindDiskWrite(Drive_No, Sony_Start, n);
+		}
+#endif
+		if (IsWrite) {
+			(void) memcpy(DriveMaps[Drive_No] + Sony_Start, Buffer, n);
+		} else {
+			(void) memcpy(Buffer, DriveMaps[Drive_No] + Sony_Start, n);
+		}
+		if (n == Sony_Count) {
+			err = mnvm_noErr;
+		}
+	}
+
+	if (nullpr != Sony_ActCount) {
+		*Sony_ActCount = n;
+	}
+
+	return err;
+}
+
+GLOBALOSGLUFUNC tMacErr vSonyGetSize(tDrive Drive_No, ui5r *Sony_Count)
+{
+	*Sony_Count = DriveSizes[Drive_No];
+	return mnvm_noErr;
+}
+
+GLOBALOSGLUFUNC tMacErr vSonyEject(tDrive Drive_No)
+{
+	if (nullpr != DriveMaps[Drive_No]) {
+		(void) munmap(DriveMaps[Drive_No], DriveSizes[Drive_No]);
+		DriveMaps[Drive_No] = nullpr;
+	}
+	DiskEjectedNotify(Drive_No);
+
+	return mnvm_noErr;
+}
+
+#if IncludeSonyGetName
+GLOBALOSGLUFUNC tMacErr vSonyGetName(tDrive Drive_No, tPbuf *r)
+{
+	char *s = strrchr(DriveNames[Drive_No], '/');
+	char *p;
+
+	s = (NULL == s) ? DriveNames[Drive_No] : s + 1;
+	p = strdup(s);
+	if (NULL == p) {
+		return mnvm_miscErr;
+	}
+	return PbufNewFromPtr(p, strlen(p), r);
+}
+#endif
+
+LOCALPROC UnInitDrives(void)
+{
+	tDrive i;
+
+	for (i = 0; i < NumDrives; ++i) {
+		if (vSonyIsInserted(i)) {
+			(void) vSonyEject(i);
+		}
+	}
+}
+
+/* --- video out --- */
+
+GLOBALOSGLUPROC DoneWithDrawingForTick(void)
+{
+}
+
+LOCALFUNC ui5b ScreenHash(void)
+{
+	/* screencomparebuff is the screen as of the last tick drawn */
+	ui5b h = 0x811C9DC5;
+	uimr i;
+
+	for (i = 0; i < vMacScreenNumBytes; ++i) {
+		h = (h ^ screencomparebuff[i]) * 0x01000193;
+	}
+	return h;
+}
+
+/* --- time, date --- */
+
+#define BatchMacStartDate 0xAB2BA100 /* 1 January 1995, 00:00 */
+
+GLOBALOSGLUFUNC blnr ExtraTimeNotOver(void)
+{
+	return falseblnr; /* only ticks are run, never extra time */
+}
+
+GLOBALOSGLUPROC WaitForNextTick(void)
+{
+	/* not called, there is no MainEventLoop */
+}
+
+/* --- scripts --- */
+
+typedef struct {
+	char *name;
+	ui3r key;
+} BatchKeyName;
+
+static const BatchKeyName BatchKeyNames[] = {
+	{ "a", MKC_A }, { "b", MKC_B }, { "c", MKC_C }, { "d", MKC_D },
+	{ "e", MKC_E }, { "f", MKC_F }, { "g", MKC_G }, { "h", MKC_H },
+	{ "i", MKC_I }, { "j", MKC_J }, { "k", MKC_K }, { "l", MKC_L },
+	{ "m", MKC_M }, { "n", MKC_N }, { "o", MKC_O }, { "p", MKC_P },
+	{ "q", MKC_Q }, { "r", MKC_R }, { "s", MKC_S }, { "t", MKC_T },
+	{ "u", MKC_U }, { "v", MKC_V }, { "w", MKC_W }, { "x", MKC_X },
+	{ "y", MKC_Y }, { "z", MKC_Z },
+	{ "0", MKC_0 }, { "1", MKC_1 }, { "2", MKC_2 }, { "3", MKC_3 },
+	{ "4", MKC_4 }, { "5", MKC_5 }, { "6", MKC_6 }, { "7", MKC_7 },
+	{ "8", MKC_8 }, { "9", MKC_9 },
+	{ "command", MKC_Command }, { "shift", MKC_Shift },
+	{ "option", MKC_Option }, { "control", MKC_Control },
+	{ "capslock", MKC_CapsLock },
+	{ "space", MKC_Space }, { "return", MKC_Return },
+	{ "enter", MKC_Enter }, { "tab", MKC_Tab },
+	{ "backspace", MKC_BackSpace }, { "escape", MKC_Escape },
+	{ "left", MKC_Left }, { "right", MKC_Right },
+	{ "up", MKC_Up }, { "down", MKC_Down },
+	{ "minus", MKC_Minus }, { "equal", MKC_Equal },
+	{ "comma", MKC_Comma }, { "period", MKC_Period },
+	{ "slash", MKC_Slash }, { "backslash", MKC_BackSlash },
+	{ "semicolon", MKC_SemiColon }, { "quote", MKC_SingleQuote },
+	{ "grave", MKC_Grave },
+	{ "leftbracket", MKC_LeftBracket },
+	{ "rightbracket", MKC_RightBracket }
+};
+
+#define BatchNumKeyNames \
+	((int)(sizeof(BatchKeyNames) / sizeof(BatchKeyName)))
+
+#define BatchPressTicks 3 /* how long click and key hold down */
+#define BatchCheckTicks 10 /* video on every so often, to compare */
+#define BatchMaxTicks (60 * 60 * 3)
+#define CurApNameAddr 0x0910 /* low memory, empty until a launch */
+
+LOCALFUNC blnr Script_Add(BatchScript *s, ui3r op, ui5r a, ui5r b)
+{
+	BatchCmd *p = (BatchCmd *)realloc(s->cmds,
+		(s->n + 1) * sizeof(BatchCmd));
+
+	if (NULL == p) {
+		return falseblnr;
+	}
+	s->cmds = p;
+	p[s->n].op = op;
+	p[s->n].a = a;
+	p[s->n].b = b;
+	++s->n;
+	if ((kCmdWait == op) || (kCmdQuiet == op)) {
+		s->ticks += a;
+	}
+
+	return trueblnr;
+}
+
+LOCALFUNC blnr Script_Num(char *p, ui5r *r)
+{
+	char *end;
+	unsigned long v = strtoul(p, &end, 10);
+
+	if ((p == end) || (0 != *end) || (v > 0xFFFFFFFF)) {
+		return falseblnr;
+	}
+	*r = v;
+	return trueblnr;
+}
+
+LOCALFUNC blnr Script_Key(char *p, ui5r *r)
+{
+	int i;
+
+	for (i = 0; i < BatchNumKeyNames; ++i) {
+		if (0 == strcasecmp(p, BatchKeyNames[i].name)) {
+			*r = BatchKeyNames[i].key;
+			return trueblnr;
+		}
+	}
+	return falseblnr;
+}
+
+LOCALFUNC blnr Script_Line(BatchScript *s, char *line)
+{
+	char cmd[16];
+	char a1[32];
+	char a2[32];
+	ui5r a;
+	ui5r b = BatchMaxTicks;
+	char *p = strchr(line, '#');
+	int n;
+
+	if (NULL != p) {
+		*p = 0;
+	}
+	n = sscanf(line, "%15s %31s %31s", cmd, a1, a2);
+	if (n <= 0) {
+		return trueblnr; /* blank */
+	}
+
+	if (0 == strcmp(cmd, "wait")) {
+		return (2 == n) && Script_Num(a1, &a)
+			&& Script_Add(s, kCmdWait, a, 0);
+	} else if (0 == strcmp(cmd, "launched")) {
+		return ((1 == n) || ((2 == n) && Script_Num(a1, &b)))
+			&& Script_Add(s, kCmdLaunched, 0, b);
+	} else if (0 == strcmp(cmd, "quiet")) {
+		return ((2 == n) || ((3 == n) && Script_Num(a2, &b)))
+			&& Script_Num(a1, &a)
+			&& Script_Add(s, kCmdQuiet, a, b);
+	} else if (0 == strcmp(cmd, "mouse")) {
+		return (3 == n) && Script_Num(a1, &a) && Script_Num(a2, &b)
+			&& (a < vMacScreenWidth) && (b < vMacScreenHeight)
+			&& Script_Add(s, kCmdMouse, a, b);
+	} else if ((0 == strcmp(cmd, "down")) || (0 == strcmp(cmd, "up")))
+	{
+		return (1 == n) && Script_Add(s, kCmdButton, 'd' == cmd[0], 0);
+	} else if (0 == strcmp(cmd, "click")) {
+		return (1 == n) && Script_Add(s, kCmdButton, 1, 0)
+			&& Script_Add(s, kCmdWait, BatchPressTicks, 0)
+			&& Script_Add(s, kCmdButton, 0, 0);
+	} else if (0 == strcmp(cmd, "keydown")) {
+		return (2 == n) && Script_Key(a1, &a)
+			&& Script_Add(s, kCmdKey, a, 1);
+	} else if (0 == strcmp(cmd, "keyup")) {
+		return (2 == n) && Script_Key(a1, &a)
+			&& Script_Add(s, kCmdKey, a, 0);
+	} else if (0 == strcmp(cmd, "key")) {
+		return (2 == n) && Script_Key(a1, &a)
+			&& Script_Add(s, kCmdKey, a, 1)
+			&& Script_Add(s, kCmdWait, BatchPressTicks, 0)
+			&& Script_Add(s, kCmdKey, a, 0);
+	}
+	return falseblnr;
+}
+
+LOCALFUNC blnr Script_Load(BatchScript *s, char *path)
+{
+	char line[256];
+	int lineno = 0;
+	FILE *f = fopen(path, "r");
+
+	if (NULL == f) {
+		perror(path);
+		return falseblnr;
+	}
+	s->name = path;
+	while (NULL != fgets(line, sizeof(line), f)) {
+		++lineno;
+		if (! Script_Line(s, line)) {
+			fprintf(stderr, "%s:%d: bad command\n", path, lineno);
+			fclose(f);
+			return falseblnr;
+		}
+	}
+	fclose(f);
+
+	return trueblnr;
+}
+
+LOCALVAR ui5r JobTicks = 0;
+
+LOCALPROC Job_Tick(blnr Video)
+{
+	EmVideoDisable = ! Video;
+	DoEmulateOneTick();
+	++JobTicks;
+	CurMacDateInSeconds = BatchMacStartDate + JobTicks / 60;
+}
+
+LOCALPROC Job_Wait(ui5r n)
+{
+	for (; (0 != n) && ! ForceMacOff; --n) {
+		Job_Tick(falseblnr);
+	}
+}
+
+LOCALFUNC blnr Job_WaitLaunched(ui5r max)
+{
+	ui5r t = 0;
+
+	while (0 == RAM[CurApNameAddr]) {
+		if ((t >= max) || ForceMacOff) {
+			return falseblnr;
+		}
+		Job_Tick(falseblnr);
+		++t;
+	}
+	return trueblnr;
+}
+
+LOCALFUNC blnr Job_WaitQuiet(ui5r n, ui5r max)
+{
+	/*
+		As in the Playdate fast boot, the video is only on every
+		BatchCheckTicks, so ScreenFindChanges compares the screen
+		with the last check.
+	*/
+	ui5r t = 0;
+	ui5r quiet = 0;
+	blnr Check;
+
+	ScreenClearChanges();
+	while (quiet < n) {
+		if ((t >= max) || ForceMacOff) {
+			return falseblnr;
+		}
+		++t;
+		Check = (0 == (t % BatchCheckTicks));
+		Job_Tick(Check);
+		if (Check) {
+			if (ScreenChangedBottom > ScreenChangedTop) {
+				ScreenClearChanges();
+				quiet = 0;
+			} else {
+				quiet += BatchCheckTicks;
+			}
+		}
+	}
+	return trueblnr;
+}
+
+LOCALFUNC int Script_Run(BatchScript *s)
+{
+	BatchCmd *c;
+	int i;
+	int status = kBatchOk;
+
+	for (i = 0; (i < s->n) && ! ForceMacOff; ++i) {
+		c = &s->cmds[i];
+		switch (c->op) {
+			case kCmdWait:
+				Job_Wait(c->a);
+				break;
+			case kCmdLaunched:
+				if (! Job_WaitLaunched(c->b)) {
+					status = kBatchTimeout;
+				}
+				break;
+			case kCmdQuiet:
+				if (! Job_WaitQuiet(c->a, c->b)) {
+					status = kBatchTimeout;
+				}
+				break;
+			case kCmdMouse:
+				MyMousePositionSet(c->a, c->b);
+				break;
+			case kCmdButton:
+				MyMouseButtonSet(0 != c->a);
+				break;
+			case kCmdKey:
+				Keyboard_UpdateKeyMap(c->a, 0 != c->b);
+				break;
+		}
+	}
+
+	if (ForceMacOff) {
+		status = kBatchOff;
+	} else {
+		Job_Tick(trueblnr);
+	}
+
+	return status;
+}
+
+/* --- memory --- */
+
+LOCALPROC ReserveAllocAll(void)
+{
+#if dbglog_HAVE
+	dbglog_ReserveAlloc();
+#endif
+	ReserveAllocOneBlock(&screencomparebuff,
+		vMacScreenNumBytes, 5, trueblnr);
+
+	EmulationReserveAlloc();
+}
+
+LOCALFUNC blnr AllocMyMemory(void)
+{
+	uimr n;
+	blnr IsOk = falseblnr;
+
+	ReserveAllocOffset = 0;
+	ReserveAllocBigBlock = nullpr;
+	ReserveAllocAll();
+	n = ReserveAllocOffset;
+	ReserveAllocBigBlock = (ui3p)calloc(1, n);
+	if (NULL == ReserveAllocBigBlock) {
+		fprintf(stderr, "out of memory\n");
+	} else {
+		ReserveAllocOffset = 0;
+		ReserveAllocAll();
+		if (n != ReserveAllocOffset) {
+			/* oops, program error */
+		} else {
+			IsOk = trueblnr;
+		}
+	}
+
+	return IsOk;
+}
+
+LOCALPROC UnallocMyMemory(void)
+{
+	if (nullpr != ReserveAllocBigBlock) {
+		free((char *)ReserveAllocBigBlock);
+	}
+}
+
+LOCALFUNC blnr InsertJobDisks(BatchDisks *d)
+{
+	int i;
+
+	for (i = 0; i < d->n; ++i) {
+		if (! Sony_Insert(d->paths[i])) {
+			return falseblnr;
+		}
+	}
+	return trueblnr;
+}
+
+LOCALFUNC blnr InitOSGLU(BatchJob *j)
+{
+	blnr IsOk = falseblnr;
+
+	ROM = SharedROM;
+	ROM_AlreadyPatched = trueblnr;
+	CurMacDateInSeconds = BatchMacStartDate;
+
+	if (AllocMyMemory())
+#if dbglog_HAVE
+	if (dbglog_open())
+#endif
+	if (InsertJobDisks(j->disks))
+	{
+		InitKeyCodes();
+		IsOk = trueblnr;
+	}
+
+	return IsOk;
+}
+
+LOCALPROC UnInitOSGLU(void)
+{
+#if IncludePbufs
+	UnInitPbufs();
+#endif
+	UnInitDrives();
+
+#if dbglog_HAVE
+	dbglog_close();
+#endif
+
+	UnallocMyMemory();
+}
+
+/* --- thread pool --- */
+
+/*
+	Each job gets a thread of its own, started by one of the
+	pool's, so that it begins with all the thread local
+	variables as they are declared, as a new process would.
+*/
+
+LOCALFUNC void * Job_Main(void *arg)
+{
+	BatchJob *j = (BatchJob *)arg;
+	double t0 = BatchNow();
+
+	j->status = kBatchFailed;
+	if (InitOSGLU(j)) {
+		if (InitEmulation()) {
+			j->status = Script_Run(j->script);
+			j->hash = ScreenHash();
+		}
+	}
+	UnInitOSGLU();
+
+	j->ticks = JobTicks;
+	j->seconds = BatchNow() - t0;
+
+	return NULL;
+}
+
+LOCALFUNC void * Pool_Main(void *arg)
+{
+	pthread_t t;
+	BatchJob *j;
+	int i;
+
+	(void) arg;
+	for (; ; ) {
+		(void) pthread_mutex_lock(&JobLock);
+		i = (JobNext < NumJobs) ? JobOrder[JobNext++] : -1;
+		(void) pthread_mutex_unlock(&JobLock);
+		if (i < 0) {
+			break;
+		}
+
+		j = &Jobs[i];
+		if (0 == pthread_create(&t, NULL, Job_Main, j)) {
+			(void) pthread_join(t, NULL);
+		} else {
+			j->status = kBatchFailed;
+		}
+
+		(void) pthread_mutex_lock(&JobLock);
+		++JobsDone;
+		fprintf(stderr, "[%d/%d] %s %s: %s, %u ticks, %.2f s\n",
+			JobsDone, NumJobs, j->disks->name, j->script->name,
+			BatchStatusNames[j->status], (unsigned)j->ticks,
+			j->seconds);
+		(void) pthread_mutex_unlock(&JobLock);
+	}
+
+	return NULL;
+}
+
+/* --- main program flow --- */
+
+LOCALFUNC blnr LoadMacRom(char *path)
+{
+	/*
+		Patched here once, then made read only, for all the Macs
+		to share (see ROM_AlreadyPatched in ROMEMDEV.c).
+	*/
+	void *p = mmap(NULL, kROM_Size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	FILE *f = fopen(path, "rb");
+	blnr IsOk = falseblnr;
+
+	if (NULL == f) {
+		perror(path);
+	} else if (MAP_FAILED == p) {
+		fprintf(stderr, "out of memory\n");
+	} else if (fread(p, 1, kROM_Size, f) != kROM_Size) {
+		fprintf(stderr, "%s: not a ROM image\n", path);
+	} else {
+		SharedROM = (ui3p)p;
+		ROM = SharedROM;
+		IsOk = ROM_Init()
+			&& (0 == mprotect(p, kROM_Size, PROT_READ));
+	}
+	if (NULL != f) {
+		fclose(f);
+	}
+
+	return IsOk;
+}
+
+LOCALFUNC blnr ParseDisks(BatchDisks *d, char *arg)
+{
+	char *s = strdup(arg);
+	char *p;
+
+	d->name = arg;
+	d->n = 0;
+	for (p = strtok(s, ","); NULL != p; p = strtok(NULL, ",")) {
+		if (d->n >= NumDrives) {
+			fprintf(stderr, "%s: too many disk images\n", arg);
+			return falseblnr;
+		}
+		d->paths[d->n++] = p;
+	}
+	return trueblnr;
+}
+
+LOCALFUNC int JobCompare(const void *a, const void *b)
+{
+	int i = *(const int *)a;
+	int k = *(const int *)b;
+	ui5r ti = Jobs[i].script->ticks;
+	ui5r tk = Jobs[k].script->ticks;
+
+	if (ti != tk) {
+		return (ti > tk) ? -1 : 1;
+	}
+	return i - k;
+}
+
+LOCALFUNC blnr WriteSummary(char *path, int nthreads, double seconds)
+{
+	FILE *f = (NULL == path) ? stdout : fopen(path, "w");
+	BatchJob *j;
+	int i;
+
+	if (NULL == f) {
+		perror(path);
+		return falseblnr;
+	}
+	fprintf(f, "# %d jobs, %d threads, %.2f s\n",
+		NumJobs, nthreads, seconds);
+	fprintf(f, "# status\tticks\tseconds\tscreen\tdisks\tscript\n");
+	for (i = 0; i < NumJobs; ++i) {
+		j = &Jobs[i];
+		if (kBatchFailed == j->status) {
+			fprintf(f, "%s\t%u\t%.3f\t-",
+				BatchStatusNames[j->status], (unsigned)j->ticks,
+				j->seconds);
+		} else {
+			fprintf(f, "%s\t%u\t%.3f\t%08x",
+				BatchStatusNames[j->status], (unsigned)j->ticks,
+				j->seconds, (unsigned)j->hash);
+		}
+		fprintf(f, "\t%s\t%s\n", j->disks->name, j->script->name);
+	}
+
+	return (stdout == f) || (0 == fclose(f));
+}
+
+LOCALPROC Usage(void)
+{
+	fprintf(stderr,
+		"usage: minivmac-batch [-j threads] [-r rom] [-o summary]\n"
+		"           [-s script ...] disk[,disk...] ...\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	char *rom = RomFileName;
+	char *out = NULL;
+	int nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	BatchScript *scripts = NULL;
+	int nscripts = 0;
+	BatchDisks *disks;
+	int ndisks;
+	pthread_t *pool;
+	double t0;
+	int i;
+	int k;
+	int c;
+
+	scripts = (BatchScript *)calloc(argc + 1, sizeof(BatchScript));
+	disks = (BatchDisks *)calloc(argc + 1, sizeof(BatchDisks));
+	if ((NULL == scripts) || (NULL == disks)) {
+		return 1;
+	}
+
+	while (-1 != (c = getopt(argc, argv, "j:r:o:s:"))) {
+		switch (c) {
+			case 'j':
+				nthreads = atoi(optarg);
+				break;
+			case 'r':
+				rom = optarg;
+				break;
+			case 'o':
+				out = optarg;
+				break;
+			case 's':
+				if (! Script_Load(&scripts[nscripts++], optarg)) {
+					return 1;
+				}
+				break;
+			default:
+				Usage();
+		}
+	}
+	if (nthreads < 1) {
+		nthreads = 1;
+	}
+
+	if (0 == nscripts) {
+		scripts[0].name = "-";
+		if (! (Script_Add(&scripts[0], kCmdLaunched, 0, BatchMaxTicks)
+			&& Script_Add(&scripts[0], kCmdQuiet, 90, BatchMaxTicks)))
+		{
+			return 1;
+		}
+		nscripts = 1;
+	}
+	ndisks = argc - optind;
+	for (i = 0; i < ndisks; ++i) {
+		if (! ParseDisks(&disks[i], argv[optind + i])) {
+			return 1;
+		}
+	}
+	if (0 == ndisks) {
+		disks[0].name = "-";
+		ndisks = 1;
+	}
+
+	if (! LoadMacRom(rom)) {
+		return 1;
+	}
+
+	NumJobs = ndisks * nscripts;
+	Jobs = (BatchJob *)calloc(NumJobs, sizeof(BatchJob));
+	JobOrder = (int *)calloc(NumJobs, sizeof(int));
+	pool = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+	if ((NULL == Jobs) || (NULL == JobOrder) || (NULL == pool)) {
+		return 1;
+	}
+	for (i = 0; i < ndisks; ++i) {
+		for (k = 0; k < nscripts; ++k) {
+			Jobs[i * nscripts + k].disks = &disks[i];
+			Jobs[i * nscripts + k].script = &scripts[k];
+		}
+	}
+	for (i = 0; i < NumJobs; ++i) {
+		JobOrder[i] = i;
+	}
+	qsort(JobOrder, NumJobs, sizeof(int), JobCompare);
+
+	t0 = BatchNow();
+	for (i = 0; i < nthreads; ++i) {
+		if (0 != pthread_create(&pool[i], NULL, Pool_Main, NULL)) {
+			break;
+		}
+	}
+	if (0 == i) {
+		fprintf(stderr, "could not start any threads\n");
+		return 1;
+	}
+	nthreads = i;
+	for (i = 0; i < nthreads; ++i) {
+		(void) pthread_join(pool[i], NULL);
+	}
+
+	return WriteSummary(out, nthreads, BatchNow() - t0) ? 0 : 1;
+}
+
+#endif /* WantOSGLUBAT */
@@ -28,10 +28,8 @@ PlaydateAPI *pd = NULL;
 
 #pragma mark - Initialization
 
-// emulating in update callbacks is slow
-#define TargetFPS 15
-#define TargetSpeed 1.0
-#define TicksPerFrame ((60 / TargetFPS) * TargetSpeed)
+// emulating in update callbacks is slow, start at 15 fps
+#define InitialRefreshRateIndex 2
 
 #define kRAM_Size (kRAMa_Size + kRAMb_Size)
 EXPORTVAR(ui3p, RAM)
@@ -64,9 +62,26 @@ FORWARDFUNC int DoUpdate(void* userdata);
 FORWARDPROC UnInitOSGLU(void);
 
 LOCALVAR blnr showFPS = falseblnr;
+FORWARDPROC DiskCache_FlushAll(void);
+FORWARDPROC SetRefreshRateIndex(int i);
+FORWARDPROC StartUpTimeAdjust(void);
 LOCALVAR PDMenuItem *fpsMenuItem, *inputMenuItem;
 FORWARDPROC SetDpadMode(blnr mouse);
 FORWARDPROC InsertDiskMenuCallback(void *userdata);
+#if WantSaveStates
+FORWARDFUNC blnr SaveState_Read(void);
+FORWARDPROC SaveState_Write(void);
+LOCALVAR blnr SaveStateWanted = falseblnr;
+#endif
+#if WantFastBoot
+FORWARDPROC FastBoot_Start(void);
+#endif
+#if WantRewind
+IMPORTFUNC blnr EmulationRewind(void);
+IMPORTPROC EmulationRewindForget(void);
+IMPORTPROC EmulationRewindDiskWrite(tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count);
+FORWARDFUNC blnr RewindInput(void);
+#endif
 
 void FPSMenuCallback(void *userdata) {
     showFPS = pd->system->getMenuItemValue(fpsMenuItem);
@@ -93,8 +108,22 @@ int eventHandler(PlaydateAPI* api, PDSystemEvent event, uint32_t arg) {
         case kEventInit:
             ZapOSGLUVars();
             if (InitOSGLU() && InitEmulation()) {
-                pd->system->logToConsole("Welcome to Macintosh");
-                pd->display->setRefreshRate(TargetFPS);
+#if WantSaveStates
+                if (SaveState_Read()) {
+                    pd->system->logToConsole("Welcome back to Macintosh");
+                } else
+#endif
+                {
+                    pd->system->logToConsole("Welcome to Macintosh");
+#if WantFastBoot
+                    FastBoot_Start();
+#endif
+                }
+#if WantSaveStates
+                SaveStateWanted = trueblnr;
+#endif
+                SetRefreshRateIndex(InitialRefreshRateIndex);
+                StartUpTimeAdjust();
                 pd->display->setInverted(1);
                 pd->system->setUpdateCallback(DoUpdate, pd);
                 InitMenus();
@@ -104,8 +133,17 @@ int eventHandler(PlaydateAPI* api, PDSystemEvent event, uint32_t arg) {
             break;
         case kEventTerminate:
             pd->system->logToConsole("Bye!");
+#if WantSaveStates
+            if (SaveStateWanted) {
+                SaveState_Write();
+            }
+#endif
             UnInitOSGLU();
             break;
+        case kEventLock:
+            // might not come back
+            DiskCache_FlushAll();
+            break;
         default:
             break;
     }
@@ -142,6 +180,13 @@ LOCALPROC dbglog_close0(void) {}
 FORWARDPROC DrawInsertDiskMenuBody(void);
 FORWARDFUNC const char* InsertDiskMenuTitle(void);
 #include "CONTROLM.h"
+#if WantCompressedDisks || WantSaveStates
+#define DskCmp_WantEncode WantSaveStates
+#include "DSKCMPRS.h"
+#endif
+#if WantFolderVolumes
+#include "FLDRVOLM.h"
+#endif
 
 GLOBALPROC DoneWithDrawingForTick(void) {
     // draw in update callback
@@ -152,6 +197,10 @@ GLOBALPROC DoneWithDrawingForTick(void) {
 
 LOCALVAR blnr dpadIsMouse = trueblnr;
 LOCALVAR int MouseAccel;
+LOCALVAR float CrankChange; // read once per update
+#if WantRewind
+LOCALVAR blnr Rewinding = falseblnr; // B is held for rewinding
+#endif
 FORWARDPROC HandleDiskMenuInput(PDButtons pushed, float crankChange);
 
 LOCALPROC SetDpadMode(blnr mouse) {
@@ -169,7 +218,7 @@ LOCALPROC UpdateInput(void) {
     pd->system->getButtonState(&current, &pushed, &released);
 
     if (SpecialModeTst(SpclModeInsertDisk)) {
-        HandleDiskMenuInput(pushed, pd->system->getCrankChange());
+        HandleDiskMenuInput(pushed, CrankChange);
         return;
     }
 
@@ -195,10 +244,17 @@ LOCALPROC UpdateInput(void) {
     MyMouseButtonSet(current & kButtonA);
 
     // Button B: space bar
-    Keyboard_UpdateKeyMap(MKC_Space, current & kButtonB);
+#if WantRewind
+    if (Rewinding) {
+        // released when rewinding began
+    } else
+#endif
+    {
+        Keyboard_UpdateKeyMap(MKC_Space, current & kButtonB);
+    }
 
     // Crank: arrow up/down
-    float crank = pd->system->getCrankChange();
+    float crank = CrankChange;
     if (crank < -CrankThreshold) {
         // counter-clockwise: arrow up
         Keyboard_UpdateKeyMap(0x48, falseblnr);
@@ -214,6 +270,57 @@ LOCALPROC UpdateInput(void) {
     }
 }
 
+#if WantRewind
+
+/*
+    Holding B and turning the crank backwards goes back in time,
+    one capture (see RWNDRING.h) for every RewindCrankStep degrees.
+    Emulation is paused until B is let go, and then carries on
+    from there.
+*/
+
+#define RewindCrankStep 30.f
+
+LOCALVAR float RewindCrank;
+
+// true while rewinding, instead of running the emulation
+LOCALFUNC blnr RewindInput(void) {
+    PDButtons current, pushed, released;
+    pd->system->getButtonState(&current, &pushed, &released);
+
+    if (!(current & kButtonB) || SpecialModeTst(SpclModeInsertDisk)) {
+        Rewinding = falseblnr;
+        return falseblnr;
+    }
+    if (!Rewinding) {
+        if (CrankChange >= -CrankThreshold) {
+            return falseblnr;
+        }
+        Rewinding = trueblnr;
+        RewindCrank = 0.0f;
+        // the space bar from B, and the arrow keys from the crank
+        Keyboard_UpdateKeyMap(MKC_Space, falseblnr);
+        Keyboard_UpdateKeyMap(0x4D, falseblnr);
+        Keyboard_UpdateKeyMap(0x48, falseblnr);
+    }
+
+    RewindCrank += CrankChange;
+    while (RewindCrank <= -RewindCrankStep) {
+        RewindCrank += RewindCrankStep;
+        if (!EmulationRewind()) {
+            // nothing older
+            RewindCrank = 0.0f;
+        }
+    }
+    if (RewindCrank > 0.0f) {
+        // can't go forward again
+        RewindCrank = 0.0f;
+    }
+    return trueblnr;
+}
+
+#endif
+
 #pragma mark - Screen
 
 LOCALFUNC blnr Screen_Init(void) {
@@ -224,46 +331,152 @@ LOCALPROC Screen_UnInit(void) {
 
 }
 
+#if WantScreenRecord
+
+#define ScrnRecFileName "recording.vmr"
+LOCALVAR SDFile *ScrnRecFile = NULL;
+
+LOCALPROC ScrnRec_WriteOut(ui3p p, uimr n) {
+    if (ScrnRecFile != NULL) {
+        pd->file->write(ScrnRecFile, p, (unsigned int)n);
+    }
+}
+
+LOCALFUNC blnr ScrnRec_Open(void) {
+    ScrnRecFile = pd->file->open(ScrnRecFileName, kFileWrite);
+    if (ScrnRecFile == NULL) {
+        // not fatal, just don't record
+        pd->system->logToConsole("Opening %s: %s", ScrnRecFileName, pd->file->geterr());
+    } else {
+        ScrnRec_Start();
+    }
+    return trueblnr;
+}
+
+LOCALPROC ScrnRec_Close(void) {
+    if (ScrnRecFile != NULL) {
+        ScrnRec_Stop();
+        pd->file->close(ScrnRecFile);
+        ScrnRecFile = NULL;
+    }
+}
+
+#endif
+
 #pragma mark - Time and Space
 
 #define MyTickDuration (1.0f / 60.14742f)
 LOCALVAR ui5b NewMacDateInSeconds;
 
-#if 0
+/*
+    Adaptive scheduler.
+
+    The emulated machine runs on a 60.14742 Hz time base. Every
+    update callback converts the wall time elapsed since the
+    previous one into TrueEmulatedTime, then runs as many ticks as
+    are owed, limited by the time left in this frame as predicted
+    by the measured cost of one tick. Only the last tick of a
+    frame is drawn. If we are not lagging, emulation never runs
+    ahead of real time.
+
+    The display refresh rate is picked from RefreshRates: when
+    emulation keeps falling behind the rate is lowered, so that
+    less time is spent presenting frames; when there is spare
+    time and the screen is changing, it is raised again.
+
+    getElapsedTime is reset once per update callback, here only.
+*/
+
+#define MaxTicksPerFrame 12 /* most ticks run in one update */
+#define MaxLagTicks 24 /* beyond this, lost time is forgotten */
+#define FrameBudgetFraction 0.85f /* rest is for presenting */
+#define SchedAdjustFrames 16 /* frames between rate changes */
+
+LOCALVAR const int RefreshRates[] = { 5, 10, 15, 20, 30 };
+#define NumRefreshRates ((int)(sizeof(RefreshRates) / sizeof(int)))
+
 LOCALVAR ui5b TrueEmulatedTime = 0;
+LOCALVAR ui5b EmulatedTicksDone = 0;
 LOCALVAR float NextTickChangeTime;
+LOCALVAR float FrameBudget;
+LOCALVAR float TickTimeAvg = 3.5f * MyTickDuration;
+LOCALVAR int CurRefreshIndex = InitialRefreshRateIndex;
+LOCALVAR int SchedFrames = 0;
+LOCALVAR int SchedBehindFrames = 0;
+LOCALVAR int SchedDrawnFrames = 0;
+LOCALVAR float SchedBusyTime = 0.0f;
+
+LOCALPROC SetRefreshRateIndex(int i) {
+    CurRefreshIndex = i;
+    FrameBudget = FrameBudgetFraction / RefreshRates[i];
+    pd->display->setRefreshRate(RefreshRates[i]);
+}
 
 LOCALPROC UpdateTrueEmulatedTime(void) {
     float TimeDiff = pd->system->getElapsedTime() - NextTickChangeTime;
 
+    pd->system->resetElapsedTime();
     if (TimeDiff >= 0.0f) {
-        if (TimeDiff > 16 * MyTickDuration) {
+        if (TimeDiff > MaxLagTicks * MyTickDuration) {
             // emulation interrupted, forget it
             ++TrueEmulatedTime;
             NextTickChangeTime = MyTickDuration;
-        } else {
-            do {
-                ++TrueEmulatedTime;
-                TimeDiff -= MyTickDuration;
-                NextTickChangeTime += MyTickDuration;
-            } while (TimeDiff >= 0.0f);
-            NextTickChangeTime -= pd->system->getElapsedTime();
+            return;
         }
-        pd->system->resetElapsedTime();
+        do {
+            ++TrueEmulatedTime;
+            TimeDiff -= MyTickDuration;
+        } while (TimeDiff >= 0.0f);
     }
+    NextTickChangeTime = -TimeDiff;
 }
 
 LOCALPROC StartUpTimeAdjust(void) {
     pd->system->resetElapsedTime();
     NextTickChangeTime = MyTickDuration;
+    EmulatedTicksDone = TrueEmulatedTime;
 }
 
+GLOBALFUNC blnr ExtraTimeNotOver(void) {
+    // room for one more tick in this frame?
+    return (pd->system->getElapsedTime() + TickTimeAvg) < FrameBudget;
+}
+
+LOCALPROC SchedulerAdjustRate(blnr Behind, blnr Drawn, float BusyTime) {
+    SchedBehindFrames += Behind ? 1 : 0;
+    SchedDrawnFrames += Drawn ? 1 : 0;
+    SchedBusyTime += BusyTime;
+    if (++SchedFrames < SchedAdjustFrames) {
+        return;
+    }
+
+    if (SchedBehindFrames > (SchedAdjustFrames / 2)) {
+        if (CurRefreshIndex > 0) {
+            SetRefreshRateIndex(CurRefreshIndex - 1);
+        }
+    } else if ((SchedDrawnFrames > (SchedAdjustFrames / 2))
+        && (SchedBusyTime < (SchedAdjustFrames / 2) * FrameBudget))
+    {
+        if (CurRefreshIndex + 1 < NumRefreshRates) {
+            SetRefreshRateIndex(CurRefreshIndex + 1);
+        }
+    } else if (SchedDrawnFrames == 0) {
+        // nothing changed on screen, no need for the higher rates
+        if (CurRefreshIndex > InitialRefreshRateIndex) {
+            SetRefreshRateIndex(CurRefreshIndex - 1);
+        }
+    }
+
+#if dbglog_HAVE && dbglog_Lag
+    dbglog_writelnNum("refresh rate", RefreshRates[CurRefreshIndex]);
+    dbglog_writelnNum("avg us per tick", (si5r)(TickTimeAvg * 1000000));
+    dbglog_writelnNum("frames behind", SchedBehindFrames);
 #endif
 
-GLOBALFUNC blnr ExtraTimeNotOver(void) {
-    // not used
-    //UpdateTrueEmulatedTime();
-    return falseblnr;
+    SchedFrames = 0;
+    SchedBehindFrames = 0;
+    SchedDrawnFrames = 0;
+    SchedBusyTime = 0.0f;
 }
 
 LOCALVAR ui5b MyDateDelta;
@@ -441,6 +654,18 @@ LOCALPROC MySound_UnInit(void) {
 
 #define NotAfileRef NULL
 LOCALVAR SDFile *Drives[NumDrives]; /* open disk image files */
+LOCALVAR ui5r DriveSizes[NumDrives];
+LOCALVAR ui5r DriveFilePos[NumDrives]; /* to avoid seeking between sequential reads */
+#if WantCompressedDisks
+LOCALVAR ui5b *DriveChunkIndex[NumDrives]; /* NULL for plain images */
+LOCALVAR ui5r DriveChunkSize[NumDrives];
+#endif
+#if WantDiskOverlays
+LOCALVAR SDFile *DriveDelta[NumDrives]; /* NULL if not overlaid */
+#endif
+#if WantFolderVolumes
+LOCALVAR FldrVolR *DriveFolders[NumDrives]; /* NULL if not a folder */
+#endif
 #if IncludeSonyGetName || IncludeSonyNew
 #define DRIVE_NAME_MAX 255
 LOCALVAR char DriveNames[NumDrives][DRIVE_NAME_MAX+1];
@@ -455,205 +680,1643 @@ LOCALPROC InitDrives(void) {
 
     for (i = 0; i < NumDrives; ++i) {
         Drives[i] = NULL;
+        DriveSizes[i] = 0;
+#if WantCompressedDisks
+        DriveChunkIndex[i] = NULL;
+#endif
+#if WantDiskOverlays
+        DriveDelta[i] = NULL;
+#endif
+#if WantFolderVolumes
+        DriveFolders[i] = NULL;
+#endif
 #if IncludeSonyGetName || IncludeSonyNew
         bzero(DriveNames[i], DRIVE_NAME_MAX+1);
 #endif
     }
 }
 
-LOCALPROC UnInitDrives(void) {
-    for (tDrive i = 0; i < NumDrives; ++i) {
-        if (vSonyIsInserted(i)) {
-            (void)vSonyEject(i);
+LOCALFUNC tMacErr SDFileTransfer(SDFile *fp, ui5r *FilePos, blnr IsWrite, ui3p Buffer, ui5r Start, ui5r Count) {
+    int n;
+
+    if (*FilePos != Start) {
+        if (0 != pd->file->seek(fp, Start, SEEK_SET)) {
+            *FilePos = (ui5r)-1;
+            return mnvm_miscErr;
         }
     }
+    if (IsWrite) {
+        n = pd->file->write(fp, Buffer, Count);
+    } else {
+        n = pd->file->read(fp, Buffer, Count);
+    }
+    if (n != (int)Count) {
+        *FilePos = (ui5r)-1;
+        return mnvm_miscErr;
+    }
+    // only skip seeking between reads, don't switch direction without one
+    *FilePos = IsWrite ? (ui5r)-1 : Start + Count;
+    return mnvm_noErr;
 }
 
-LOCALFUNC blnr InsertDiskNamed(const char *name) {
-    if (strlen(name) > DRIVE_NAME_MAX) {
-        // too long name
+LOCALFUNC tMacErr DriveFileTransfer(blnr IsWrite, ui3p Buffer, tDrive Drive_No, ui5r Start, ui5r Count) {
+    return SDFileTransfer(Drives[Drive_No], &DriveFilePos[Drive_No], IsWrite, Buffer, Start, Count);
+}
+
+#if WantCompressedDisks
+
+#pragma mark - Compressed Disks
+
+// the last chunk decompressed
+LOCALVAR ui3p DskCmpInBuff = nullpr;
+LOCALVAR ui3p DskCmpOutBuff = nullpr;
+LOCALVAR tDrive DskCmpOutDrive;
+LOCALVAR ui5r DskCmpOutChunk = (ui5r)-1;
+
+LOCALPROC DskCmp_ReserveAlloc(void) {
+    ReserveAllocOneBlock(&DskCmpInBuff, DskCmp_MaxChunkSize, 5, falseblnr);
+    ReserveAllocOneBlock(&DskCmpOutBuff, DskCmp_MaxChunkSize, 5, falseblnr);
+}
+
+LOCALPROC DskCmp_Close(tDrive Drive_No) {
+    if (DriveChunkIndex[Drive_No] != NULL) {
+        free(DriveChunkIndex[Drive_No]);
+        DriveChunkIndex[Drive_No] = NULL;
+    }
+    if (DskCmpOutDrive == Drive_No) {
+        DskCmpOutChunk = (ui5r)-1;
+    }
+}
+
+/*
+    Check for a compressed image, and if found, load its index and
+    set DriveSizes to the uncompressed size. Returns false only for
+    a compressed image that can't be used.
+*/
+LOCALFUNC blnr DskCmp_Open(tDrive Drive_No) {
+    ui3b header[DskCmp_HeaderSize];
+    ui5r ImageSize, ChunkSize, NumChunks;
+    ui5r FileSize = DriveSizes[Drive_No];
+    ui5b *index;
+
+    DriveChunkIndex[Drive_No] = NULL;
+    if (FileSize < DskCmp_HeaderSize
+        || mnvm_noErr != DriveFileTransfer(falseblnr, header, Drive_No, 0, DskCmp_HeaderSize)
+        || !DskCmp_CheckHeader(header, &ImageSize, &ChunkSize, &NumChunks))
+    {
+        return trueblnr;
+    }
+
+    index = malloc((NumChunks + 1) * 4);
+    if (index == NULL) {
         return falseblnr;
     }
-    // free disks?
-    tDrive Drive_No;
-    if (!FirstFreeDisk(&Drive_No)) {
-        MacMsg(kStrTooManyImagesTitle, kStrTooManyImagesMessage,
-               falseblnr);
+    if (mnvm_noErr != DriveFileTransfer(falseblnr, (ui3p)index, Drive_No, DskCmp_HeaderSize, (NumChunks + 1) * 4)) {
+        free(index);
         return falseblnr;
     }
-
-    // try opening from from pdx
-    SDFile *fp = pd->file->open(name, kFileRead);
-    blnr locked = trueblnr;
-    if (fp == NULL) {
-        // try data folder
-        fp = pd->file->open(name, kFileReadData);
-        // open as writable
-        if (fp != NULL) {
-            pd->file->close(fp);
-            fp = pd->file->open(name, kFileRead|kFileReadData|kFileWrite);
-            locked = falseblnr;
-        }
+    for (ui5r i = 0; i <= NumChunks; i++) {
+        index[i] = DskCmp_Get32((ui3p)&index[i]);
     }
-    if (fp == NULL) {
-        // give up
+    if (index[NumChunks] > FileSize) {
+        free(index);
         return falseblnr;
     }
 
-    // insert disk
-    Drives[Drive_No] = fp;
-    DiskInsertNotify(Drive_No, locked);
-#if IncludeSonyGetName || IncludeSonyNew
-    strlcpy(DriveNames[Drive_No], name, DRIVE_NAME_MAX+1);
-#endif
-
+    DriveChunkIndex[Drive_No] = index;
+    DriveChunkSize[Drive_No] = ChunkSize;
+    DriveSizes[Drive_No] = ImageSize;
     return trueblnr;
 }
 
-LOCALFUNC blnr LoadInitialImages(void) {
-    if (!AnyDiskInserted()) {
-        int n = NumDrives > 9 ? 9 : NumDrives;
-        int i;
-        char s[] = "disk?.dsk";
+LOCALFUNC tMacErr DskCmp_LoadChunk(tDrive Drive_No, ui5r Chunk) {
+    ui5b *index = DriveChunkIndex[Drive_No];
+    ui5r start = index[Chunk];
+    ui5r len = index[Chunk + 1] - start;
+    ui5r outLen = DriveSizes[Drive_No] - Chunk * DriveChunkSize[Drive_No];
+    tMacErr err;
 
-        for (i = 1; i <= n; ++i) {
-            s[4] = '0' + i;
-            if (!InsertDiskNamed(s)) {
-                /* stop on first error (including file not found) */
-                return trueblnr;
-            }
+    if (outLen > DriveChunkSize[Drive_No]) {
+        outLen = DriveChunkSize[Drive_No];
+    }
+    if (index[Chunk + 1] < start || len > outLen) {
+        return mnvm_miscErr;
+    }
+    DskCmpOutChunk = (ui5r)-1;
+    err = DriveFileTransfer(falseblnr, DskCmpInBuff, Drive_No, start, len);
+    if (mnvm_noErr == err) {
+        if (!DskCmp_Decode(DskCmpInBuff, len, DskCmpOutBuff, outLen)) {
+            err = mnvm_miscErr;
+        } else {
+            DskCmpOutDrive = Drive_No;
+            DskCmpOutChunk = Chunk;
         }
     }
-
-    return trueblnr;
+    return err;
 }
 
-GLOBALFUNC tMacErr vSonyEject(tDrive Drive_No) {
-    pd->file->close(Drives[Drive_No]);
-    DiskEjectedNotify(Drive_No);
-    Drives[Drive_No] = NotAfileRef;
-    DriveNames[Drive_No][0] = 0;
+LOCALFUNC tMacErr DskCmp_Read(ui3p Buffer, tDrive Drive_No, ui5r Start, ui5r Count) {
+    ui5r ChunkSize = DriveChunkSize[Drive_No];
+
+    while (Count != 0) {
+        ui5r chunk = Start / ChunkSize;
+        ui5r offset = Start % ChunkSize;
+        ui5r n = ChunkSize - offset;
+
+        if (n > Count) {
+            n = Count;
+        }
+        if (DskCmpOutDrive != Drive_No || DskCmpOutChunk != chunk) {
+            tMacErr err = DskCmp_LoadChunk(Drive_No, chunk);
+            if (mnvm_noErr != err) {
+                return err;
+            }
+        }
+        MyMoveBytes(DskCmpOutBuff + offset, Buffer, n);
+        Buffer += n;
+        Start += n;
+        Count -= n;
+    }
     return mnvm_noErr;
 }
 
-#if IncludeSonyNew
-GLOBALFUNC tMacErr vSonyEjectDelete(tDrive Drive_No) {
-    pd->system->error("vSonyEjectDelete not implemented");
-    return mnvm_miscErr;
+#endif /* WantCompressedDisks */
+
+#if WantFolderVolumes
+
+#pragma mark - Folder Volumes
+
+typedef struct {
+    FldrVolR *v;
+    ui5r Parent;
+    char *path;
+} FldrVolListing;
+
+static void FldrVolListCallback(const char *name, void *userdata) {
+    FldrVolListing *l = (FldrVolListing *)userdata;
+    char path[FldrVol_PathMax];
+    FileStat st;
+    size_t n = strlen(name);
+
+    if (n != 0 && name[n-1] == '/') {
+        FldrVol_Add(l->v, l->Parent, (char *)name, trueblnr, 0);
+    } else if (snprintf(path, sizeof(path), "%s/%s", l->path, name) < (int)sizeof(path)
+               && pd->file->stat(path, &st) == 0) {
+        FldrVol_Add(l->v, l->Parent, (char *)name, falseblnr, st.size);
+    }
 }
-#endif
 
-#if IncludeSonyGetName
-GLOBALFUNC tMacErr vSonyGetName(tDrive Drive_No, tPbuf *r) {
-    // TODO: convert to MacRoman
-    return PbufNewFromPtr(DriveNames[Drive_No], (ui5r)strlen(DriveNames[Drive_No]), r);
+LOCALPROC FldrVol_ListHost(FldrVolR *v, ui5r Parent, char *path) {
+    FldrVolListing l = { v, Parent, path };
+    pd->file->listfiles(path, FldrVolListCallback, &l, 0);
 }
-#endif
 
-GLOBALFUNC tMacErr vSonyGetSize(tDrive Drive_No, ui5r *Sony_Count) {
-    SDFile *fp = Drives[Drive_No];
-    if (fp == NULL || pd->file->seek(fp, 0, SEEK_END) != 0) {
+LOCALFUNC anyp FldrVol_OpenHost(char *path) {
+    return pd->file->open(path, kFileRead|kFileReadData);
+}
+
+LOCALFUNC tMacErr FldrVol_ReadHost(anyp f, ui5r Offset, ui3p Buffer, ui5r Count) {
+    if (pd->file->seek(f, Offset, SEEK_SET) != 0
+        || pd->file->read(f, Buffer, Count) != (int)Count) {
         return mnvm_miscErr;
     }
-    *Sony_Count = pd->file->tell(fp);
     return mnvm_noErr;
 }
 
-GLOBALFUNC tMacErr vSonyTransfer(blnr IsWrite, ui3p Buffer, tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count, ui5r *Sony_ActCount) {
-    tMacErr err = mnvm_miscErr;
-    SDFile *fp = Drives[Drive_No];
-    ui5r BytesTransferred = 0;
+LOCALPROC FldrVol_CloseHost(anyp f) {
+    pd->file->close(f);
+}
 
-    if (0 == pd->file->seek(fp, Sony_Start, SEEK_SET)) {
-        if (IsWrite) {
-            BytesTransferred = pd->file->write(fp, Buffer, Sony_Count);
-        } else {
-            BytesTransferred = pd->file->read(fp, Buffer, Sony_Count);
-        }
+#endif /* WantFolderVolumes */
 
-        if (BytesTransferred == Sony_Count) {
-            err = mnvm_noErr;
-        }
+LOCALFUNC tMacErr DriveBaseTransfer(blnr IsWrite, ui3p Buffer, tDrive Drive_No, ui5r Start, ui5r Count) {
+#if WantFolderVolumes
+    if (DriveFolders[Drive_No] != NULL) {
+        return IsWrite ? mnvm_wPrErr : FldrVol_Read(DriveFolders[Drive_No], Buffer, Start, Count);
     }
-
-    if (nullpr != Sony_ActCount) {
-        *Sony_ActCount = BytesTransferred;
+#endif
+#if WantCompressedDisks
+    if (DriveChunkIndex[Drive_No] != NULL) {
+        return IsWrite ? mnvm_wPrErr : DskCmp_Read(Buffer, Drive_No, Start, Count);
     }
-
-    return err;
+#endif
+    return DriveFileTransfer(IsWrite, Buffer, Drive_No, Start, Count);
 }
 
-LOCALFUNC const char * InsertDiskMenuTitle(void) {
-    // TODO show error if no disk images found
-    return "Insert Disk";
+#if WantDiskOverlays
+
+#pragma mark - Overlay Disks
+
+/*
+    Images that would otherwise be read only (from the pdx, or
+    compressed) are made writable by keeping the changed 512 byte
+    blocks in a delta file, "<image name>.delta" in the data folder.
+    Deleting the delta file takes the disk back to its original state.
+
+    Delta file format (all numbers big endian):
+
+    header:
+        "vMacDLT2"
+        ui5b size of the base image
+        ui5b number of blocks in the image, n
+        ui5b fingerprint of the base image, see Delta_Fingerprint
+    index:
+        ui5b for each block, 0 if unchanged, or its slot + 1
+    data:
+        512 byte slots, starting at the first multiple of 512
+        after the index, in the order blocks were first written
+
+    New blocks are written before their index entry, so an
+    interrupted write never leaves a dangling entry.
+*/
+
+#define DeltaBlockSize 512
+#define DeltaHeaderSize 20
+#define DeltaPageShift 7 /* index entries per page in memory */
+#define DeltaPageSize (1 << DeltaPageShift)
+
+LOCALVAR ui5r DeltaFilePos[NumDrives];
+LOCALVAR ui5r DeltaNumBlocks[NumDrives];
+LOCALVAR ui5r DeltaDataStart[NumDrives];
+LOCALVAR ui5r DeltaNextSlot[NumDrives];
+
+/*
+    In memory, the index is split into pages, only allocated once a
+    block in them is in the delta, so memory use follows the size of
+    the delta rather than the image.
+*/
+LOCALVAR ui5b **DeltaPages[NumDrives];
+
+LOCALFUNC ui5r Delta_GetSlot(tDrive Drive_No, ui5r Block) {
+    ui5b *page = DeltaPages[Drive_No][Block >> DeltaPageShift];
+    return (page == NULL) ? 0 : page[Block & (DeltaPageSize - 1)];
 }
 
-// menu fits 10 lines of 47 characters
-#define DiskImageMenuSize 10
-LOCALVAR char AvailableDiskImages[DiskImageMenuSize][DRIVE_NAME_MAX+1];
-LOCALVAR int SelectedDiskImage;
+LOCALFUNC blnr Delta_SetSlot(tDrive Drive_No, ui5r Block, ui5r Slot) {
+    ui5b **page = &DeltaPages[Drive_No][Block >> DeltaPageShift];
+    if (*page == NULL) {
+        *page = calloc(DeltaPageSize, sizeof(ui5b));
+        if (*page == NULL) {
+            return falseblnr;
+        }
+    }
+    (*page)[Block & (DeltaPageSize - 1)] = Slot;
+    return trueblnr;
+}
 
-LOCALPROC DrawInsertDiskMenuBody(void) {
-    if (AvailableDiskImages[0][0] == 0) {
-        DrawCellsBeginLine();
-        DrawCellsFromStr("No disk images available.");
-        DrawCellsEndLine();
-        return;
+LOCALPROC Delta_Close(tDrive Drive_No) {
+    if (DriveDelta[Drive_No] != NULL) {
+        ui5r npages = (DeltaNumBlocks[Drive_No] + DeltaPageSize - 1) >> DeltaPageShift;
+        for (ui5r i = 0; i < npages; i++) {
+            free(DeltaPages[Drive_No][i]);
+        }
+        free(DeltaPages[Drive_No]);
+        DeltaPages[Drive_No] = NULL;
+        pd->file->close(DriveDelta[Drive_No]);
+        DriveDelta[Drive_No] = NULL;
     }
-    for (int i=0; i < DiskImageMenuSize && AvailableDiskImages[i][0] != 0; i++) {
-        DrawCellsBeginLine();
-        if (i == SelectedDiskImage) {
-            DrawCellsFromStr("- [");
-        } else {
-            DrawCellsFromStr("-  ");
+}
+
+LOCALFUNC tMacErr Delta_Transfer(blnr IsWrite, ui3p Buffer, ui5r Start, ui5r Count, tDrive Drive_No) {
+    return SDFileTransfer(DriveDelta[Drive_No], &DeltaFilePos[Drive_No], IsWrite, Buffer, Start, Count);
+}
+
+/*
+    FNV-1a over the first three blocks (boot blocks and volume header
+    on MFS/HFS disks, with the volume's dates) and the last block,
+    so a delta isn't applied to a different image of the same size.
+*/
+LOCALFUNC blnr Delta_Fingerprint(tDrive Drive_No, ui5r *Fingerprint) {
+    ui3b block[DeltaBlockSize];
+    ui5r nblocks = (DriveSizes[Drive_No] + DeltaBlockSize - 1) / DeltaBlockSize;
+    ui5r h = 2166136261UL;
+
+    for (ui5r b = 0; b < nblocks && b < 4; b++) {
+        ui5r Block = (b < 3) ? b : nblocks - 1;
+        ui5r n = DriveSizes[Drive_No] - Block * DeltaBlockSize;
+        if (n > DeltaBlockSize) {
+            n = DeltaBlockSize;
         }
-        DrawCellsFromStr(AvailableDiskImages[i]);
-        if (i == SelectedDiskImage) {
-            DrawCellsFromStr("]");
+        if (DriveBaseTransfer(falseblnr, block, Drive_No, Block * DeltaBlockSize, n) != mnvm_noErr) {
+            return falseblnr;
+        }
+        for (ui5r i = 0; i < n; i++) {
+            h = (h ^ block[i]) * 16777619UL;
         }
-        DrawCellsEndLine();
     }
+    *Fingerprint = h & 0xFFFFFFFF;
+    return trueblnr;
 }
 
-LOCALFUNC blnr IsDiskImage(const char *name) {
-    if (strchr(name, '/') != NULL) {
-        // a directory
+LOCALFUNC tMacErr Delta_Create(const char *path, ui5r BaseSize, ui5r Fingerprint) {
+    ui3b block[DeltaBlockSize];
+    ui5r nblocks = (BaseSize + DeltaBlockSize - 1) / DeltaBlockSize;
+    ui5r n = (DeltaHeaderSize + nblocks * 4 + DeltaBlockSize - 1) / DeltaBlockSize;
+    SDFile *fp = pd->file->open(path, kFileWrite);
+    blnr ok = (fp != NULL);
+
+    memset(block, 0, sizeof(block));
+    memcpy(block, "vMacDLT2", 8);
+    do_put_mem_long(block + 8, BaseSize);
+    do_put_mem_long(block + 12, nblocks);
+    do_put_mem_long(block + 16, Fingerprint);
+    for (ui5r i = 0; ok && i < n; i++) {
+        ok = (pd->file->write(fp, block, DeltaBlockSize) == DeltaBlockSize);
+        if (i == 0) {
+            memset(block, 0, DeltaHeaderSize);
+        }
+    }
+    if (fp != NULL) {
+        pd->file->close(fp);
+    }
+    return ok ? mnvm_noErr : mnvm_miscErr;
+}
+
+/*
+    Open (creating if needed) the delta file for an image,
+    and load its index.
+*/
+LOCALFUNC blnr Delta_Open(tDrive Drive_No, const char *name) {
+    char path[DRIVE_NAME_MAX + 7];
+    ui3b header[DeltaHeaderSize];
+    ui3b entries[DeltaBlockSize];
+    FileStat st;
+    ui5r BaseSize = DriveSizes[Drive_No];
+    ui5r nblocks = (BaseSize + DeltaBlockSize - 1) / DeltaBlockSize;
+    ui5r FileSize;
+    ui5r Fingerprint;
+    SDFile *fp;
+
+    if (!Delta_Fingerprint(Drive_No, &Fingerprint)) {
         return falseblnr;
     }
-    const char *extension = strrchr(name, '.');
-    if (extension == NULL) {
-        // file without extension
+    snprintf(path, sizeof(path), "%s.delta", name);
+    if (pd->file->stat(path, &st) != 0 && Delta_Create(path, BaseSize, Fingerprint) != mnvm_noErr) {
         return falseblnr;
     }
-    return strcasecmp(".dsk", extension) == 0 || strcasecmp(".img", extension) == 0;
-}
+    fp = pd->file->open(path, kFileRead|kFileReadData|kFileWrite);
+    if (fp == NULL) {
+        return falseblnr;
+    }
+    DriveDelta[Drive_No] = fp;
+    DeltaFilePos[Drive_No] = (ui5r)-1;
+    DeltaNumBlocks[Drive_No] = nblocks;
+    DeltaDataStart[Drive_No] = (DeltaHeaderSize + nblocks * 4 + DeltaBlockSize - 1) & ~(DeltaBlockSize - 1);
+    DeltaPages[Drive_No] = calloc((nblocks + DeltaPageSize - 1) >> DeltaPageShift, sizeof(ui5b *));
+
+    if (DeltaPages[Drive_No] == NULL
+        || pd->file->seek(fp, 0, SEEK_END) != 0
+        || (FileSize = pd->file->tell(fp)) < DeltaDataStart[Drive_No]
+        || Delta_Transfer(falseblnr, header, 0, DeltaHeaderSize, Drive_No) != mnvm_noErr
+        || memcmp(header, "vMacDLT2", 8) != 0
+        || do_get_mem_long(header + 8) != BaseSize
+        || do_get_mem_long(header + 12) != nblocks
+        || do_get_mem_long(header + 16) != Fingerprint)
+    {
+        // not ours, or made for a different version of the image;
+        // left alone, delete it to start over from this image
+        pd->system->logToConsole("%s does not match its image", path);
+        DeltaNumBlocks[Drive_No] = 0;
+        Delta_Close(Drive_No);
+        return falseblnr;
+    }
+    DeltaNextSlot[Drive_No] = (FileSize - DeltaDataStart[Drive_No]) / DeltaBlockSize;
 
-LOCALFUNC blnr IsDiskInserted(const char *name) {
-    for (int i=0; i < NumDrives; i++) {
-        if (strcmp(DriveNames[i], name) == 0) {
-            return trueblnr;
+    for (ui5r i = 0; i < nblocks; i += DeltaBlockSize / 4) {
+        ui5r n = nblocks - i;
+        if (n > DeltaBlockSize / 4) {
+            n = DeltaBlockSize / 4;
+        }
+        if (Delta_Transfer(falseblnr, entries, DeltaHeaderSize + i * 4, n * 4, Drive_No) != mnvm_noErr) {
+            Delta_Close(Drive_No);
+            return falseblnr;
+        }
+        for (ui5r j = 0; j < n; j++) {
+            ui5r slot = do_get_mem_long(entries + j * 4);
+            if (slot > DeltaNextSlot[Drive_No] || (slot != 0 && !Delta_SetSlot(Drive_No, i + j, slot))) {
+                Delta_Close(Drive_No);
+                return falseblnr;
+            }
         }
     }
-    return falseblnr;
+    return trueblnr;
 }
 
-static void ListFilesCallback(const char *name, void *userdata) {
-    int* index = (int*)userdata;
-    if (IsDiskImage(name) && !IsDiskInserted(name) && *index + 1 < DiskImageMenuSize) {
-        strlcpy(AvailableDiskImages[*index], name, DRIVE_NAME_MAX+1);
-        *index += 1;
-    }
+LOCALFUNC ui5r Delta_SlotPos(tDrive Drive_No, ui5r Slot) {
+    return DeltaDataStart[Drive_No] + (Slot - 1) * DeltaBlockSize;
 }
 
-LOCALPROC InsertDiskMenuCallback(void *userdata) {
-    // clear
+LOCALFUNC ui5r Delta_BlockLen(tDrive Drive_No, ui5r Block) {
+    ui5r n = DriveSizes[Drive_No] - Block * DeltaBlockSize;
+    return (n > DeltaBlockSize) ? DeltaBlockSize : n;
+}
+
+/*
+    Read in runs: consecutive blocks that are all unchanged come from
+    the base image, and consecutive slots from the delta, in one go.
+*/
+LOCALFUNC tMacErr Delta_Read(ui3p Buffer, tDrive Drive_No, ui5r Start, ui5r Count) {
+    tMacErr err = mnvm_noErr;
+
+    while (Count != 0 && mnvm_noErr == err) {
+        ui5r block = Start / DeltaBlockSize;
+        ui5r first = Delta_GetSlot(Drive_No, block);
+        ui5r slot = first;
+        ui5r n = DeltaBlockSize - Start % DeltaBlockSize;
+
+        while (n < Count) {
+            ui5r next = Delta_GetSlot(Drive_No, block + 1);
+            if (slot == 0 ? next != 0 : next != slot + 1) {
+                break;
+            }
+            ++block;
+            slot = next;
+            n += DeltaBlockSize;
+        }
+        if (n > Count) {
+            n = Count;
+        }
+        if (first == 0) {
+            err = DriveBaseTransfer(falseblnr, Buffer, Drive_No, Start, n);
+        } else {
+            err = Delta_Transfer(falseblnr, Buffer, Delta_SlotPos(Drive_No, first) + Start % DeltaBlockSize, n, Drive_No);
+        }
+        Buffer += n;
+        Start += n;
+        Count -= n;
+    }
+    return err;
+}
+
+LOCALFUNC tMacErr Delta_Write(ui3p Buffer, tDrive Drive_No, ui5r Start, ui5r Count) {
+    ui3b entry[4];
+    ui3b block[DeltaBlockSize];
+    tMacErr err = mnvm_noErr;
+
+    while (Count != 0 && mnvm_noErr == err) {
+        ui5r b = Start / DeltaBlockSize;
+        ui5r offset = Start % DeltaBlockSize;
+        ui5r len = Delta_BlockLen(Drive_No, b);
+        ui5r slot = Delta_GetSlot(Drive_No, b);
+        ui5r n = len - offset;
+        ui3p data = Buffer;
+
+        if (n > Count) {
+            n = Count;
+        }
+        if (n != len) {
+            // partial block, merge with what's there
+            err = Delta_Read(block, Drive_No, b * DeltaBlockSize, len);
+            MyMoveBytes(Buffer, block + offset, n);
+            data = block;
+        }
+        if (mnvm_noErr == err) {
+            if (slot != 0) {
+                err = Delta_Transfer(trueblnr, data, Delta_SlotPos(Drive_No, slot), len, Drive_No);
+            } else {
+                slot = DeltaNextSlot[Drive_No] + 1;
+                if (len < DeltaBlockSize) {
+                    // keep slots whole
+                    memset(block + len, 0, DeltaBlockSize - len);
+                    if (data != block) {
+                        MyMoveBytes(data, block, len);
+                        data = block;
+                    }
+                }
+                do_put_mem_long(entry, slot);
+                err = Delta_Transfer(trueblnr, data, Delta_SlotPos(Drive_No, slot), DeltaBlockSize, Drive_No);
+                if (mnvm_noErr == err) {
+                    DeltaNextSlot[Drive_No] = slot;
+                    err = Delta_Transfer(trueblnr, entry, DeltaHeaderSize + b * 4, 4, Drive_No);
+                }
+                if (mnvm_noErr == err && !Delta_SetSlot(Drive_No, b, slot)) {
+                    err = mnvm_miscErr;
+                }
+            }
+        }
+        Buffer += n;
+        Start += n;
+        Count -= n;
+    }
+    return err;
+}
+
+#endif /* WantDiskOverlays */
+
+LOCALFUNC tMacErr DriveRawTransfer(blnr IsWrite, ui3p Buffer, tDrive Drive_No, ui5r Start, ui5r Count) {
+#if WantDiskOverlays
+    if (DriveDelta[Drive_No] != NULL) {
+        return IsWrite ? Delta_Write(Buffer, Drive_No, Start, Count)
+                       : Delta_Read(Buffer, Drive_No, Start, Count);
+    }
+#endif
+    return DriveBaseTransfer(IsWrite, Buffer, Drive_No, Start, Count);
+}
+
+#pragma mark - Disk Cache
+
+/*
+    Block cache in front of the disk image files, so that the many
+    small reads HFS does don't each pay the file API latency.
+
+    The cache is a pool of DiskCacheLines lines of DiskCacheLineSize
+    bytes, shared by all drives and replaced least recently used
+    first. A miss that continues where the previous request to that
+    drive ended also reads the next DiskCacheReadAhead lines.
+    Writes stay in the cache until the drive is ejected, the
+    device is locked, or no disk write has happened for
+    DiskCacheFlushIdleTicks emulated ticks.
+*/
+
+#ifndef DiskCacheLines
+#define DiskCacheLines 64 /* 256K */
+#endif
+#define DiskCacheLineSize 4096
+#define DiskCacheReadAhead 8
+#define DiskCacheFlushIdleTicks 120
+
+typedef struct {
+    ui5r Block; /* line number within the image */
+    ui5r LastUse;
+    ui4r Len; /* valid bytes, 0 if unused */
+    tDrive Drive;
+    blnr Dirty;
+} DiskCacheLine;
+
+LOCALVAR DiskCacheLine DiskCacheDir[DiskCacheLines];
+LOCALVAR ui3p DiskCacheData = nullpr;
+LOCALVAR ui5r DiskCacheClock = 0;
+LOCALVAR blnr DiskCacheHaveDirty = falseblnr;
+LOCALVAR ui5r DiskCacheIdleTicks = 0;
+LOCALVAR ui5r DriveNextSeqStart[NumDrives];
+
+LOCALVAR ui5r DiskCacheHits = 0;
+LOCALVAR ui5r DiskCacheMisses = 0;
+LOCALVAR ui5r DiskCacheReadAheads = 0;
+LOCALVAR ui5r DiskCacheWriteBacks = 0;
+
+#define DiskCacheLineData(i) (DiskCacheData + (uimr)(i) * DiskCacheLineSize)
+
+LOCALPROC DiskCache_ReserveAlloc(void) {
+    ReserveAllocOneBlock(&DiskCacheData,
+                         (uimr)DiskCacheLines * DiskCacheLineSize, 5, falseblnr);
+}
+
+LOCALFUNC int DiskCache_Find(tDrive Drive_No, ui5r Block) {
+    for (int i = 0; i < DiskCacheLines; i++) {
+        DiskCacheLine *l = &DiskCacheDir[i];
+        if (l->Len != 0 && l->Block == Block && l->Drive == Drive_No) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+LOCALFUNC tMacErr DiskCache_WriteBack(int i) {
+    DiskCacheLine *l = &DiskCacheDir[i];
+    tMacErr err = mnvm_noErr;
+
+    if (l->Dirty) {
+        err = DriveRawTransfer(trueblnr, DiskCacheLineData(i), l->Drive,
+                               l->Block * DiskCacheLineSize, l->Len);
+        if (mnvm_noErr == err) {
+            l->Dirty = falseblnr;
+            ++DiskCacheWriteBacks;
+        }
+    }
+    return err;
+}
+
+LOCALFUNC tMacErr DiskCache_Victim(int *r) {
+    int v = 0;
+
+    for (int i = 0; i < DiskCacheLines; i++) {
+        DiskCacheLine *l = &DiskCacheDir[i];
+        if (l->Len == 0) {
+            v = i;
+            break;
+        }
+        if (l->LastUse < DiskCacheDir[v].LastUse) {
+            v = i;
+        }
+    }
+    *r = v;
+    return DiskCache_WriteBack(v);
+}
+
+LOCALFUNC ui4r DiskCache_LineLen(tDrive Drive_No, ui5r Block) {
+    ui5r start = Block * DiskCacheLineSize;
+    ui5r n = DriveSizes[Drive_No] - start;
+    return (n > DiskCacheLineSize) ? DiskCacheLineSize : n;
+}
+
+/*
+    Bring in n lines starting at Block, skipping those already
+    cached. If NoRead, the first line will be entirely overwritten
+    by the caller, so it is not read.
+*/
+LOCALFUNC tMacErr DiskCache_Load(tDrive Drive_No, ui5r Block, ui5r n, blnr NoRead, int *first) {
+    tMacErr err = mnvm_noErr;
+    ui5r lastBlock = (DriveSizes[Drive_No] - 1) / DiskCacheLineSize;
+
+    *first = -1;
+    for (ui5r k = 0; k < n && Block + k <= lastBlock; k++) {
+        int i = DiskCache_Find(Drive_No, Block + k);
+        if (i < 0) {
+            DiskCacheLine *l;
+            err = DiskCache_Victim(&i);
+            if (mnvm_noErr != err) {
+                break;
+            }
+            l = &DiskCacheDir[i];
+            l->Len = 0;
+            l->Drive = Drive_No;
+            l->Block = Block + k;
+            l->Dirty = falseblnr;
+            if (! (NoRead && k == 0)) {
+                err = DriveRawTransfer(falseblnr, DiskCacheLineData(i), Drive_No,
+                                       (Block + k) * DiskCacheLineSize,
+                                       DiskCache_LineLen(Drive_No, Block + k));
+                if (mnvm_noErr != err) {
+                    break;
+                }
+                if (k != 0) {
+                    ++DiskCacheReadAheads;
+                }
+            }
+            l->Len = DiskCache_LineLen(Drive_No, Block + k);
+            /* read ahead lines are the first to go if unused */
+            l->LastUse = (k == 0) ? DiskCacheClock : DiskCacheClock - 1;
+        }
+        if (k == 0) {
+            *first = i;
+        }
+    }
+    return err;
+}
+
+LOCALFUNC tMacErr DiskCache_FlushDrive(tDrive Drive_No) {
+    tMacErr err = mnvm_noErr;
+
+    for (int i = 0; i < DiskCacheLines; i++) {
+        DiskCacheLine *l = &DiskCacheDir[i];
+        if (l->Len != 0 && l->Dirty && l->Drive == Drive_No) {
+            tMacErr err2 = DiskCache_WriteBack(i);
+            if (mnvm_noErr != err2) {
+                err = err2;
+            }
+        }
+    }
+    if (Drives[Drive_No] != NULL) {
+        pd->file->flush(Drives[Drive_No]);
+    }
+#if WantDiskOverlays
+    if (DriveDelta[Drive_No] != NULL) {
+        pd->file->flush(DriveDelta[Drive_No]);
+    }
+#endif
+    return err;
+}
+
+LOCALPROC DiskCache_FlushAll(void) {
+    if (DiskCacheHaveDirty) {
+        for (tDrive i = 0; i < NumDrives; ++i) {
+            if (vSonyIsInserted(i)) {
+                (void)DiskCache_FlushDrive(i);
+            }
+        }
+        DiskCacheHaveDirty = falseblnr;
+    }
+}
+
+LOCALPROC DiskCache_Invalidate(tDrive Drive_No) {
+    for (int i = 0; i < DiskCacheLines; i++) {
+        if (DiskCacheDir[i].Drive == Drive_No) {
+            DiskCacheDir[i].Len = 0;
+        }
+    }
+    DriveNextSeqStart[Drive_No] = (ui5r)-1;
+}
+
+LOCALPROC DiskCache_IdleTicks(ui5r n) {
+    if (DiskCacheHaveDirty) {
+        DiskCacheIdleTicks += n;
+        if (DiskCacheIdleTicks >= DiskCacheFlushIdleTicks) {
+            DiskCache_FlushAll();
+        }
+    }
+}
+
+LOCALPROC DiskCache_LogStats(void) {
+#if dbglog_HAVE
+    dbglog_writelnNum("disk cache hits", DiskCacheHits);
+    dbglog_writelnNum("disk cache misses", DiskCacheMisses);
+    dbglog_writelnNum("disk cache read aheads", DiskCacheReadAheads);
+    dbglog_writelnNum("disk cache write backs", DiskCacheWriteBacks);
+#endif
+}
+
+/*
+    Transfers too big to be worth caching go straight to the file,
+    keeping any cached lines they overlap in sync.
+*/
+#define DiskCacheBypassSize (DiskCacheLines / 4 * DiskCacheLineSize)
+
+LOCALFUNC tMacErr DiskCache_Bypass(blnr IsWrite, ui3p Buffer, tDrive Drive_No, ui5r Start, ui5r Count) {
+    tMacErr err = DriveRawTransfer(IsWrite, Buffer, Drive_No, Start, Count);
+
+    if (mnvm_noErr == err) {
+        for (int i = 0; i < DiskCacheLines; i++) {
+            DiskCacheLine *l = &DiskCacheDir[i];
+            ui5r lstart = l->Block * DiskCacheLineSize;
+            ui5r lo, hi;
+
+            if (l->Len == 0 || l->Drive != Drive_No
+                || lstart >= Start + Count || lstart + l->Len <= Start) {
+                continue;
+            }
+            lo = (lstart > Start) ? lstart : Start;
+            hi = (lstart + l->Len < Start + Count) ? lstart + l->Len : Start + Count;
+            if (IsWrite) {
+                MyMoveBytes(Buffer + (lo - Start), DiskCacheLineData(i) + (lo - lstart), hi - lo);
+            } else if (l->Dirty) {
+                MyMoveBytes(DiskCacheLineData(i) + (lo - lstart), Buffer + (lo - Start), hi - lo);
+            }
+        }
+    }
+    return err;
+}
+
+LOCALFUNC tMacErr DiskCache_Transfer(blnr IsWrite, ui3p Buffer, tDrive Drive_No, ui5r Start, ui5r Count, ui5r *ActCount) {
+    tMacErr err = mnvm_noErr;
+    ui5r done = 0;
+    blnr sequential = (Start == DriveNextSeqStart[Drive_No]);
+
+    if (Count >= DiskCacheBypassSize) {
+        err = DiskCache_Bypass(IsWrite, Buffer, Drive_No, Start, Count);
+        DriveNextSeqStart[Drive_No] = Start + Count;
+        *ActCount = (mnvm_noErr == err) ? Count : 0;
+        return err;
+    }
+
+    ++DiskCacheClock;
+    while (done < Count) {
+        ui5r pos = Start + done;
+        ui5r block = pos / DiskCacheLineSize;
+        ui5r offset = pos % DiskCacheLineSize;
+        ui5r n = DiskCacheLineSize - offset;
+        int i;
+
+        if (n > Count - done) {
+            n = Count - done;
+        }
+        i = DiskCache_Find(Drive_No, block);
+        if (i >= 0) {
+            ++DiskCacheHits;
+        } else {
+            ui5r lines = 1;
+
+            ++DiskCacheMisses;
+            if (! IsWrite) {
+                /* rest of this request, and more if sequential */
+                lines = (Start + Count - 1) / DiskCacheLineSize - block + 1;
+                if (sequential) {
+                    lines += DiskCacheReadAhead;
+                }
+                if (lines > DiskCacheLines / 2) {
+                    lines = DiskCacheLines / 2;
+                }
+            }
+            err = DiskCache_Load(Drive_No, block, lines,
+                                 IsWrite && offset == 0 && n == DiskCache_LineLen(Drive_No, block), &i);
+            if (i < 0) {
+                break;
+            }
+        }
+        DiskCacheDir[i].LastUse = DiskCacheClock;
+
+        if (IsWrite) {
+            MyMoveBytes(Buffer + done, DiskCacheLineData(i) + offset, n);
+            DiskCacheDir[i].Dirty = trueblnr;
+            DiskCacheHaveDirty = trueblnr;
+            DiskCacheIdleTicks = 0;
+        } else {
+            MyMoveBytes(DiskCacheLineData(i) + offset, Buffer + done, n);
+        }
+        done += n;
+    }
+
+    DriveNextSeqStart[Drive_No] = Start + done;
+    *ActCount = done;
+    return (done == Count) ? mnvm_noErr : ((mnvm_noErr == err) ? mnvm_miscErr : err);
+}
+
+LOCALPROC UnInitDrives(void) {
+    for (tDrive i = 0; i < NumDrives; ++i) {
+        if (vSonyIsInserted(i)) {
+            (void)vSonyEject(i);
+        }
+    }
+}
+
+#if WantFolderVolumes
+// folders are inserted as a locked volume, see FLDRVOLM.h
+LOCALFUNC blnr InsertFolderNamed(tDrive Drive_No, const char *name) {
+    FldrVolR *v = FldrVol_Open((char *)name);
+    if (v == NULL) {
+        return falseblnr;
+    }
+    DriveFolders[Drive_No] = v;
+    DriveSizes[Drive_No] = v->Size;
+    DiskCache_Invalidate(Drive_No);
+    DiskInsertNotify(Drive_No, trueblnr);
+#if WantRewind
+    EmulationRewindForget();
+#endif
+#if IncludeSonyGetName || IncludeSonyNew
+    strlcpy(DriveNames[Drive_No], name, DRIVE_NAME_MAX+1);
+#endif
+    return trueblnr;
+}
+#endif
+
+#if IncludeSCSIDisks
+LOCALFUNC blnr IsSCSIDiskName(const char *name) {
+    const char *extension = strrchr(name, '.');
+    return extension != NULL && strcasecmp(".hda", extension) == 0;
+}
+#endif
+
+LOCALFUNC blnr InsertDiskInDrive(tDrive Drive_No, const char *name) {
+#if WantFolderVolumes
+    if (name[0] != 0 && name[strlen(name)-1] == '/') {
+        return InsertFolderNamed(Drive_No, name);
+    }
+#endif
+
+    // try opening from from pdx
+    SDFile *fp = pd->file->open(name, kFileRead);
+    blnr locked = trueblnr;
+    if (fp == NULL) {
+        // try data folder
+        fp = pd->file->open(name, kFileReadData);
+        // open as writable
+        if (fp != NULL) {
+            pd->file->close(fp);
+            fp = pd->file->open(name, kFileRead|kFileReadData|kFileWrite);
+            locked = falseblnr;
+        }
+    }
+    if (fp == NULL) {
+        // give up
+        return falseblnr;
+    }
+
+    // insert disk
+    Drives[Drive_No] = fp;
+    DriveFilePos[Drive_No] = (ui5r)-1;
+    if (pd->file->seek(fp, 0, SEEK_END) != 0) {
+        pd->file->close(fp);
+        Drives[Drive_No] = NotAfileRef;
+        return falseblnr;
+    }
+    DriveSizes[Drive_No] = pd->file->tell(fp);
+#if WantCompressedDisks
+    if (!DskCmp_Open(Drive_No)) {
+        pd->file->close(fp);
+        Drives[Drive_No] = NotAfileRef;
+        return falseblnr;
+    }
+    if (DriveChunkIndex[Drive_No] != NULL) {
+        // compressed images are read only
+        locked = trueblnr;
+    }
+#endif
+#if WantDiskOverlays
+    if (locked && Delta_Open(Drive_No, name)) {
+        locked = falseblnr;
+    }
+#endif
+    DiskCache_Invalidate(Drive_No);
+#if IncludeSCSIDisks
+    if (IsSCSIDiskName(name)) {
+        // a hard disk on the SCSI bus, see SCSIEMDV.c
+        vSCSIDiskMask |= ((ui5b)1 << Drive_No);
+    }
+#endif
+    DiskInsertNotify(Drive_No, locked);
+#if WantRewind
+    EmulationRewindForget();
+#endif
+#if IncludeSonyGetName || IncludeSonyNew
+    strlcpy(DriveNames[Drive_No], name, DRIVE_NAME_MAX+1);
+#endif
+
+    return trueblnr;
+}
+
+LOCALFUNC blnr InsertDiskNamed(const char *name) {
+    if (strlen(name) > DRIVE_NAME_MAX) {
+        // too long name
+        return falseblnr;
+    }
+    // free disks?
+    tDrive Drive_No;
+    if (!FirstFreeDisk(&Drive_No)) {
+        MacMsg(kStrTooManyImagesTitle, kStrTooManyImagesMessage,
+               falseblnr);
+        return falseblnr;
+    }
+    return InsertDiskInDrive(Drive_No, name);
+}
+
+LOCALFUNC blnr LoadInitialImages(void) {
+    if (!AnyDiskInserted()) {
+        int n = NumDrives > 9 ? 9 : NumDrives;
+        int i;
+        char s[] = "disk?.dsk";
+
+        for (i = 1; i <= n; ++i) {
+            s[4] = '0' + i;
+            if (!InsertDiskNamed(s)) {
+                /* stop on first error (including file not found) */
+                break;
+            }
+        }
+#if IncludeSCSIDisks
+        /* hard disks have to be there when the Mac starts */
+        char hd[] = "hd?.hda";
+        for (i = 1; i <= n; ++i) {
+            hd[2] = '0' + i;
+            if (!InsertDiskNamed(hd)) {
+                break;
+            }
+        }
+#endif
+    }
+
+    return trueblnr;
+}
+
+GLOBALFUNC tMacErr vSonyEject(tDrive Drive_No) {
+    (void)DiskCache_FlushDrive(Drive_No);
+    DiskCache_Invalidate(Drive_No);
+    DiskCache_LogStats();
+#if WantDiskOverlays
+    Delta_Close(Drive_No);
+#endif
+#if WantCompressedDisks
+    DskCmp_Close(Drive_No);
+#endif
+#if WantFolderVolumes
+    if (DriveFolders[Drive_No] != NULL) {
+        FldrVol_Dispose(DriveFolders[Drive_No]);
+        DriveFolders[Drive_No] = NULL;
+    }
+#endif
+    if (Drives[Drive_No] != NULL) {
+        pd->file->close(Drives[Drive_No]);
+    }
+    DiskEjectedNotify(Drive_No);
+#if WantRewind
+    EmulationRewindForget();
+#endif
+    Drives[Drive_No] = NotAfileRef;
+    DriveNames[Drive_No][0] = 0;
+    return mnvm_noErr;
+}
+
+#if IncludeSonyNew
+GLOBALFUNC tMacErr vSonyEjectDelete(tDrive Drive_No) {
+    pd->system->error("vSonyEjectDelete not implemented");
+    return mnvm_miscErr;
+}
+#endif
+
+#if IncludeSonyGetName
+GLOBALFUNC tMacErr vSonyGetName(tDrive Drive_No, tPbuf *r) {
+    // TODO: convert to MacRoman
+    return PbufNewFromPtr(DriveNames[Drive_No], (ui5r)strlen(DriveNames[Drive_No]), r);
+}
+#endif
+
+GLOBALFUNC tMacErr vSonyGetSize(tDrive Drive_No, ui5r *Sony_Count) {
+    if (Drives[Drive_No] == NULL
+#if WantFolderVolumes
+        && DriveFolders[Drive_No] == NULL
+#endif
+        ) {
+        return mnvm_miscErr;
+    }
+    *Sony_Count = DriveSizes[Drive_No];
+    return mnvm_noErr;
+}
+
+GLOBALFUNC tMacErr vSonyTransfer(blnr IsWrite, ui3p Buffer, tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count, ui5r *Sony_ActCount) {
+    tMacErr err = mnvm_miscErr;
+    ui5r BytesTransferred = 0;
+    ui5r size = DriveSizes[Drive_No];
+
+    if (Sony_Start <= size) {
+        ui5r n = size - Sony_Start;
+        if (n > Sony_Count) {
+            n = Sony_Count;
+        }
+#if WantRewind
+        if (IsWrite) {
+            // keep what's overwritten, to put it back when rewinding
+            EmulationRewindDiskWrite(Drive_No, Sony_Start, n);
+        }
+#endif
+        err = DiskCache_Transfer(IsWrite, Buffer, Drive_No, Sony_Start, n, &BytesTransferred);
+        if (n != Sony_Count) {
+            err = mnvm_miscErr;
+        }
+    }
+
+    if (nullpr != Sony_ActCount) {
+        *Sony_ActCount = BytesTransferred;
+    }
+
+    return err;
+}
+
+LOCALFUNC blnr IsDiskImage(const char *name) {
+    if (strchr(name, '/') != NULL) {
+        // a directory
+#if WantFolderVolumes
+        // any but the launcher card images in the pdx
+        return strcmp(name, "images/") != 0;
+#else
+        return falseblnr;
+#endif
+    }
+    const char *extension = strrchr(name, '.');
+    if (extension == NULL) {
+        // file without extension
+        return falseblnr;
+    }
+    return strcasecmp(".dsk", extension) == 0 || strcasecmp(".img", extension) == 0
+#if WantCompressedDisks
+        || strcasecmp(".dsz", extension) == 0
+#endif
+#if IncludeSCSIDisks
+        || strcasecmp(".hda", extension) == 0
+#endif
+        ;
+}
+
+LOCALFUNC blnr IsDiskInserted(const char *name) {
+    for (int i=0; i < NumDrives; i++) {
+        if (strcmp(DriveNames[i], name) == 0) {
+            return trueblnr;
+        }
+    }
+    return falseblnr;
+}
+
+#pragma mark - Disk Catalog
+
+/*
+    What's known about each disk image that can be inserted, saved in
+    the data folder so the insert disk menu can list them right away,
+    with their size, format and volume name. The folder is listed
+    again in the background when the menu is opened, and then a few
+    images are looked at each frame. An image's header is only read
+    if it's new, or its size or modification time changed.
+
+    Catalog file format (all numbers big endian):
+
+    header:
+        "vMacCAT1"
+        ui5b number of entries
+
+    entry:
+        ui5b file size
+        ui5b modification time, see DiskCat_PackTime
+        ui5b disk size
+        ui3b format
+        ui3b length of name, then the name
+        ui3b length of volume name, then the volume name
+ */
+
+#define DiskCatFileName "catalog.dat"
+#define DiskCatScanPerFrame 2
+#define DiskCatScanPerFrameStopped 16 // while the menu is up
+
+enum {
+    kDiskFmtUnknown,
+    kDiskFmtRaw,
+    kDiskFmtDC42,
+    kDiskFmtCompressed,
+    kDiskFmtFolder,
+    kDiskFmtSCSI,
+    kNumDiskFmts
+};
+
+typedef struct {
+    char *Name;
+    ui5r FileSize;
+    ui5r MTime;
+    ui5r DiskSize;
+    ui3b Format;
+    blnr Seen;
+    char VolName[28];
+} DiskCatEntry;
+
+LOCALVAR DiskCatEntry *DiskCat = NULL; // sorted by name
+LOCALVAR int DiskCatCount = 0;
+LOCALVAR int DiskCatAlloc = 0;
+LOCALVAR blnr DiskCatDirty = falseblnr;
+LOCALVAR blnr DiskCatWantScan = falseblnr;
+LOCALVAR int DiskCatScanPos = -1; // next entry to look at, -1 if not scanning
+
+FORWARDPROC DiskMenu_CatalogChanged(blnr Rebuild);
+
+LOCALFUNC blnr DiskCat_Find(const char *name, int *pos) {
+    int lo = 0;
+    int hi = DiskCatCount;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int c = strcmp(DiskCat[mid].Name, name);
+        if (c == 0) {
+            *pos = mid;
+            return trueblnr;
+        } else if (c < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *pos = lo;
+    return falseblnr;
+}
+
+LOCALFUNC DiskCatEntry *DiskCat_Insert(int pos, const char *name, ui5r len) {
+    if (DiskCatCount == DiskCatAlloc) {
+        int n = (DiskCatAlloc == 0) ? 64 : 2 * DiskCatAlloc;
+        DiskCatEntry *p = realloc(DiskCat, n * sizeof(DiskCatEntry));
+        if (p == NULL) {
+            return NULL;
+        }
+        DiskCat = p;
+        DiskCatAlloc = n;
+    }
+    char *s = malloc(len + 1);
+    if (s == NULL) {
+        return NULL;
+    }
+    memcpy(s, name, len);
+    s[len] = 0;
+
+    memmove(&DiskCat[pos + 1], &DiskCat[pos], (DiskCatCount - pos) * sizeof(DiskCatEntry));
+    ++DiskCatCount;
+    DiskCatEntry *e = &DiskCat[pos];
+    memset(e, 0, sizeof(DiskCatEntry));
+    e->Name = s;
+    e->Seen = trueblnr;
+    return e;
+}
+
+// later times compare greater
+LOCALFUNC ui5r DiskCat_PackTime(FileStat *st) {
+    return (((((ui5r)(st->m_year - 2000) * 12 + (st->m_month - 1)) * 31
+              + (st->m_day - 1)) * 24 + st->m_hour) * 60 + st->m_minute) * 60 + st->m_second;
+}
+
+// volume name from a master directory block, HFS or MFS
+LOCALPROC DiskCat_MDBName(ui3p mdb, char *r) {
+    ui4r sig = do_get_mem_word(mdb);
+    ui3r n = mdb[36];
+
+    if ((sig == 0x4244 || sig == 0xD2D7) && n <= 27) {
+        for (ui3r i = 0; i < n; i++) {
+            ui3r c = mdb[37 + i];
+            // ';' and '^' are escapes for DrawCellsFromStr
+            r[i] = (c < 0x20 || c >= 0x7F || c == ';' || c == '^') ? '?' : c;
+        }
+        r[n] = 0;
+    }
+}
+
+/*
+    Looks at the start of the image, or of the first chunk of a
+    compressed image, which is always at least 4K.
+ */
+#define DiskCatProbeSize 0x0800
+
+LOCALPROC DiskCat_Probe(DiskCatEntry *e) {
+    ui3b buff[DiskCatProbeSize];
+    ui3p p = buff;
+    SDFile *fp = pd->file->open(e->Name, kFileRead|kFileReadData);
+    int n;
+
+    e->Format = kDiskFmtUnknown;
+    e->DiskSize = e->FileSize;
+    e->VolName[0] = 0;
+    if (fp == NULL) {
+        return;
+    }
+    n = pd->file->read(fp, buff, DiskCatProbeSize);
+#if WantCompressedDisks
+    ui5r size, chunk, nchunks;
+    if (n >= DskCmp_HeaderSize + 8 && DskCmp_CheckHeader(buff, &size, &chunk, &nchunks)) {
+        ui5r start = DskCmp_Get32(buff + DskCmp_HeaderSize);
+        ui5r end = DskCmp_Get32(buff + DskCmp_HeaderSize + 4);
+        ui5r len = (size < chunk) ? size : chunk;
+        e->Format = kDiskFmtCompressed;
+        e->DiskSize = size;
+        n = 0;
+        if (end > start && end - start <= DskCmp_MaxChunkSize
+            && pd->file->seek(fp, start, SEEK_SET) == 0
+            && pd->file->read(fp, DskCmpInBuff, end - start) == (int)(end - start)
+            && DskCmp_Decode(DskCmpInBuff, end - start, DskCmpOutBuff, len)) {
+            p = DskCmpOutBuff;
+            n = (len < DiskCatProbeSize) ? len : DiskCatProbeSize;
+        }
+        // that wasn't the chunk of any drive
+        DskCmpOutChunk = (ui5r)-1;
+    }
+#endif
+    pd->file->close(fp);
+
+    if (n >= 84 + 1024 + 64 && do_get_mem_word(p + 82) == 0x0100 && p[0] < 64) {
+        // Disk Copy 4.2, the disk name is used if there's no volume name
+        if (e->Format != kDiskFmtCompressed) {
+            e->Format = kDiskFmtDC42;
+        }
+        e->DiskSize = do_get_mem_long(p + 64);
+        ui3r L = (p[0] > 27) ? 27 : p[0];
+        for (ui3r i = 0; i < L; i++) {
+            ui3r c = p[1 + i];
+            e->VolName[i] = (c < 0x20 || c >= 0x7F || c == ';' || c == '^') ? '?' : c;
+        }
+        e->VolName[L] = 0;
+        DiskCat_MDBName(p + 84 + 1024, e->VolName);
+    } else if (n >= 1024 + 64) {
+        if (e->Format != kDiskFmtCompressed) {
+            e->Format = kDiskFmtRaw;
+        }
+        DiskCat_MDBName(p + 1024, e->VolName);
+    }
+#if IncludeSCSIDisks
+    if (IsSCSIDiskName(e->Name)) {
+        // partitioned, the volumes are further in
+        e->Format = kDiskFmtSCSI;
+    }
+#endif
+}
+
+// returns true if anything about the entry changed
+LOCALFUNC blnr DiskCat_Check(DiskCatEntry *e) {
+    size_t L = strlen(e->Name);
+    FileStat st;
+
+    if (L != 0 && e->Name[L-1] == '/') {
+        if (e->Format == kDiskFmtFolder) {
+            return falseblnr;
+        }
+        e->Format = kDiskFmtFolder;
+        e->FileSize = e->DiskSize = e->MTime = 0;
+        if (L > 28) {
+            L = 28;
+        }
+        for (size_t i = 0; i < L - 1; i++) {
+            char c = e->Name[i];
+            e->VolName[i] = (c == ';' || c == '^') ? '?' : c;
+        }
+        e->VolName[L - 1] = 0;
+        return trueblnr;
+    }
+
+    if (pd->file->stat(e->Name, &st) != 0) {
+        // gone, removed at end of scan
+        e->Seen = falseblnr;
+        return trueblnr;
+    }
+    if (st.size == e->FileSize && DiskCat_PackTime(&st) == e->MTime) {
+        return falseblnr;
+    }
+    e->FileSize = st.size;
+    e->MTime = DiskCat_PackTime(&st);
+    DiskCat_Probe(e);
+    return trueblnr;
+}
+
+static void DiskCatListCallback(const char *name, void *userdata) {
+    int pos;
+    DiskCatEntry *e;
+    size_t L = strlen(name);
+
+    if (!IsDiskImage(name) || L > DRIVE_NAME_MAX) {
+        return;
+    }
+    if (DiskCat_Find(name, &pos)) {
+        DiskCat[pos].Seen = trueblnr;
+    } else if ((e = DiskCat_Insert(pos, name, L)) != NULL) {
+        e->Format = kDiskFmtUnknown;
+        DiskCatDirty = trueblnr;
+    }
+}
+
+LOCALPROC DiskCat_Save(void) {
+    ui5r size = 12;
+    int i;
+
+    for (i = 0; i < DiskCatCount; i++) {
+        size += 15 + strlen(DiskCat[i].Name) + strlen(DiskCat[i].VolName);
+    }
+    ui3p buff = malloc(size);
+    if (buff == NULL) {
+        return;
+    }
+    ui3p p = buff;
+    memcpy(p, "vMacCAT1", 8);
+    do_put_mem_long(p + 8, DiskCatCount);
+    p += 12;
+    for (i = 0; i < DiskCatCount; i++) {
+        DiskCatEntry *e = &DiskCat[i];
+        ui3r L;
+        do_put_mem_long(p, e->FileSize);
+        do_put_mem_long(p + 4, e->MTime);
+        do_put_mem_long(p + 8, e->DiskSize);
+        p[12] = e->Format;
+        p += 13;
+        *p++ = L = strlen(e->Name);
+        memcpy(p, e->Name, L);
+        p += L;
+        *p++ = L = strlen(e->VolName);
+        memcpy(p, e->VolName, L);
+        p += L;
+    }
+
+    SDFile *fp = pd->file->open(DiskCatFileName, kFileWrite);
+    if (fp != NULL) {
+        if (pd->file->write(fp, buff, size) == (int)size) {
+            DiskCatDirty = falseblnr;
+        }
+        pd->file->close(fp);
+    }
+    free(buff);
+}
+
+LOCALPROC DiskCat_Load(void) {
+    FileStat st;
+    SDFile *fp;
+    ui3p buff;
+
+    if (pd->file->stat(DiskCatFileName, &st) != 0 || st.size < 12
+        || (buff = malloc(st.size)) == NULL) {
+        return;
+    }
+    fp = pd->file->open(DiskCatFileName, kFileReadData);
+    if (fp != NULL) {
+        if (pd->file->read(fp, buff, st.size) == (int)st.size && memcmp(buff, "vMacCAT1", 8) == 0) {
+            ui3p p = buff + 12;
+            ui3p end = buff + st.size;
+            ui5r n = do_get_mem_long(buff + 8);
+            char s[DRIVE_NAME_MAX + 1];
+            int pos;
+
+            // entries were saved in order, so each goes at the end
+            while (n-- != 0 && end - p >= 15) {
+                ui3p name = p + 14;
+                ui3r L = p[13];
+                if (L > DRIVE_NAME_MAX || end - name < L + 1 || name[L] > 27 || end - (name + L + 1) < name[L]) {
+                    break;
+                }
+                // names are saved without a terminator
+                memcpy(s, name, L);
+                s[L] = 0;
+                if (!DiskCat_Find(s, &pos) && pos == DiskCatCount) {
+                    DiskCatEntry *e = DiskCat_Insert(pos, s, L);
+                    if (e == NULL) {
+                        break;
+                    }
+                    e->FileSize = do_get_mem_long(p);
+                    e->MTime = do_get_mem_long(p + 4);
+                    e->DiskSize = do_get_mem_long(p + 8);
+                    e->Format = (p[12] < kNumDiskFmts) ? p[12] : kDiskFmtUnknown;
+                    memcpy(e->VolName, name + L + 1, name[L]);
+                    e->VolName[name[L]] = 0;
+                }
+                p = name + L + 1 + name[L];
+            }
+        }
+        pd->file->close(fp);
+    }
+    free(buff);
+}
+
+LOCALPROC DiskCat_StartScan(void) {
+    for (int i = 0; i < DiskCatCount; i++) {
+        DiskCat[i].Seen = falseblnr;
+    }
+    pd->file->listfiles("/", DiskCatListCallback, NULL, 0);
+    DiskCatScanPos = 0;
+    DiskMenu_CatalogChanged(trueblnr);
+}
+
+LOCALPROC DiskCat_EndScan(void) {
+    int i, j;
+
+    // drop what's gone
+    for (i = j = 0; i < DiskCatCount; i++) {
+        if (DiskCat[i].Seen) {
+            DiskCat[j++] = DiskCat[i];
+        } else {
+            free(DiskCat[i].Name);
+            DiskCatDirty = trueblnr;
+        }
+    }
+    DiskCatCount = j;
+    DiskCatScanPos = -1;
+    if (DiskCatDirty) {
+        DiskCat_Save();
+    }
+    DiskMenu_CatalogChanged(trueblnr);
+}
+
+// called every frame
+LOCALPROC DiskCat_Idle(void) {
+    if (DiskCatScanPos < 0) {
+        if (DiskCatWantScan) {
+            DiskCatWantScan = falseblnr;
+            DiskCat_StartScan();
+        }
+        return;
+    }
+
+    int n = SpeedStopped ? DiskCatScanPerFrameStopped : DiskCatScanPerFrame;
+    blnr changed = falseblnr;
+    while (n-- > 0 && DiskCatScanPos < DiskCatCount) {
+        DiskCatEntry *e = &DiskCat[DiskCatScanPos++];
+        if (e->Seen && DiskCat_Check(e)) {
+            DiskCatDirty = trueblnr;
+            changed = trueblnr;
+        }
+    }
+    if (DiskCatScanPos >= DiskCatCount) {
+        DiskCat_EndScan();
+    } else if (changed) {
+        DiskMenu_CatalogChanged(falseblnr);
+    }
+}
+
+LOCALPROC DiskCat_UnInit(void) {
+    if (DiskCatDirty) {
+        DiskCat_Save();
+    }
+    for (int i = 0; i < DiskCatCount; i++) {
+        free(DiskCat[i].Name);
+    }
+    free(DiskCat);
+    DiskCat = NULL;
+    DiskCatCount = DiskCatAlloc = 0;
+}
+
+#pragma mark - Insert Disk Menu
+
+// menu fits 10 lines of 47 characters
+#define DiskImageMenuSize 10
+
+enum {
+    kDiskSortName,
+    kDiskSortVolume,
+    kDiskSortSize,
+    kDiskSortDate,
+    kNumDiskSorts
+};
+
+LOCALVAR const char *DiskSortNames[kNumDiskSorts] = { "name", "volume", "size", "date" };
+LOCALVAR const char *DiskFmtNames[kNumDiskFmts] = { "", "dsk", "dc42", "dsz", "dir", "hda" };
+
+LOCALVAR int *DiskMenuItems = NULL; // catalog entries, in menu order
+LOCALVAR int DiskMenuCount = 0;
+LOCALVAR int SelectedDiskImage = 0;
+LOCALVAR int DiskMenuSort = kDiskSortName;
+
+static int DiskMenuCompare(const void *a, const void *b) {
+    DiskCatEntry *x = &DiskCat[*(const int *)a];
+    DiskCatEntry *y = &DiskCat[*(const int *)b];
+    int c = 0;
+
+    switch (DiskMenuSort) {
+        case kDiskSortVolume:
+            c = strcasecmp(x->VolName, y->VolName);
+            break;
+        case kDiskSortSize:
+            c = (x->DiskSize < y->DiskSize) ? -1 : (x->DiskSize > y->DiskSize);
+            break;
+        case kDiskSortDate:
+            // newest first
+            c = (x->MTime > y->MTime) ? -1 : (x->MTime < y->MTime);
+            break;
+    }
+    return (c != 0) ? c : strcasecmp(x->Name, y->Name);
+}
+
+LOCALPROC DiskMenu_Build(void) {
+    char selected[DRIVE_NAME_MAX+1] = "";
+    int i;
+
+    if (SelectedDiskImage < DiskMenuCount && DiskMenuItems[SelectedDiskImage] < DiskCatCount) {
+        strlcpy(selected, DiskCat[DiskMenuItems[SelectedDiskImage]].Name, sizeof(selected));
+    }
+    int *p = realloc(DiskMenuItems, (DiskCatCount + 1) * sizeof(int));
+    if (p == NULL) {
+        DiskMenuCount = 0;
+        return;
+    }
+    DiskMenuItems = p;
+    DiskMenuCount = 0;
+    for (i = 0; i < DiskCatCount; i++) {
+        if (DiskCat[i].Seen && !IsDiskInserted(DiskCat[i].Name)) {
+            DiskMenuItems[DiskMenuCount++] = i;
+        }
+    }
+    qsort(DiskMenuItems, DiskMenuCount, sizeof(int), DiskMenuCompare);
+
+    // keep the same image selected
     SelectedDiskImage = 0;
-    for (int i=0; i < DiskImageMenuSize; i++) {
-        AvailableDiskImages[i][0] = 0;
+    for (i = 0; i < DiskMenuCount; i++) {
+        if (strcmp(DiskCat[DiskMenuItems[i]].Name, selected) == 0) {
+            SelectedDiskImage = i;
+        }
+    }
+}
+
+LOCALPROC DiskMenu_CatalogChanged(blnr Rebuild) {
+    if (SpecialModeTst(SpclModeInsertDisk)) {
+        if (Rebuild) {
+            DiskMenu_Build();
+        }
+        NeedWholeScreenDraw = trueblnr;
+    }
+}
+
+LOCALFUNC const char * InsertDiskMenuTitle(void) {
+    static char title[48];
+    int pages = (DiskMenuCount + DiskImageMenuSize - 1) / DiskImageMenuSize;
+
+    snprintf(title, sizeof(title), "Insert Disk, by %s%s  %d/%d",
+             DiskSortNames[DiskMenuSort], (DiskCatScanPos >= 0 || DiskCatWantScan) ? "..." : "",
+             SelectedDiskImage / DiskImageMenuSize + 1, (pages == 0) ? 1 : pages);
+    return title;
+}
+
+LOCALPROC DiskMenu_FormatSize(char *s, size_t n, ui5r size) {
+    if (size == 0) {
+        s[0] = 0;
+    } else if (size < 1000 * 1024) {
+        snprintf(s, n, "%uK", (unsigned)((size + 1023) >> 10));
+    } else if (size < 10 * 1024 * 1024) {
+        ui5r tenths = (ui5r)(((unsigned long long)size * 10 + (1 << 19)) >> 20);
+        snprintf(s, n, "%u.%uM", (unsigned)(tenths / 10), (unsigned)(tenths % 10));
+    } else {
+        snprintf(s, n, "%uM", (unsigned)((size + (1 << 19)) >> 20));
+    }
+}
+
+LOCALPROC DrawInsertDiskMenuBody(void) {
+    if (DiskMenuCount == 0) {
+        DrawCellsBeginLine();
+        DrawCellsFromStr((DiskCatScanPos >= 0 || DiskCatWantScan)
+                         ? "Looking for disk images..." : "No disk images available.");
+        DrawCellsEndLine();
+        return;
+    }
+    int first = SelectedDiskImage - SelectedDiskImage % DiskImageMenuSize;
+    for (int i = first; i < first + DiskImageMenuSize && i < DiskMenuCount; i++) {
+        DiskCatEntry *e = &DiskCat[DiskMenuItems[i]];
+        blnr sel = (i == SelectedDiskImage);
+        char name[21];
+        char size[8];
+        char line[64];
+        int j;
+
+        // ';' and '^' are escapes for DrawCellsFromStr
+        for (j = 0; j < 20 && e->Name[j] != 0; j++) {
+            name[j] = (e->Name[j] == ';' || e->Name[j] == '^') ? '?' : e->Name[j];
+        }
+        name[j] = 0;
+        DiskMenu_FormatSize(size, sizeof(size), e->DiskSize);
+        snprintf(line, sizeof(line), "- %c%-20s%c %-4s %4s %.12s",
+                 sel ? '[' : ' ', name, sel ? ']' : ' ',
+                 DiskFmtNames[e->Format], size, e->VolName);
+        DrawCellsBeginLine();
+        DrawCellsFromStr(line);
+        DrawCellsEndLine();
     }
-    int index = 0;
-    pd->file->listfiles("/", ListFilesCallback, &index, 0);
+}
+
+LOCALPROC InsertDiskMenuCallback(void *userdata) {
+    // show what's known now, update it as the folder is looked at again
+    DiskCatWantScan = trueblnr;
     SpecialModeSet(SpclModeInsertDisk);
+    DiskMenu_Build();
+    SelectedDiskImage = 0;
     NeedWholeScreenDraw = trueblnr;
 }
 
@@ -667,24 +2330,30 @@ LOCALPROC HandleDiskMenuInput(PDButtons current, float crankChange) {
     lastInput = current;
     if (pushed & kButtonA) {
         // insert selected disk
-        InsertDiskNamed(AvailableDiskImages[SelectedDiskImage]);
+        if (SelectedDiskImage < DiskMenuCount) {
+            InsertDiskNamed(DiskCat[DiskMenuItems[SelectedDiskImage]].Name);
+        }
         SpecialModeClr(SpclModeInsertDisk);
     } else if (pushed & kButtonB) {
         // cancel
         SpecialModeClr(SpclModeInsertDisk);
     } else if ((crankChange < -CrankThreshold) || (pushed & kButtonUp)) {
-        // select up
+        // select up, to the previous page from the top
         if (SelectedDiskImage > 0) {
             SelectedDiskImage -= 1;
-            // play sound
+            NeedWholeScreenDraw = trueblnr;
         }
     } else if ((crankChange > CrankThreshold) || (pushed & kButtonDown)) {
-        // select down
-        int newSelectedDiskImage = SelectedDiskImage + 1;
-        if (newSelectedDiskImage < DiskImageMenuSize && AvailableDiskImages[newSelectedDiskImage][0] != 0) {
-            SelectedDiskImage = newSelectedDiskImage;
-            // play sound
+        // select down, to the next page from the bottom
+        if (SelectedDiskImage + 1 < DiskMenuCount) {
+            SelectedDiskImage += 1;
+            NeedWholeScreenDraw = trueblnr;
         }
+    } else if (pushed & (kButtonLeft | kButtonRight)) {
+        // change sort order
+        DiskMenuSort = (DiskMenuSort + ((pushed & kButtonLeft) ? kNumDiskSorts - 1 : 1)) % kNumDiskSorts;
+        DiskMenu_Build();
+        NeedWholeScreenDraw = trueblnr;
     }
 }
 
@@ -699,6 +2368,130 @@ LOCALPROC ZapOSGLUVars(void) {
 #endif
 }
 
+#if WantVarRAMSize
+
+#pragma mark - Settings
+
+/*
+ settings.txt, in the game's data folder or bundled with it, one
+ "key = value" per line, '#' starts a comment. Read once at launch,
+ before any memory is allocated:
+   ram = 1M | 2.5M | 4M (also 512K, 2M) - memory of the Mac
+ */
+
+#define SettingsFileName "settings.txt"
+#define SettingsMaxSize 1024
+
+// "2.5M" -> 0x00280000, 0 if not a size
+LOCALFUNC ui5r ParseMemSize(const char *s) {
+    ui5r n = 0;
+    ui5r frac = 0;
+
+    if (*s < '0' || *s > '9') {
+        return 0;
+    }
+    while (*s >= '0' && *s <= '9') {
+        n = n * 10 + (*s++ - '0');
+    }
+    if (*s == '.') {
+        s++;
+        if (*s >= '0' && *s <= '9') {
+            frac = *s++ - '0'; // tenths are plenty
+        }
+        while (*s >= '0' && *s <= '9') {
+            s++;
+        }
+    }
+    switch (*s++) {
+        case 'K':
+        case 'k':
+            n = (n << 10) + (frac << 10) / 10;
+            break;
+        case 'M':
+        case 'm':
+            n = (n << 20) + (frac << 20) / 10;
+            break;
+        default:
+            return 0;
+    }
+    if (*s == 'B' || *s == 'b') {
+        s++;
+    }
+    return (*s == 0) ? n : 0;
+}
+
+LOCALPROC Settings_Set(const char *key, const char *value) {
+    if (strcmp(key, "ram") == 0) {
+        ui5r n = ParseMemSize(value);
+        if (n == 0 || !EmulationSetRAMSize(n)) {
+            pd->system->logToConsole("%s: can't have %s of RAM", SettingsFileName, value);
+        }
+    } else {
+        pd->system->logToConsole("%s: unknown setting %s", SettingsFileName, key);
+    }
+}
+
+// trims the line in place, returns false if it is not "key = value"
+LOCALFUNC blnr Settings_Split(char *line, char **key, char **value) {
+    char *eq;
+    char *s;
+
+    if ((s = strchr(line, '#')) != NULL) {
+        *s = 0;
+    }
+    if ((eq = strchr(line, '=')) == NULL) {
+        return falseblnr;
+    }
+    *eq = 0;
+    for (s = eq; s > line && (s[-1] == ' ' || s[-1] == '\t'); s--) {
+        s[-1] = 0;
+    }
+    for (s = line; *s == ' ' || *s == '\t'; s++) {
+    }
+    *key = s;
+    for (s = eq + 1; *s == ' ' || *s == '\t'; s++) {
+    }
+    *value = s;
+    for (s += strlen(s); s > *value && (s[-1] == ' ' || s[-1] == '\t' || s[-1] == '\r'); s--) {
+        s[-1] = 0;
+    }
+    return **key != 0;
+}
+
+LOCALPROC LoadSettings(void) {
+    char buff[SettingsMaxSize + 1];
+    SDFile *fp = pd->file->open(SettingsFileName, kFileRead|kFileReadData);
+    char *line;
+    char *key;
+    char *value;
+    int n;
+
+    if (fp == NULL) {
+        return; // defaults
+    }
+    n = pd->file->read(fp, buff, SettingsMaxSize);
+    pd->file->close(fp);
+    if (n <= 0) {
+        return;
+    }
+    buff[n] = 0;
+
+    for (line = buff; line != NULL; ) {
+        char *next = strchr(line, '\n');
+        if (next != NULL) {
+            *next++ = 0;
+        }
+        if (Settings_Split(line, &key, &value)) {
+            Settings_Set(key, value);
+        }
+        line = next;
+    }
+}
+
+#endif
+
+#pragma mark - Memory
+
 LOCALPROC ReserveAllocAll(void) {
 #if dbglog_HAVE
     dbglog_ReserveAlloc();
@@ -707,8 +2500,14 @@ LOCALPROC ReserveAllocAll(void) {
 
     ReserveAllocOneBlock(&screencomparebuff,
                          vMacScreenNumBytes, 5, trueblnr);
-    ReserveAllocOneBlock(&CntrlDisplayBuff,
-                         vMacScreenNumBytes, 5, falseblnr);
+    // CntrlDisplayBuff is allocated only while needed, see GetDrawBuff
+#if WantScreenRecord
+    ScrnRec_ReserveAlloc();
+#endif
+    DiskCache_ReserveAlloc();
+#if WantCompressedDisks
+    DskCmp_ReserveAlloc();
+#endif
 #if MySoundEnabled
     ReserveAllocOneBlock((ui3p *)&TheSoundBuffer,
                          dbhBufferSize, 5, falseblnr);
@@ -761,8 +2560,15 @@ LOCALPROC UnallocMyMemory(void) {
 
 LOCALFUNC blnr InitOSGLU(void) {
     blnr IsOk = falseblnr;
+#if WantVarRAMSize
+    LoadSettings();
+    pd->system->logToConsole("RAM: %uK", EmulationRAMSize() >> 10);
+#endif
     if (AllocMyMemory())
         if (Screen_Init())
+#if WantScreenRecord
+        if (ScrnRec_Open())
+#endif
 #if dbglog_HAVE
             if (dbglog_open())
 #endif
@@ -774,6 +2580,7 @@ LOCALFUNC blnr InitOSGLU(void) {
                         if (LoadMacRom())
                             if (InitLocationDat()) {
                                 InitKeyCodes();
+                                DiskCat_Load();
                                 IsOk = trueblnr;
                             }
 
@@ -797,23 +2604,218 @@ LOCALPROC UnInitOSGLU(void) {
     UnInitPbufs();
 #endif
     UnInitDrives();
+    DiskCat_UnInit();
 
 #if dbglog_HAVE
     dbglog_close();
 #endif
 
     CheckSavedMacMsg();
+#if WantScreenRecord
+    ScrnRec_Close();
+#endif
     Screen_UnInit();
 
+    free(CntrlDisplayBuff);
+    CntrlDisplayBuff = nullpr;
     UnallocMyMemory();
 }
 
+#if WantSaveStates
+
+#pragma mark - Save States
+
+/*
+ The whole machine is saved when the game is closed, and put back
+ when it is launched again instead of booting from scratch. What
+ is saved of the emulated hardware is up to EmulationStateIO in
+ PROGMAIN.c; this adds RAM, the mouse and the inserted disks,
+ which must still be there, with the same size, to resume.
+
+ The file is only good once, as the disks change as soon as the
+ Mac runs again, so it is deleted after being read.
+
+ state.dat format (numbers big endian):
+   "vMacSAV1"
+   ui5b RAM size
+   ui5b size of the emulated hardware state
+   ui5b ROM checksum
+   ui5b inserted drives mask
+   ui5b writable drives mask
+   ui4b mouse v, ui4b mouse h
+   for each inserted drive: ui5b file size, ui3b name length, name
+   emulated hardware state
+   for each 32K of RAM: ui5b stored length, chunk (see DSKCMPRS.h)
+*/
+
+#define SaveStateFileName "state.dat"
+#define SaveStateTempName "state.tmp"
+#define SaveStateHeaderSize 32
+#define SaveStateChunkSize DskCmp_MaxChunkSize
+
+LOCALFUNC ui5r SaveState_ChunkLen(ui5r pos) {
+    ui5r n = EmulationRAMSize() - pos;
+    return n > SaveStateChunkSize ? SaveStateChunkSize : n;
+}
+
+LOCALPROC SaveState_Write(void) {
+    ui5r n = EmulationStateSize();
+    ui5r size = SaveStateHeaderSize + NumDrives * (5 + DRIVE_NAME_MAX) + n;
+    ui3p buff = malloc(size + 4 + SaveStateChunkSize);
+    SDFile *fp = NULL;
+    blnr ok = falseblnr;
+
+    if (ForceMacOff) {
+        // shut down, start afresh next time
+    } else if (buff != NULL && (fp = pd->file->open(SaveStateTempName, kFileWrite)) != NULL) {
+        ui3p p = buff + SaveStateHeaderSize;
+        ui3p chunk = buff + size;
+
+        DiskCache_FlushAll();
+        memcpy(buff, "vMacSAV1", 8);
+        do_put_mem_long(buff + 8, EmulationRAMSize());
+        do_put_mem_long(buff + 12, n);
+        do_put_mem_long(buff + 16, do_get_mem_long(ROM));
+        do_put_mem_long(buff + 20, vSonyInsertedMask);
+        do_put_mem_long(buff + 24, vSonyWritableMask);
+        do_put_mem_word(buff + 28, CurMouseV);
+        do_put_mem_word(buff + 30, CurMouseH);
+        for (tDrive i = 0; i < NumDrives; i++) {
+            if (vSonyIsInserted(i)) {
+                ui3r L = strlen(DriveNames[i]);
+                do_put_mem_long(p, DriveSizes[i]);
+                p[4] = L;
+                memcpy(p + 5, DriveNames[i], L);
+                p += 5 + L;
+            }
+        }
+        EmulationStateSave(p);
+        p += n;
+        ok = pd->file->write(fp, buff, p - buff) == (int)(p - buff);
+
+        for (ui5r pos = 0; ok && pos < EmulationRAMSize(); pos += SaveStateChunkSize) {
+            ui5r len = SaveState_ChunkLen(pos);
+            ui5r L = DskCmp_Encode(RAM + pos, len, chunk + 4);
+            if (L == 0) {
+                memcpy(chunk + 4, RAM + pos, len);
+                L = len;
+            }
+            do_put_mem_long(chunk, L);
+            ok = pd->file->write(fp, chunk, 4 + L) == (int)(4 + L);
+        }
+        ok = (pd->file->close(fp) == 0) && ok;
+    }
+    free(buff);
+
+    if (ok) {
+        (void)pd->file->unlink(SaveStateFileName, 0);
+        ok = pd->file->rename(SaveStateTempName, SaveStateFileName) == 0;
+    }
+    if (!ok) {
+        (void)pd->file->unlink(SaveStateTempName, 0);
+    }
+}
+
+LOCALFUNC blnr SaveState_ReadDrives(SDFile *fp, ui5b Inserted, ui5b Writable) {
+    ui3b h[5];
+    char name[DRIVE_NAME_MAX+1];
+
+    UnInitDrives();
+    for (tDrive i = 0; i < NumDrives; i++) {
+        if (0 != (Inserted & ((ui5b)1 << i))) {
+            if (pd->file->read(fp, h, 5) != 5
+                || pd->file->read(fp, name, h[4]) != h[4]) {
+                return falseblnr;
+            }
+            name[h[4]] = 0;
+            if (!InsertDiskInDrive(i, name) || DriveSizes[i] != do_get_mem_long(h)) {
+                return falseblnr;
+            }
+        }
+    }
+    // locked images that aren't any more would confuse the Mac
+    return vSonyInsertedMask == Inserted && vSonyWritableMask == Writable;
+}
+
+LOCALFUNC blnr SaveState_ReadRAM(SDFile *fp, ui3p chunk) {
+    ui3b h[4];
+    ui5r L;
+
+    for (ui5r pos = 0; pos < EmulationRAMSize(); pos += SaveStateChunkSize) {
+        ui5r n = SaveState_ChunkLen(pos);
+        if (pd->file->read(fp, h, 4) != 4
+            || (L = do_get_mem_long(h)) > n
+            || pd->file->read(fp, chunk, L) != (int)L
+            || !DskCmp_Decode(chunk, L, RAM + pos, n)) {
+            return falseblnr;
+        }
+    }
+    return trueblnr;
+}
+
+// call after InitEmulation, returns false to boot as usual
+LOCALFUNC blnr SaveState_Read(void) {
+    SDFile *fp = pd->file->open(SaveStateFileName, kFileReadData);
+    ui5r n = EmulationStateSize();
+    ui3b head[SaveStateHeaderSize];
+    ui3p buff = NULL;
+    blnr ok = falseblnr;
+
+    if (fp == NULL) {
+        return falseblnr;
+    }
+    if (pd->file->read(fp, head, SaveStateHeaderSize) == SaveStateHeaderSize
+        && memcmp(head, "vMacSAV1", 8) == 0
+        && do_get_mem_long(head + 8) == EmulationRAMSize()
+        && do_get_mem_long(head + 12) == n
+        && do_get_mem_long(head + 16) == do_get_mem_long(ROM)
+        && (buff = malloc(n + SaveStateChunkSize)) != NULL) {
+        if (SaveState_ReadDrives(fp, do_get_mem_long(head + 20), do_get_mem_long(head + 24))
+            && pd->file->read(fp, buff, n) == (int)n
+            && SaveState_ReadRAM(fp, buff + n)
+            && EmulationStateLoad(buff, n)) {
+            CurMouseV = do_get_mem_word(head + 28);
+            CurMouseH = do_get_mem_word(head + 30);
+            NeedWholeScreenDraw = trueblnr;
+            ok = trueblnr;
+        } else {
+            // the machine is still as it was reset, boot it with the usual disks
+            memset(RAM, 0, EmulationRAMSize());
+            UnInitDrives();
+            (void)LoadInitialImages();
+        }
+    }
+    pd->file->close(fp);
+    free(buff);
+    (void)pd->file->unlink(SaveStateFileName, 0);
+
+    return ok;
+}
+
+#endif
+
+// the control mode screen needs a buffer only while it is up
+LOCALFUNC ui3p GetDrawBuff(void) {
+    if (SpecialModes == 0) {
+        if (CntrlDisplayBuff != nullpr) {
+            free(CntrlDisplayBuff);
+            CntrlDisplayBuff = nullpr;
+        }
+    } else if (CntrlDisplayBuff == nullpr) {
+        CntrlDisplayBuff = malloc(vMacScreenNumBytes);
+        if (CntrlDisplayBuff == nullpr) {
+            return screencomparebuff; // just the Mac
+        }
+    }
+    return GetCurDrawBuff();
+}
+
 LOCALPROC MyUpdateScreen(void) {
     uint8_t *buf = pd->graphics->getFrame();
     if (NeedWholeScreenDraw) {
         ScreenChangedAll();
     }
-    ui3p drawBuff = GetCurDrawBuff();
+    ui3p drawBuff = GetDrawBuff();
     if (ScreenChangedBottom > ScreenChangedTop) {
         for (int i=ScreenChangedTop; i <= ScreenChangedBottom; i++) {
             if (i < LCD_ROWS) {
@@ -829,6 +2831,133 @@ IMPORTPROC RunEmulatedTicksToTrueTime(void);
 IMPORTPROC DoEmulateExtraTime(void);
 IMPORTPROC DoEmulateOneTick(void);
 
+LOCALPROC RunEmulatedTicksForFrame(void) {
+    ui5r lag = TrueEmulatedTime - EmulatedTicksDone;
+    ui5r n = 0;
+    float BusyTime;
+
+    if (lag > MaxLagTicks) {
+        // can't catch up, forget it
+        EmulatedTicksDone = TrueEmulatedTime - MaxLagTicks;
+        lag = MaxLagTicks;
+    }
+
+    if (lag > 0) {
+        ui5r todo = (lag > MaxTicksPerFrame) ? MaxTicksPerFrame : lag;
+
+        EmVideoDisable = trueblnr;
+        while ((n + 1 < todo) && ExtraTimeNotOver()) {
+            DoEmulateOneTick();
+            ++n;
+        }
+        EmVideoDisable = falseblnr;
+        UpdateInput();
+        DoEmulateOneTick();
+        ++n;
+        EmulatedTicksDone += n;
+
+        BusyTime = pd->system->getElapsedTime();
+        TickTimeAvg += (BusyTime / n - TickTimeAvg) * 0.125f;
+    } else {
+        // ahead of real time, let the CPU idle
+        UpdateInput();
+        BusyTime = 0.0f;
+    }
+
+    // before MyUpdateScreen clears the changes
+    SchedulerAdjustRate(lag > n, ScreenChangedBottom > ScreenChangedTop,
+        BusyTime);
+}
+
+#if WantFastBoot
+
+/*
+    Nothing shown while the Mac starts up is worth the time to draw
+    it, so after a cold start ticks are run back to back, with the
+    video off and no regard for real time, until an application
+    (normally the Finder) has been launched and the screen has then
+    stayed the same for FastBootQuietTicks, or a button is pressed.
+    Only a small bar moves in the meantime.
+
+    Every FastBootCheckTicks the video is left on for one tick, so
+    that ScreenFindChanges compares the screen with the last check,
+    without drawing anything.
+*/
+
+#define FastBootQuietTicks 90
+#define FastBootCheckTicks 10
+#define FastBootMaxTicks (60 * 60 * 3) // 3 emulated minutes at most
+#define FastBootFrameTime 0.1f // seconds per update, to stay responsive
+#define FastBootBarWidth 120
+#define FastBootBarY (LCD_ROWS - 24)
+#define CurApNameAddr 0x0910 // low memory, empty until the first launch
+
+LOCALVAR blnr FastBooting = falseblnr;
+LOCALVAR ui5r FastBootTicks;
+LOCALVAR ui5r FastBootQuiet;
+
+LOCALPROC FastBoot_Start(void) {
+    FastBooting = trueblnr;
+    FastBootTicks = 0;
+    FastBootQuiet = 0;
+    pd->graphics->clear(kColorBlack);
+}
+
+LOCALPROC FastBoot_End(void) {
+    FastBooting = falseblnr;
+    EmVideoDisable = falseblnr;
+    EmulatedTicksDone = TrueEmulatedTime;
+    NeedWholeScreenDraw = trueblnr;
+    pd->system->logToConsole("Started up in %u ticks", (unsigned)FastBootTicks);
+}
+
+LOCALPROC FastBoot_DrawBar(void) {
+    int x = (LCD_COLUMNS - FastBootBarWidth) / 2;
+    int pos = (FastBootTicks / 4) % (FastBootBarWidth - 16);
+
+    pd->graphics->fillRect(x, FastBootBarY, FastBootBarWidth, 8, kColorBlack);
+    pd->graphics->drawRect(x, FastBootBarY, FastBootBarWidth, 8, kColorWhite);
+    pd->graphics->fillRect(x + 2 + pos, FastBootBarY + 2, 12, 4, kColorWhite);
+}
+
+LOCALPROC FastBoot_Run(void) {
+    PDButtons current, pushed, released;
+    ui5r ticks = 0;
+
+    pd->system->getButtonState(&current, &pushed, &released);
+    if (current != 0 || SpecialModeTst(SpclModeInsertDisk)) {
+        FastBoot_End();
+        return;
+    }
+
+    do {
+        ++FastBootTicks;
+        ++ticks;
+        EmVideoDisable = (FastBootTicks % FastBootCheckTicks) != 0;
+        DoEmulateOneTick();
+        if (!EmVideoDisable) {
+            if (ScreenChangedBottom > ScreenChangedTop) {
+                ScreenClearChanges();
+                FastBootQuiet = 0;
+            } else {
+                FastBootQuiet += FastBootCheckTicks;
+            }
+        }
+    } while (pd->system->getElapsedTime() < FastBootFrameTime);
+    EmVideoDisable = falseblnr;
+    EmulatedTicksDone = TrueEmulatedTime;
+    DiskCache_IdleTicks(ticks);
+
+    if ((RAM[CurApNameAddr] != 0 && FastBootQuiet >= FastBootQuietTicks)
+        || FastBootTicks >= FastBootMaxTicks || ForceMacOff) {
+        FastBoot_End();
+    } else {
+        FastBoot_DrawBar();
+    }
+}
+
+#endif
+
 LOCALFUNC int DoUpdate(void* userdata) {
     pd = userdata;
     if (showFPS) {
@@ -840,37 +2969,32 @@ LOCALFUNC int DoUpdate(void* userdata) {
         return 1;
     }
 
-    /*WaitForNextTick();
-     RunEmulatedTicksToTrueTime();
-     DoEmulateExtraTime();*/
-
-#if dbglog_HAVE && dbglog_Lag
-    static int lagCount = 0;
-    if (++lagCount % 30 == 0) {
-        pd->system->resetElapsedTime();
+    UpdateTrueEmulatedTime();
+    CrankChange = pd->system->getCrankChange();
+#if WantFastBoot
+    if (FastBooting) {
+        FastBoot_Run();
+        return 1;
     }
 #endif
-
+#if WantRewind
+    if (RewindInput()) {
+        EmulatedTicksDone = TrueEmulatedTime;
+    } else
+#endif
     if (!SpeedStopped) {
+        ui5r ticks = EmulatedTicksDone;
         CheckDateTime();
-        EmVideoDisable = trueblnr;
-        for (int i=0; i < (TicksPerFrame - 1); i++) {
-            DoEmulateOneTick();
-        }
-        EmVideoDisable = falseblnr;
-        UpdateInput();
-        DoEmulateOneTick();
+        RunEmulatedTicksForFrame();
+        DiskCache_IdleTicks(EmulatedTicksDone - ticks);
+    } else {
+        EmulatedTicksDone = TrueEmulatedTime;
+        DiskCache_IdleTicks(DiskCacheFlushIdleTicks);
     }
+    DiskCat_Idle();
 
     // update screen
     MyUpdateScreen();
 
-#if dbglog_HAVE && dbglog_Lag
-    float emTime = pd->system->getElapsedTime();
-    float timePerTick = emTime / (float)(TicksPerFrame);
-    if (lagCount % 30 == 0) {
-        pd->system->logToConsole("avg time per tick %dus (expected %dus)", (int)(timePerTick * 1000000), (int)(MyTickDuration * 1000000));
-    }
-#endif
     return 1;
 }
@@ -268,6 +268,29 @@ LOCALPROC NativeStrFromCStr(char *r, char *s)
 
 LOCALVAR MyFilePtr Drives[NumDrives]; /* open disk image files */
 
+#ifndef MayMapDisks
+#define MayMapDisks 0
+#endif
+
+#if MayMapDisks && UseRWops
+#error "MayMapDisks needs stdio files"
+#endif
+
+#if MayMapDisks
+#include "DISKMMAP.h"
+#endif
+
+#ifndef MayMapRAM
+#define MayMapRAM 0
+#endif
+
+#if MayMapRAM && WantSaveStates
+/* resuming from a snapshot, disks are copy-on-write (RAMMMAP.h) */
+LOCALVAR blnr DisksPrivate = falseblnr;
+#else
+#define DisksPrivate falseblnr
+#endif
+
 LOCALPROC InitDrives(void)
 {
 	/*
@@ -278,6 +301,9 @@ LOCALPROC InitDrives(void)
 
 	for (i = 0; i < NumDrives; ++i) {
 		Drives[i] = NotAfileRef;
+#if MayMapDisks
+		DriveMaps[i] = nullpr;
+#endif
 	}
 }
 
@@ -295,6 +321,13 @@ GLOBALOSGLUFUNC tMacErr vSonyTransfer(blnr IsWrite, ui3p Buffer,
 	MyFilePtr refnum = Drives[Drive_No];
 	ui5r NewSony_Count = 0;
 
+#if MayMapDisks
+	if (nullpr != DriveMaps[Drive_No]) {
+		return DiskMap_Transfer(IsWrite, Buffer, Drive_No,
+			Sony_Start, Sony_Count, Sony_ActCount);
+	}
+#endif
+
 	if (MySeek(refnum, Sony_Start, MySeekSet) >= 0) {
 		if (IsWrite) {
 			NewSony_Count = MyFileWrite(Buffer, 1, Sony_Count, refnum);
@@ -328,6 +361,13 @@ GLOBALOSGLUFUNC tMacErr vSonyGetSize(tDrive Drive_No, ui5r *Sony_Count)
 	MyFilePtr refnum = Drives[Drive_No];
 	long v;
 
+#if MayMapDisks
+	if (nullpr != DriveMaps[Drive_No]) {
+		*Sony_Count = DriveMapSizes[Drive_No];
+		return mnvm_noErr;
+	}
+#endif
+
 	if (MySeek(refnum, 0, MySeekEnd) >= 0) {
 		v = MyFileTell(refnum);
 		if (v >= 0) {
@@ -353,6 +393,10 @@ LOCALFUNC tMacErr vSonyEject0(tDrive Drive_No, blnr deleteit)
 
 	DiskEjectedNotify(Drive_No);
 
+#if MayMapDisks
+	DiskMap_Close(Drive_No);
+#endif
+
 	MyFileClose(refnum);
 	Drives[Drive_No] = NotAfileRef; /* not really needed */
 
@@ -395,6 +439,16 @@ LOCALFUNC blnr Sony_Insert0(MyFilePtr refnum, blnr locked,
 
 		{
 			Drives[Drive_No] = refnum;
+#if MayMapDisks
+			if (! DiskMap_Open(Drive_No, fileno(refnum), locked,
+				DisksPrivate))
+#endif
+			{
+				if (DisksPrivate) {
+					/* no private copy to write to */
+					locked = trueblnr;
+				}
+			}
 			DiskInsertNotify(Drive_No, locked);
 
 			IsOk = trueblnr;
@@ -416,6 +470,10 @@ LOCALFUNC blnr Sony_Insert1(char *drivepath, blnr silentfail)
 	if (NULL == refnum) {
 		locked = trueblnr;
 		refnum = MyFileOpen(drivepath, "rb");
+	} else if (DisksPrivate) {
+		/* writable, but only through a private copy */
+		MyFileClose(refnum);
+		refnum = MyFileOpen(drivepath, "rb");
 	}
 	if (NULL == refnum) {
 		if (! silentfail) {
@@ -656,9 +714,22 @@ LOCALVAR SDL_PixelFormat *my_format = NULL;
 #endif
 
 LOCALVAR ui3p ScalingBuff = nullpr;
+LOCALVAR ui5r ScalingOrigin = 0;
 
 LOCALVAR ui3p CLUT_final;
 
+/*
+	CLUT_final only depends on the pixel format and the magnify
+	setting when in black and white, so it is built once and kept
+	until one of those changes, instead of on every update.
+*/
+LOCALVAR blnr CLUT_final_Valid = falseblnr;
+LOCALVAR Uint32 CLUT_final_Rmask;
+LOCALVAR int CLUT_final_bpp;
+#if EnableMagnify
+LOCALVAR blnr CLUT_final_Magnify;
+#endif
+
 #define CLUT_finalsz (256 * 8 * 4 * MaxScale)
 	/*
 		256 possible values of one byte
@@ -670,6 +741,7 @@ LOCALVAR ui3p CLUT_final;
 #define ScrnMapr_DoMap UpdateBWDepth3Copy
 #define ScrnMapr_Src GetCurDrawBuff()
 #define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_DstOrigin ScalingOrigin
 #define ScrnMapr_SrcDepth 0
 #define ScrnMapr_DstDepth 3
 #define ScrnMapr_Map CLUT_final
@@ -679,6 +751,7 @@ LOCALVAR ui3p CLUT_final;
 #define ScrnMapr_DoMap UpdateBWDepth4Copy
 #define ScrnMapr_Src GetCurDrawBuff()
 #define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_DstOrigin ScalingOrigin
 #define ScrnMapr_SrcDepth 0
 #define ScrnMapr_DstDepth 4
 #define ScrnMapr_Map CLUT_final
@@ -688,6 +761,7 @@ LOCALVAR ui3p CLUT_final;
 #define ScrnMapr_DoMap UpdateBWDepth5Copy
 #define ScrnMapr_Src GetCurDrawBuff()
 #define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_DstOrigin ScalingOrigin
 #define ScrnMapr_SrcDepth 0
 #define ScrnMapr_DstDepth 5
 #define ScrnMapr_Map CLUT_final
@@ -699,6 +773,7 @@ LOCALVAR ui3p CLUT_final;
 #define ScrnMapr_DoMap UpdateBWDepth3ScaledCopy
 #define ScrnMapr_Src GetCurDrawBuff()
 #define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_DstOrigin ScalingOrigin
 #define ScrnMapr_SrcDepth 0
 #define ScrnMapr_DstDepth 3
 #define ScrnMapr_Map CLUT_final
@@ -709,6 +784,7 @@ LOCALVAR ui3p CLUT_final;
 #define ScrnMapr_DoMap UpdateBWDepth4ScaledCopy
 #define ScrnMapr_Src GetCurDrawBuff()
 #define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_DstOrigin ScalingOrigin
 #define ScrnMapr_SrcDepth 0
 #define ScrnMapr_DstDepth 4
 #define ScrnMapr_Map CLUT_final
@@ -719,6 +795,7 @@ LOCALVAR ui3p CLUT_final;
 #define ScrnMapr_DoMap UpdateBWDepth5ScaledCopy
 #define ScrnMapr_Src GetCurDrawBuff()
 #define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_DstOrigin ScalingOrigin
 #define ScrnMapr_SrcDepth 0
 #define ScrnMapr_DstDepth 5
 #define ScrnMapr_Map CLUT_final
@@ -734,6 +811,7 @@ LOCALVAR ui3p CLUT_final;
 #define ScrnMapr_DoMap UpdateColorDepth3Copy
 #define ScrnMapr_Src GetCurDrawBuff()
 #define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_DstOrigin ScalingOrigin
 #define ScrnMapr_SrcDepth vMacScreenDepth
 #define ScrnMapr_DstDepth 3
 #define ScrnMapr_Map CLUT_final
@@ -743,6 +821,7 @@ LOCALVAR ui3p CLUT_final;
 #define ScrnMapr_DoMap UpdateColorDepth4Copy
 #define ScrnMapr_Src GetCurDrawBuff()
 #define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_DstOrigin ScalingOrigin
 #define ScrnMapr_SrcDepth vMacScreenDepth
 #define ScrnMapr_DstDepth 4
 #define ScrnMapr_Map CLUT_final
@@ -752,6 +831,7 @@ LOCALVAR ui3p CLUT_final;
 #define ScrnMapr_DoMap UpdateColorDepth5Copy
 #define ScrnMapr_Src GetCurDrawBuff()
 #define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_DstOrigin ScalingOrigin
 #define ScrnMapr_SrcDepth vMacScreenDepth
 #define ScrnMapr_DstDepth 5
 #define ScrnMapr_Map CLUT_final
@@ -763,6 +843,7 @@ LOCALVAR ui3p CLUT_final;
 #define ScrnMapr_DoMap UpdateColorDepth3ScaledCopy
 #define ScrnMapr_Src GetCurDrawBuff()
 #define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_DstOrigin ScalingOrigin
 #define ScrnMapr_SrcDepth vMacScreenDepth
 #define ScrnMapr_DstDepth 3
 #define ScrnMapr_Map CLUT_final
@@ -773,6 +854,7 @@ LOCALVAR ui3p CLUT_final;
 #define ScrnMapr_DoMap UpdateColorDepth4ScaledCopy
 #define ScrnMapr_Src GetCurDrawBuff()
 #define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_DstOrigin ScalingOrigin
 #define ScrnMapr_SrcDepth vMacScreenDepth
 #define ScrnMapr_DstDepth 4
 #define ScrnMapr_Map CLUT_final
@@ -783,6 +865,7 @@ LOCALVAR ui3p CLUT_final;
 #define ScrnMapr_DoMap UpdateColorDepth5ScaledCopy
 #define ScrnMapr_Src GetCurDrawBuff()
 #define ScrnMapr_Dst ScalingBuff
+#define ScrnMapr_DstOrigin ScalingOrigin
 #define ScrnMapr_SrcDepth vMacScreenDepth
 #define ScrnMapr_DstDepth 5
 #define ScrnMapr_Map CLUT_final
@@ -811,10 +894,13 @@ LOCALPROC HaveChangedScreenBuff(ui4r top, ui4r left,
 	ui5r left2;
 	ui5r bottom2;
 	ui5r right2;
+	ui5r LockTop = 0;
+	ui5r LockLeft = 0;
 	void *pixels;
 	int pitch;
 
 #if 2 == SDL_MAJOR_VERSION
+	SDL_Rect lock_rect;
 	SDL_Rect src_rect;
 	SDL_Rect dst_rect;
 	int XDest;
@@ -906,7 +992,24 @@ LOCALPROC HaveChangedScreenBuff(ui4r top, ui4r left,
 	pitch = my_surface->pitch;
 
 #elif 2 == SDL_MAJOR_VERSION
-	if (0 != SDL_LockTexture(my_texture, NULL, &pixels, &pitch)) {
+	/*
+		Only lock the changed rectangle, widened to whole source
+		bytes since the screen mapping works a byte at a time,
+		so the renderer only has to upload that part.
+	*/
+	LockTop = top2;
+	LockLeft = left & ~ 7;
+	lock_rect.w = ((right + 7) & ~ 7) - LockLeft;
+#if EnableMagnify && ! UseSDLscaling
+	if (UseMagnify) {
+		LockLeft *= MyWindowScale;
+		lock_rect.w *= MyWindowScale;
+	}
+#endif
+	lock_rect.x = LockLeft;
+	lock_rect.y = LockTop;
+	lock_rect.h = bottom2 - top2;
+	if (0 != SDL_LockTexture(my_texture, &lock_rect, &pixels, &pitch)) {
 		return;
 	}
 #endif
@@ -960,7 +1063,35 @@ LOCALPROC HaveChangedScreenBuff(ui4r top, ui4r left,
 			8;
 		Uint8 *p4 = (Uint8 *)CLUT_final;
 
-		for (i = 0; i < 256; ++i) {
+		if (CLUT_final_Valid
+			&& (CLUT_final_bpp == bpp)
+			&& (CLUT_final_Rmask == my_format->Rmask)
+#if EnableMagnify
+			&& (CLUT_final_Magnify == UseMagnify)
+#endif
+#if 0 != vMacScreenDepth
+			&& ! UseColorMode
+#endif
+			)
+		{
+			/* table still good */
+			i = 256;
+		} else {
+#if 0 != vMacScreenDepth
+			/* colors may change at any time, rebuild each time */
+			CLUT_final_Valid = ! UseColorMode;
+#else
+			CLUT_final_Valid = trueblnr;
+#endif
+			CLUT_final_bpp = bpp;
+			CLUT_final_Rmask = my_format->Rmask;
+#if EnableMagnify
+			CLUT_final_Magnify = UseMagnify;
+#endif
+			i = 0;
+		}
+
+		for (; i < 256; ++i) {
 			for (k = PixPerByte; --k >= 0; ) {
 
 #if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
@@ -1000,7 +1131,12 @@ LOCALPROC HaveChangedScreenBuff(ui4r top, ui4r left,
 			}
 		}
 
+		/*
+			the mapping procedures index from the top left of
+			the whole screen, pixels is at the locked rectangle.
+		*/
 		ScalingBuff = (ui3p)pixels;
+		ScalingOrigin = LockTop * (ui5r)pitch + LockLeft * bpp;
 
 #if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
 		if (UseColorMode) {
@@ -1081,7 +1217,7 @@ LOCALPROC HaveChangedScreenBuff(ui4r top, ui4r left,
 				int i0 = i;
 				int j0 = j;
 				Uint8 *bufp = (Uint8 *)pixels
-					+ i * pitch + j * bpp;
+					+ (i - LockTop) * pitch + (j - LockLeft) * bpp;
 
 #if EnableMagnify && ! UseSDLscaling
 				if (UseMagnify) {
@@ -4587,6 +4723,11 @@ LOCALPROC CheckForSavedTasks(void)
 
 /* --- command line parsing --- */
 
+#if MayMapRAM && WantSaveStates
+LOCALVAR char *snap_load_path = NULL;
+LOCALVAR char *snap_save_path = NULL;
+#endif
+
 LOCALFUNC blnr ScanCommandLine(void)
 {
 	char *pa;
@@ -4622,6 +4763,23 @@ label_retry:
 					goto label_retry;
 				}
 			} else
+#if MayMapRAM && WantSaveStates
+			if (0 == strcmp(pa, "--snapshot"))
+			{
+				if (i < my_argc) {
+					snap_load_path = my_argv[i++];
+					DisksPrivate = trueblnr;
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--save-snapshot"))
+			{
+				if (i < my_argc) {
+					snap_save_path = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+#endif
 			if (('p' == pa[1]) && ('s' == pa[2]) && ('n' == pa[3]))
 			{
 				/* seen in OS X. ignore */
@@ -4695,8 +4853,23 @@ GLOBALOSGLUFUNC blnr ExtraTimeNotOver(void)
 	return TrueEmulatedTime == OnTrueTime;
 }
 
+#if MayMapRAM && WantSaveStates
+FORWARDFUNC blnr RAMSnap_Load(char *path);
+#endif
+
 GLOBALOSGLUPROC WaitForNextTick(void)
 {
+#if MayMapRAM && WantSaveStates
+	if (NULL != snap_load_path) {
+		/* before the first tick */
+		if (! RAMSnap_Load(snap_load_path)) {
+			fprintf(stderr, "%s: not a snapshot of this machine,"
+				" booting instead\n", snap_load_path);
+		}
+		snap_load_path = NULL;
+	}
+#endif
+
 label_retry:
 	CheckForSystemEvents();
 	CheckForSavedTasks();
@@ -4751,6 +4924,33 @@ label_retry:
 
 #include "PROGMAIN.h"
 
+#if MayMapRAM
+#include "RAMMMAP.h"
+#endif
+
+#if MayMapRAM && WantSaveStates
+LOCALFUNC ui5r RAMSnap_DriveMTime(tDrive i)
+{
+#if UseRWops
+	UnusedParam(i);
+	return 0; /* can't tell, the hash has to do */
+#else
+	struct stat st;
+
+#if MayMapDisks
+	if (nullpr != DriveMaps[i]) {
+		(void) msync(DriveMaps[i], DriveMapSizes[i], MS_SYNC);
+	}
+#endif
+	(void) fflush(Drives[i]);
+	if (0 != fstat(fileno(Drives[i]), &st)) {
+		return (ui5r) -1; /* never matches */
+	}
+	return (ui5r)st.st_mtime;
+#endif
+}
+#endif
+
 LOCALPROC ZapOSGLUVars(void)
 {
 	/*
@@ -4767,6 +4967,9 @@ LOCALPROC ZapOSGLUVars(void)
 
 LOCALPROC ReserveAllocAll(void)
 {
+#if MayMapRAM
+	EmulationReserveAlloc(); /* RAM first, page aligned */
+#endif
 #if dbglog_HAVE
 	dbglog_ReserveAlloc();
 #endif
@@ -4785,7 +4988,9 @@ LOCALPROC ReserveAllocAll(void)
 		dbhBufferSize, 5, falseblnr);
 #endif
 
+#if ! MayMapRAM
 	EmulationReserveAlloc();
+#endif
 }
 
 LOCALFUNC blnr AllocMyMemory(void)
@@ -4797,7 +5002,11 @@ LOCALFUNC blnr AllocMyMemory(void)
 	ReserveAllocBigBlock = nullpr;
 	ReserveAllocAll();
 	n = ReserveAllocOffset;
+#if MayMapRAM
+	ReserveAllocBigBlock = RAMMap_AllocBlock(n);
+#else
 	ReserveAllocBigBlock = (ui3p)calloc(1, n);
+#endif
 	if (NULL == ReserveAllocBigBlock) {
 		MacMsg(kStrOutOfMemTitle, kStrOutOfMemMessage, trueblnr);
 	} else {
@@ -4816,7 +5025,11 @@ LOCALFUNC blnr AllocMyMemory(void)
 LOCALPROC UnallocMyMemory(void)
 {
 	if (nullpr != ReserveAllocBigBlock) {
+#if MayMapRAM
+		RAMMap_FreeBlock(ReserveAllocBigBlock);
+#else
 		free((char *)ReserveAllocBigBlock);
+#endif
 	}
 }
 
@@ -4924,6 +5137,17 @@ int main(int argc, char **argv)
 	ZapOSGLUVars();
 	if (InitOSGLU()) {
 		ProgramMain();
+#if MayMapRAM && WantSaveStates
+		if (NULL == snap_save_path) {
+			/* nothing to save */
+		} else if (DisksPrivate) {
+			fprintf(stderr, "%s: not saved, disk changes after"
+				" --snapshot are not kept\n", snap_save_path);
+		} else if (! RAMSnap_Save(snap_save_path)) {
+			fprintf(stderr, "%s: could not save snapshot\n",
+				snap_save_path);
+		}
+#endif
 	}
 	UnInitOSGLU();
 
@@ -470,10 +470,88 @@ LOCALPROC NativeStrFromCStr(char *r, char *s)
 #define NotAfileRef NULL
 
 LOCALVAR FILE *Drives[NumDrives]; /* open disk image files */
+
+#ifndef MayMapDisks
+#define MayMapDisks 0
+#endif
+
+#if MayMapDisks
+#include "DISKMMAP.h"
+#endif
+
+#ifndef MayMapRAM
+#define MayMapRAM 0
+#endif
+
+#if MayMapRAM && WantSaveStates
+/* resuming from a snapshot, disks are copy-on-write (RAMMMAP.h) */
+LOCALVAR blnr DisksPrivate = falseblnr;
+#else
+#define DisksPrivate falseblnr
+#endif
+
 #if IncludeSonyGetName || IncludeSonyNew
 LOCALVAR char *DriveNames[NumDrives];
 #endif
 
+#ifndef WantFolderVolumes
+#define WantFolderVolumes 0
+#endif
+
+#if WantFolderVolumes
+#include <dirent.h>
+#include <sys/stat.h>
+#include "FLDRVOLM.h"
+
+LOCALVAR FldrVolR *DriveFolders[NumDrives]; /* nullpr if not a folder */
+
+LOCALPROC FldrVol_ListHost(FldrVolR *v, ui5r Parent, char *path)
+{
+	DIR *d = opendir(path);
+	struct dirent *e;
+	struct stat st;
+	char s[FldrVol_PathMax];
+
+	if (NULL != d) {
+		while (NULL != (e = readdir(d))) {
+			if ((snprintf(s, sizeof(s), "%s/%s", path, e->d_name)
+					< (int)sizeof(s))
+				&& (0 == stat(s, &st)))
+			{
+				if (S_ISDIR(st.st_mode)) {
+					FldrVol_Add(v, Parent, e->d_name, trueblnr, 0);
+				} else if (S_ISREG(st.st_mode)) {
+					FldrVol_Add(v, Parent, e->d_name, falseblnr,
+						st.st_size);
+				}
+			}
+		}
+		closedir(d);
+	}
+}
+
+LOCALFUNC anyp FldrVol_OpenHost(char *path)
+{
+	return (anyp)fopen(path, "rb");
+}
+
+LOCALFUNC tMacErr FldrVol_ReadHost(anyp f, ui5r Offset,
+	ui3p Buffer, ui5r Count)
+{
+	if ((0 != fseek((FILE *)f, Offset, SEEK_SET))
+		|| (fread(Buffer, 1, Count, (FILE *)f) != Count))
+	{
+		return mnvm_miscErr;
+	}
+	return mnvm_noErr;
+}
+
+LOCALPROC FldrVol_CloseHost(anyp f)
+{
+	fclose((FILE *)f);
+}
+#endif
+
 LOCALPROC InitDrives(void)
 {
 	/*
@@ -484,6 +562,12 @@ LOCALPROC InitDrives(void)
 
 	for (i = 0; i < NumDrives; ++i) {
 		Drives[i] = NotAfileRef;
+#if MayMapDisks
+		DriveMaps[i] = nullpr;
+#endif
+#if WantFolderVolumes
+		DriveFolders[i] = nullpr;
+#endif
 #if IncludeSonyGetName || IncludeSonyNew
 		DriveNames[i] = NULL;
 #endif
@@ -498,6 +582,31 @@ GLOBALOSGLUFUNC tMacErr vSonyTransfer(blnr IsWrite, ui3p Buffer,
 	FILE *refnum = Drives[Drive_No];
 	ui5r NewSony_Count = 0;
 
+#if WantFolderVolumes
+	if (nullpr != DriveFolders[Drive_No]) {
+		if (IsWrite) {
+			err = mnvm_wPrErr;
+		} else {
+			err = FldrVol_Read(DriveFolders[Drive_No], Buffer,
+				Sony_Start, Sony_Count);
+			if (mnvm_noErr == err) {
+				NewSony_Count = Sony_Count;
+			}
+		}
+		if (nullpr != Sony_ActCount) {
+			*Sony_ActCount = NewSony_Count;
+		}
+		return err;
+	}
+#endif
+
+#if MayMapDisks
+	if (nullpr != DriveMaps[Drive_No]) {
+		return DiskMap_Transfer(IsWrite, Buffer, Drive_No,
+			Sony_Start, Sony_Count, Sony_ActCount);
+	}
+#endif
+
 	if (0 == fseek(refnum, Sony_Start, SEEK_SET)) {
 		if (IsWrite) {
 			NewSony_Count = fwrite(Buffer, 1, Sony_Count, refnum);
@@ -523,6 +632,20 @@ GLOBALOSGLUFUNC tMacErr vSonyGetSize(tDrive Drive_No, ui5r *Sony_Count)
 	FILE *refnum = Drives[Drive_No];
 	long v;
 
+#if WantFolderVolumes
+	if (nullpr != DriveFolders[Drive_No]) {
+		*Sony_Count = DriveFolders[Drive_No]->Size;
+		return mnvm_noErr;
+	}
+#endif
+
+#if MayMapDisks
+	if (nullpr != DriveMaps[Drive_No]) {
+		*Sony_Count = DriveMapSizes[Drive_No];
+		return mnvm_noErr;
+	}
+#endif
+
 	if (0 == fseek(refnum, 0, SEEK_END)) {
 		v = ftell(refnum);
 		if (v >= 0) {
@@ -608,12 +731,25 @@ LOCALFUNC tMacErr vSonyEject0(tDrive Drive_No, blnr deleteit)
 
 	DiskEjectedNotify(Drive_No);
 
+#if WantFolderVolumes
+	if (nullpr != DriveFolders[Drive_No]) {
+		FldrVol_Dispose(DriveFolders[Drive_No]);
+		DriveFolders[Drive_No] = nullpr;
+		deleteit = falseblnr;
+	} else
+#endif
+	{
+#if MayMapDisks
+		DiskMap_Close(Drive_No);
+#endif
+
 #if HaveAdvisoryLocks
-	MyUnlockFile(refnum);
+		MyUnlockFile(refnum);
 #endif
 
-	fclose(refnum);
-	Drives[Drive_No] = NotAfileRef; /* not really needed */
+		fclose(refnum);
+		Drives[Drive_No] = NotAfileRef; /* not really needed */
+	}
 
 #if IncludeSonyGetName || IncludeSonyNew
 	{
@@ -685,10 +821,20 @@ LOCALFUNC blnr Sony_Insert0(FILE *refnum, blnr locked,
 		/* printf("Sony_Insert0 %d\n", (int)Drive_No); */
 
 #if HaveAdvisoryLocks
-		if (locked || MyLockFile(refnum))
+		if (locked || DisksPrivate || MyLockFile(refnum))
 #endif
 		{
 			Drives[Drive_No] = refnum;
+#if MayMapDisks
+			if (! DiskMap_Open(Drive_No, fileno(refnum), locked,
+				DisksPrivate))
+#endif
+			{
+				if (DisksPrivate) {
+					/* no private copy to write to */
+					locked = trueblnr;
+				}
+			}
 			DiskInsertNotify(Drive_No, locked);
 
 #if IncludeSonyGetName || IncludeSonyNew
@@ -713,14 +859,65 @@ LOCALFUNC blnr Sony_Insert0(FILE *refnum, blnr locked,
 	return IsOk;
 }
 
+#if WantFolderVolumes
+LOCALFUNC blnr Sony_InsertFolder(char *drivepath)
+{
+	tDrive Drive_No;
+	FldrVolR *v;
+
+	if (! FirstFreeDisk(&Drive_No)) {
+		MacMsg(kStrTooManyImagesTitle, kStrTooManyImagesMessage,
+			falseblnr);
+		return falseblnr;
+	}
+	v = FldrVol_Open(drivepath);
+	if (nullpr == v) {
+		return falseblnr;
+	}
+
+	DriveFolders[Drive_No] = v;
+	DiskInsertNotify(Drive_No, trueblnr);
+
+#if IncludeSonyGetName || IncludeSonyNew
+	{
+		ui5b L = strlen(drivepath);
+		char *p = malloc(L + 1);
+		if (p != NULL) {
+			(void) memcpy(p, drivepath, L + 1);
+		}
+		DriveNames[Drive_No] = p;
+	}
+#endif
+
+	return trueblnr;
+}
+#endif
+
 LOCALFUNC blnr Sony_Insert1(char *drivepath, blnr silentfail)
 {
 	blnr locked = falseblnr;
 	/* printf("Sony_Insert1 %s\n", drivepath); */
+#if WantFolderVolumes
+	struct stat st;
+
+	if ((0 == stat(drivepath, &st)) && S_ISDIR(st.st_mode)) {
+		if (Sony_InsertFolder(drivepath)) {
+			return trueblnr;
+		}
+		if (! silentfail) {
+			MacMsg(kStrOpenFailTitle, kStrOpenFailMessage, falseblnr);
+		}
+		return falseblnr;
+	}
+#endif
 	FILE *refnum = fopen(drivepath, "rb+");
 	if (NULL == refnum) {
 		locked = trueblnr;
 		refnum = fopen(drivepath, "rb");
+	} else if (DisksPrivate) {
+		/* writable, but only through a private copy */
+		fclose(refnum);
+		refnum = fopen(drivepath, "rb");
 	}
 	if (NULL == refnum) {
 		if (! silentfail) {
@@ -1143,6 +1340,90 @@ LOCALVAR XImage *my_image = NULL;
 LOCALVAR XImage *my_Scaled_image = NULL;
 #endif
 
+/*
+	Asynchronous video (MayAsyncVideo, needs -lpthread, turned on
+	with the --async-video option).
+
+	Screen_OutputFrame, on the emulation thread, only copies the
+	frame into a triple buffered single producer / single consumer
+	slot and returns. A video thread takes the newest frame, finds
+	the changes against screencomparebuff, and converts and
+	presents them through its own connection to the X server, so
+	the emulation never waits for the display.
+
+	screencomparebuff, the ScreenChanged rectangle and the window
+	are shared with the main thread, which only touches them with
+	VidMutex held: for redraws requested by X events, while a
+	control mode is shown (those are drawn on the main thread),
+	and while the window is recreated. Anything else the video
+	thread needs from the main thread is passed through atomics:
+	the buffer to draw from, resolved by the main thread as of
+	the last frame or kick handed over (none while a control mode
+	is shown, so the video thread never calls GetCurDrawBuff), and
+	back the other way, that the screen has changed enough to end
+	quiet time, for the main thread to call QuietEnds.
+*/
+
+#if MayAsyncVideo
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+#define kVidSlotNew 4
+
+LOCALVAR Display *x_vid_display = NULL;
+LOCALVAR GC my_vid_gc = NULL;
+LOCALVAR pthread_t VidThread;
+LOCALVAR blnr HaveVidThread = falseblnr;
+LOCALVAR pthread_mutex_t VidMutex = PTHREAD_MUTEX_INITIALIZER;
+LOCALVAR sem_t VidSem;
+LOCALVAR atomic_bool VidQuit;
+LOCALVAR ui3p VidSlotBuf[3];
+LOCALVAR int VidSlotBack = 0; /* owned by the emulation thread */
+LOCALVAR int VidSlotFront = 1; /* owned by the video thread */
+LOCALVAR atomic_int VidSlotMiddle = 2; /* index, and kVidSlotNew */
+LOCALVAR _Atomic(ui3p) VidDrawSrc = nullpr;
+#if EnableAutoSlow
+LOCALVAR atomic_bool VidQuietEnded;
+#endif
+
+#define MyDrawDisplay (UseAsyncVideo ? x_vid_display : x_display)
+#define MyDrawGC (UseAsyncVideo ? my_vid_gc : my_gc)
+
+LOCALPROC VidLock(void)
+{
+	if (UseAsyncVideo) {
+		(void) pthread_mutex_lock(&VidMutex);
+	}
+}
+
+LOCALPROC VidUnlock(void)
+{
+	if (UseAsyncVideo) {
+		(void) pthread_mutex_unlock(&VidMutex);
+	}
+}
+
+LOCALPROC VidKick(void)
+{
+	if (HaveVidThread) {
+		atomic_store(&VidDrawSrc,
+			(0 == SpecialModes) ? screencomparebuff : nullpr);
+		(void) sem_post(&VidSem);
+	}
+}
+
+#else
+
+#define MyDrawDisplay x_display
+#define MyDrawGC my_gc
+#define VidLock()
+#define VidUnlock()
+#define VidKick()
+
+#endif /* MayAsyncVideo */
+
 #if EnableMagnify
 #define MaxScale MyWindowScale
 #else
@@ -1184,6 +1465,191 @@ LOCALVAR ui3p ScalingBuff = nullpr;
 #endif /* WantScalingBuff */
 
 
+#ifndef MayUseXShm
+#define MayUseXShm 0
+#endif
+
+/*
+	MIT-SHM: the screen mapping writes into ScalingBuff, so when the
+	X server is local, ScalingBuff is placed in a shared memory
+	segment and the changed rectangle goes out with XShmPutImage
+	instead of being copied through the socket. If the extension
+	is missing, or attaching fails (such as for a remote display),
+	the plain XPutImage path is used.
+
+	The server reads the segment after XShmPutImage returns, so
+	it mustn't be written again until the ShmCompletion event
+	has come back. That is only checked for when the next frame
+	is about to be drawn (XShmWaitDone), by which time the event
+	is normally already there, so there is no round trip.
+
+	Needs UseColorImage, and linking with -lXext.
+*/
+
+#if MayUseXShm && ! UseColorImage
+#error "MayUseXShm needs UseColorImage"
+#endif
+
+#if MayUseXShm
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+
+LOCALVAR blnr HaveXShm = falseblnr;
+LOCALVAR XShmSegmentInfo my_shminfo;
+LOCALVAR XImage *my_shm_image = NULL;
+#if EnableMagnify
+LOCALVAR XImage *my_shm_Scaled_image = NULL;
+#endif
+LOCALVAR ui3p ScalingBuffNoShm = nullpr;
+LOCALVAR blnr XShmAttachFailed;
+LOCALVAR int XShmCompletionType;
+LOCALVAR blnr XShmPending = falseblnr;
+
+LOCALFUNC Bool IsXShmCompletion(Display *dpy, XEvent *e, XPointer arg)
+{
+	UnusedParam(dpy);
+	UnusedParam(arg);
+	return XShmCompletionType == e->type;
+}
+
+LOCALPROC XShmWaitDone(void)
+{
+	XEvent e;
+
+	if (XShmPending) {
+		if (! XCheckIfEvent(MyDrawDisplay, &e, IsXShmCompletion, NULL))
+		{
+			/*
+				not back yet, or never coming (window gone,
+				or taken by the event loop): once synced, the
+				server is done with the segment either way
+			*/
+			XSync(MyDrawDisplay, False);
+			(void) XCheckIfEvent(MyDrawDisplay, &e, IsXShmCompletion,
+				NULL);
+		}
+		XShmPending = falseblnr;
+	}
+}
+
+LOCALFUNC int XShmAttachErrorHandler(Display *dpy, XErrorEvent *e)
+{
+	UnusedParam(dpy);
+	UnusedParam(e);
+	XShmAttachFailed = trueblnr;
+	return 0;
+}
+
+LOCALFUNC XImage *XShmCreateMyImage(Visual *Xvisual, int scale)
+{
+	XImage *image = XShmCreateImage(MyDrawDisplay, Xvisual, 24, ZPixmap,
+		my_shminfo.shmaddr, &my_shminfo,
+		vMacScreenWidth * scale, vMacScreenHeight * scale);
+
+	if (NULL != image) {
+		if ((32 != image->bits_per_pixel)
+			|| (4 * (ui5r)vMacScreenWidth * scale
+				!= image->bytes_per_line))
+		{
+			/* not the layout the screen mapping writes */
+			image->data = NULL;
+			XDestroyImage(image);
+			image = NULL;
+		}
+	}
+
+	return image;
+}
+
+LOCALPROC UnInitXShm(void)
+{
+	if (HaveXShm) {
+		XShmDetach(MyDrawDisplay, &my_shminfo);
+		XSync(MyDrawDisplay, False);
+		XShmPending = falseblnr;
+		HaveXShm = falseblnr;
+		ScalingBuff = ScalingBuffNoShm;
+	}
+	if (NULL != my_shm_image) {
+		my_shm_image->data = NULL;
+		XDestroyImage(my_shm_image);
+		my_shm_image = NULL;
+	}
+#if EnableMagnify
+	if (NULL != my_shm_Scaled_image) {
+		my_shm_Scaled_image->data = NULL;
+		XDestroyImage(my_shm_Scaled_image);
+		my_shm_Scaled_image = NULL;
+	}
+#endif
+	if (NULL != my_shminfo.shmaddr) {
+		(void) shmdt(my_shminfo.shmaddr);
+		my_shminfo.shmaddr = NULL;
+	}
+}
+
+LOCALPROC InitXShm(Visual *Xvisual)
+{
+	int (*SavedHandler)(Display *, XErrorEvent *);
+	void *addr;
+
+	my_shminfo.shmaddr = NULL;
+	if (! XShmQueryExtension(MyDrawDisplay)) {
+		return;
+	}
+
+	my_shminfo.shmid = shmget(IPC_PRIVATE, ScalingBuffsz,
+		IPC_CREAT | 0600);
+	if (my_shminfo.shmid < 0) {
+		return;
+	}
+	addr = shmat(my_shminfo.shmid, NULL, 0);
+	if ((void *)-1 == addr) {
+		(void) shmctl(my_shminfo.shmid, IPC_RMID, NULL);
+		return;
+	}
+	my_shminfo.shmaddr = (char *)addr;
+	my_shminfo.readOnly = False;
+
+	XShmAttachFailed = falseblnr;
+	SavedHandler = XSetErrorHandler(XShmAttachErrorHandler);
+	(void) XShmAttach(MyDrawDisplay, &my_shminfo);
+	XSync(MyDrawDisplay, False);
+	(void) XSetErrorHandler(SavedHandler);
+
+	/* segment goes away once both sides have detached */
+	(void) shmctl(my_shminfo.shmid, IPC_RMID, NULL);
+
+	if (XShmAttachFailed) {
+		UnInitXShm();
+		return;
+	}
+	HaveXShm = trueblnr;
+	XShmCompletionType = XShmGetEventBase(MyDrawDisplay) + ShmCompletion;
+
+	my_shm_image = XShmCreateMyImage(Xvisual, 1);
+#if EnableMagnify
+	my_shm_Scaled_image = XShmCreateMyImage(Xvisual, MyWindowScale);
+#endif
+	if ((NULL == my_shm_image)
+#if EnableMagnify
+		|| (NULL == my_shm_Scaled_image)
+#endif
+		)
+	{
+		UnInitXShm();
+		return;
+	}
+
+	ScalingBuffNoShm = ScalingBuff;
+	ScalingBuff = (ui3p)my_shminfo.shmaddr;
+}
+
+#endif /* MayUseXShm */
+
+
 #if EnableMagnify && ! UseColorImage
 LOCALPROC SetUpScalingTabl(void)
 {
@@ -1308,10 +1774,13 @@ LOCALPROC SetUpBW2ColorTabl(void)
 #endif
 
 
+/* source of the conversions below, set by HaveChangedScreenBuff */
+LOCALVAR ui3p MyDrawSrc = nullpr;
+
 #if EnableMagnify && ! UseColorImage
 
 #define ScrnMapr_DoMap UpdateScaledBWCopy
-#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Src MyDrawSrc
 #define ScrnMapr_Dst ScalingBuff
 #define ScrnMapr_SrcDepth 0
 #define ScrnMapr_DstDepth 0
@@ -1326,7 +1795,7 @@ LOCALPROC SetUpBW2ColorTabl(void)
 #if (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
 
 #define ScrnMapr_DoMap UpdateMappedColorCopy
-#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Src MyDrawSrc
 #define ScrnMapr_Dst ScalingBuff
 #define ScrnMapr_SrcDepth vMacScreenDepth
 #define ScrnMapr_DstDepth 5
@@ -1340,7 +1809,7 @@ LOCALPROC SetUpBW2ColorTabl(void)
 #if EnableMagnify && (0 != vMacScreenDepth) && (vMacScreenDepth < 4)
 
 #define ScrnMapr_DoMap UpdateMappedScaledColorCopy
-#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Src MyDrawSrc
 #define ScrnMapr_Dst ScalingBuff
 #define ScrnMapr_SrcDepth vMacScreenDepth
 #define ScrnMapr_DstDepth 5
@@ -1355,7 +1824,7 @@ LOCALPROC SetUpBW2ColorTabl(void)
 #if vMacScreenDepth >= 4
 
 #define ScrnTrns_DoTrans UpdateTransColorCopy
-#define ScrnTrns_Src GetCurDrawBuff()
+#define ScrnTrns_Src MyDrawSrc
 #define ScrnTrns_Dst ScalingBuff
 #define ScrnTrns_SrcDepth vMacScreenDepth
 #define ScrnTrns_DstDepth 5
@@ -1367,7 +1836,7 @@ LOCALPROC SetUpBW2ColorTabl(void)
 #if EnableMagnify && (vMacScreenDepth >= 4)
 
 #define ScrnTrns_DoTrans UpdateTransScaledColorCopy
-#define ScrnTrns_Src GetCurDrawBuff()
+#define ScrnTrns_Src MyDrawSrc
 #define ScrnTrns_Dst ScalingBuff
 #define ScrnTrns_SrcDepth vMacScreenDepth
 #define ScrnTrns_DstDepth 5
@@ -1381,7 +1850,7 @@ LOCALPROC SetUpBW2ColorTabl(void)
 #if EnableMagnify && UseColorImage
 
 #define ScrnMapr_DoMap UpdateMappedScaledBW2ColorCopy
-#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Src MyDrawSrc
 #define ScrnMapr_Dst ScalingBuff
 #define ScrnMapr_SrcDepth 0
 #define ScrnMapr_DstDepth 5
@@ -1396,7 +1865,7 @@ LOCALPROC SetUpBW2ColorTabl(void)
 #if UseColorImage
 
 #define ScrnMapr_DoMap UpdateMappedBW2ColorCopy
-#define ScrnMapr_Src GetCurDrawBuff()
+#define ScrnMapr_Src MyDrawSrc
 #define ScrnMapr_Dst ScalingBuff
 #define ScrnMapr_SrcDepth 0
 #define ScrnMapr_DstDepth 5
@@ -1407,13 +1876,15 @@ LOCALPROC SetUpBW2ColorTabl(void)
 #endif
 
 
-LOCALPROC HaveChangedScreenBuff(ui4r top, ui4r left,
+LOCALPROC HaveChangedScreenBuff(ui3p src, ui4r top, ui4r left,
 	ui4r bottom, ui4r right)
 {
 	int XDest;
 	int YDest;
 	char *the_data;
 
+	MyDrawSrc = src;
+
 #if VarFullScreen
 	if (UseFullScreen)
 #endif
@@ -1468,6 +1939,11 @@ LOCALPROC HaveChangedScreenBuff(ui4r top, ui4r left,
 	}
 #endif
 
+#if MayUseXShm
+	/* before writing to ScalingBuff */
+	XShmWaitDone();
+#endif
+
 #if EnableMagnify
 	if (UseMagnify) {
 #if UseColorImage
@@ -1505,11 +1981,24 @@ LOCALPROC HaveChangedScreenBuff(ui4r top, ui4r left,
 		}
 #endif /* UseColorImage */
 
+#if MayUseXShm
+		if (HaveXShm) {
+			XShmPutImage(MyDrawDisplay, my_main_wind, MyDrawGC,
+				my_shm_Scaled_image,
+				left * MyWindowScale, top * MyWindowScale,
+				XDest, YDest,
+				(right - left) * MyWindowScale,
+				(bottom - top) * MyWindowScale,
+				True);
+			XShmPending = trueblnr;
+		} else
+#endif
 		{
 			char *saveData = my_Scaled_image->data;
 			my_Scaled_image->data = (char *)ScalingBuff;
 
-			XPutImage(x_display, my_main_wind, my_gc, my_Scaled_image,
+			XPutImage(MyDrawDisplay, my_main_wind, MyDrawGC,
+				my_Scaled_image,
 				left * MyWindowScale, top * MyWindowScale,
 				XDest, YDest,
 				(right - left) * MyWindowScale,
@@ -1536,7 +2025,7 @@ LOCALPROC HaveChangedScreenBuff(ui4r top, ui4r left,
 #else
 			/*
 				if vMacScreenDepth == 5 and MSBFirst, could
-				copy directly with the_data = (char *)GetCurDrawBuff();
+				copy directly with the_data = (char *)src;
 			*/
 			UpdateTransColorCopy(top, left, bottom, right);
 
@@ -1556,15 +2045,25 @@ LOCALPROC HaveChangedScreenBuff(ui4r top, ui4r left,
 		}
 #else /* ! UseColorImage */
 		{
-			the_data = (char *)GetCurDrawBuff();
+			the_data = (char *)src;
 		}
 #endif /* UseColorImage */
 
+#if MayUseXShm
+		if (HaveXShm) {
+			XShmPutImage(MyDrawDisplay, my_main_wind, MyDrawGC,
+				my_shm_image,
+				left, top, XDest, YDest,
+				right - left, bottom - top,
+				True);
+			XShmPending = trueblnr;
+		} else
+#endif
 		{
 			char *saveData = my_image->data;
 			my_image->data = the_data;
 
-			XPutImage(x_display, my_main_wind, my_gc, my_image,
+			XPutImage(MyDrawDisplay, my_main_wind, MyDrawGC, my_image,
 				left, top, XDest, YDest,
 				right - left, bottom - top);
 
@@ -1578,15 +2077,157 @@ label_exit:
 #endif
 }
 
-LOCALPROC MyDrawChangesAndClear(void)
+/*
+	src is nullpr on the main thread, to resolve it with
+	GetCurDrawBuff only when there is something to draw.
+*/
+LOCALPROC MyDrawChangesAndClear(ui3p src)
 {
 	if (ScreenChangedBottom > ScreenChangedTop) {
-		HaveChangedScreenBuff(ScreenChangedTop, ScreenChangedLeft,
+		if (nullpr == src) {
+			src = GetCurDrawBuff();
+		}
+		HaveChangedScreenBuff(src,
+			ScreenChangedTop, ScreenChangedLeft,
 			ScreenChangedBottom, ScreenChangedRight);
 		ScreenClearChanges();
 	}
 }
 
+#if MayAsyncVideo
+
+LOCALPROC AsyncVideo_Publish(ui3p screencurrentbuff)
+{
+	int old;
+
+#if EnableAutoSlow
+	if (atomic_exchange(&VidQuietEnded, falseblnr)) {
+		QuietEnds();
+	}
+#endif
+	atomic_store(&VidDrawSrc,
+		(0 == SpecialModes) ? screencomparebuff : nullpr);
+	MyMoveBytes((anyp)screencurrentbuff, (anyp)VidSlotBuf[VidSlotBack],
+#if 0 != vMacScreenDepth
+		UseColorMode ? vMacScreenNumBytes :
+#endif
+			vMacScreenMonoNumBytes);
+	old = atomic_exchange(&VidSlotMiddle, VidSlotBack | kVidSlotNew);
+	VidSlotBack = old & 3;
+	if (0 == (old & kVidSlotNew)) {
+		/* else the video thread hasn't taken the last one yet */
+		(void) sem_post(&VidSem);
+	}
+}
+
+LOCALPROC AsyncVideo_Draw(void)
+{
+	ui3p src;
+	si4b top;
+	si4b left;
+	si4b bottom;
+	si4b right;
+
+	if (0 != (atomic_load(&VidSlotMiddle) & kVidSlotNew)) {
+		VidSlotFront = atomic_exchange(&VidSlotMiddle, VidSlotFront) & 3;
+		if (ScreenFindChanges(VidSlotBuf[VidSlotFront], 0,
+			&top, &left, &bottom, &right))
+		{
+			if (top < ScreenChangedTop) {
+				ScreenChangedTop = top;
+			}
+			if (bottom > ScreenChangedBottom) {
+				ScreenChangedBottom = bottom;
+			}
+			if (left < ScreenChangedLeft) {
+				ScreenChangedLeft = left;
+			}
+			if (right > ScreenChangedRight) {
+				ScreenChangedRight = right;
+			}
+#if EnableAutoSlow
+			if (((right - left) > 1) || ((bottom - top) > 32)) {
+				atomic_store(&VidQuietEnded, trueblnr);
+			}
+#endif
+		}
+	}
+
+	src = atomic_load(&VidDrawSrc);
+	if (nullpr != src) {
+		/* else drawn by the main thread */
+		MyDrawChangesAndClear(src);
+		XSync(x_vid_display, False);
+	}
+}
+
+LOCALFUNC void *AsyncVideo_Thread(void *arg)
+{
+	UnusedParam(arg);
+
+	while (! atomic_load(&VidQuit)) {
+		(void) sem_wait(&VidSem);
+		(void) pthread_mutex_lock(&VidMutex);
+		AsyncVideo_Draw();
+		(void) pthread_mutex_unlock(&VidMutex);
+	}
+
+	return NULL;
+}
+
+LOCALFUNC blnr AsyncVideo_Start(void)
+{
+	if (UseAsyncVideo) {
+		int screen = DefaultScreen(x_vid_display);
+
+		my_vid_gc = XCreateGC(x_vid_display,
+			XRootWindow(x_vid_display, screen), 0, NULL);
+		if (NULL == my_vid_gc) {
+			WriteExtraErr("XCreateGC failed.");
+			return falseblnr;
+		}
+		XSetState(x_vid_display, my_vid_gc, x_black.pixel, x_white.pixel,
+			GXcopy, AllPlanes);
+
+		atomic_store(&VidQuit, falseblnr);
+		if ((0 != sem_init(&VidSem, 0, 0))
+			|| (0 != pthread_create(&VidThread, NULL,
+				AsyncVideo_Thread, NULL)))
+		{
+			WriteExtraErr("Could not start video thread.");
+			return falseblnr;
+		}
+		HaveVidThread = trueblnr;
+	}
+
+	return trueblnr;
+}
+
+LOCALPROC AsyncVideo_Stop(void)
+{
+	if (HaveVidThread) {
+		atomic_store(&VidQuit, trueblnr);
+		(void) sem_post(&VidSem);
+		(void) pthread_join(VidThread, NULL);
+		(void) sem_destroy(&VidSem);
+		HaveVidThread = falseblnr;
+	}
+}
+
+LOCALPROC AsyncVideo_Close(void)
+{
+	if (NULL != x_vid_display) {
+		if (NULL != my_vid_gc) {
+			XFreeGC(x_vid_display, my_vid_gc);
+			my_vid_gc = NULL;
+		}
+		XCloseDisplay(x_vid_display);
+		x_vid_display = NULL;
+	}
+}
+
+#endif /* MayAsyncVideo */
+
 /* --- mouse --- */
 
 /* cursor hiding */
@@ -4042,7 +4683,15 @@ LOCALPROC HandleTheEvent(XEvent *theEvent)
 					y1 = vMacScreenHeight;
 				}
 				if ((x0 < x1) && (y0 < y1)) {
-					HaveChangedScreenBuff(y0, x0, y1, x1);
+					VidLock();
+					HaveChangedScreenBuff(GetCurDrawBuff(),
+						y0, x0, y1, x1);
+#if MayAsyncVideo
+					if (UseAsyncVideo) {
+						XFlush(x_vid_display);
+					}
+#endif
+					VidUnlock();
 				}
 
 				NeedFinishOpen1 = falseblnr;
@@ -4214,6 +4863,12 @@ LOCALPROC HandleTheEvent(XEvent *theEvent)
 			}
 			break;
 		default:
+#if MayUseXShm
+			if (HaveXShm && (XShmCompletionType == theEvent->type)) {
+				/* see XShmWaitDone */
+				XShmPending = falseblnr;
+			}
+#endif
 			break;
 	}
 }
@@ -4237,6 +4892,15 @@ LOCALFUNC blnr Screen_Init(void)
 		fprintf(stderr, "Cannot connect to X server.\n");
 		return falseblnr;
 	}
+#if MayAsyncVideo
+	if (UseAsyncVideo) {
+		x_vid_display = XOpenDisplay(display_name);
+		if (NULL == x_vid_display) {
+			fprintf(stderr, "Cannot connect to X server for video.\n");
+			UseAsyncVideo = falseblnr;
+		}
+	}
+#endif
 
 	screen = DefaultScreen(x_display);
 
@@ -4349,6 +5013,10 @@ LOCALFUNC blnr Screen_Init(void)
 	ColorModeWorks = trueblnr;
 #endif
 
+#if MayUseXShm
+	InitXShm(Xvisual);
+#endif
+
 	DisableKeyRepeat();
 
 	return trueblnr;
@@ -4771,7 +5439,7 @@ LOCALVAR ui4b RestoreMouseV;
 #endif
 
 #if EnableRecreateW
-LOCALFUNC blnr ReCreateMainWindow(void)
+LOCALFUNC blnr ReCreateMainWindow0(void)
 {
 	MyWState old_state;
 	MyWState new_state;
@@ -4896,6 +5564,17 @@ LOCALFUNC blnr ReCreateMainWindow(void)
 
 	return trueblnr;
 }
+
+LOCALFUNC blnr ReCreateMainWindow(void)
+{
+	blnr v;
+
+	VidLock();
+	v = ReCreateMainWindow0();
+	VidUnlock();
+
+	return v;
+}
 #endif
 
 #if VarFullScreen && EnableMagnify
@@ -5207,7 +5886,10 @@ LOCALPROC CheckForSavedTasks(void)
 
 	if (NeedWholeScreenDraw) {
 		NeedWholeScreenDraw = falseblnr;
+		VidLock();
 		ScreenChangedAll();
+		VidUnlock();
+		VidKick();
 	}
 
 #if NeedRequestIthDisk
@@ -5231,6 +5913,11 @@ LOCALPROC CheckForSavedTasks(void)
 
 /* --- command line parsing --- */
 
+#if MayMapRAM && WantSaveStates
+LOCALVAR char *snap_load_path = NULL;
+LOCALVAR char *snap_save_path = NULL;
+#endif
+
 LOCALFUNC blnr ScanCommandLine(void)
 {
 	char *pa;
@@ -5270,6 +5957,23 @@ label_retry:
 					goto label_retry;
 				}
 			} else
+#if MayMapRAM && WantSaveStates
+			if (0 == strcmp(pa, "--snapshot"))
+			{
+				if (i < my_argc) {
+					snap_load_path = my_argv[i++];
+					DisksPrivate = trueblnr;
+					goto label_retry;
+				}
+			} else
+			if (0 == strcmp(pa, "--save-snapshot"))
+			{
+				if (i < my_argc) {
+					snap_save_path = my_argv[i++];
+					goto label_retry;
+				}
+			} else
+#endif
 #ifndef UsingAlsa
 #define UsingAlsa 0
 #endif
@@ -5284,6 +5988,12 @@ label_retry:
 				}
 			} else
 #endif
+#if MayAsyncVideo
+			if (0 == strcmp(pa, "--async-video")) {
+				UseAsyncVideo = trueblnr;
+				goto label_retry;
+			} else
+#endif
 #if 0
 			if (0 == strcmp(pa, "-l")) {
 				SpeedValue = 0;
@@ -5311,7 +6021,19 @@ GLOBALOSGLUPROC DoneWithDrawingForTick(void)
 		AutoScrollScreen();
 	}
 #endif
-	MyDrawChangesAndClear();
+#if MayAsyncVideo
+	if (UseAsyncVideo) {
+		if (0 != SpecialModes) {
+			VidLock();
+			MyDrawChangesAndClear(nullpr);
+			XSync(x_vid_display, False);
+			VidUnlock();
+		}
+	} else
+#endif
+	{
+		MyDrawChangesAndClear(nullpr);
+	}
 	XFlush(x_display);
 }
 
@@ -5340,8 +6062,23 @@ LOCALPROC CheckForSystemEvents(void)
 	}
 }
 
+#if MayMapRAM && WantSaveStates
+FORWARDFUNC blnr RAMSnap_Load(char *path);
+#endif
+
 GLOBALOSGLUPROC WaitForNextTick(void)
 {
+#if MayMapRAM && WantSaveStates
+	if (NULL != snap_load_path) {
+		/* before the first tick */
+		if (! RAMSnap_Load(snap_load_path)) {
+			fprintf(stderr, "%s: not a snapshot of this machine,"
+				" booting instead\n", snap_load_path);
+		}
+		snap_load_path = NULL;
+	}
+#endif
+
 label_retry:
 	CheckForSystemEvents();
 	CheckForSavedTasks();
@@ -5397,6 +6134,33 @@ label_retry:
 
 #include "PROGMAIN.h"
 
+#if MayMapRAM
+#include "RAMMMAP.h"
+#endif
+
+#if MayMapRAM && WantSaveStates
+LOCALFUNC ui5r RAMSnap_DriveMTime(tDrive i)
+{
+	struct stat st;
+
+#if WantFolderVolumes
+	if (nullpr != DriveFolders[i]) {
+		return 0; /* made when read */
+	}
+#endif
+#if MayMapDisks
+	if (nullpr != DriveMaps[i]) {
+		(void) msync(DriveMaps[i], DriveMapSizes[i], MS_SYNC);
+	}
+#endif
+	(void) fflush(Drives[i]);
+	if (0 != fstat(fileno(Drives[i]), &st)) {
+		return (ui5r) -1; /* never matches */
+	}
+	return (ui5r)st.st_mtime;
+}
+#endif
+
 LOCALPROC ZapOSGLUVars(void)
 {
 	InitDrives();
@@ -5405,6 +6169,9 @@ LOCALPROC ZapOSGLUVars(void)
 
 LOCALPROC ReserveAllocAll(void)
 {
+#if MayMapRAM
+	EmulationReserveAlloc(); /* RAM first, page aligned */
+#endif
 #if dbglog_HAVE
 	dbglog_ReserveAlloc();
 #endif
@@ -5420,6 +6187,11 @@ LOCALPROC ReserveAllocAll(void)
 	ReserveAllocOneBlock(&ScalingBuff,
 		ScalingBuffsz, 5, falseblnr);
 #endif
+#if MayAsyncVideo
+	ReserveAllocOneBlock(&VidSlotBuf[0], vMacScreenNumBytes, 5, falseblnr);
+	ReserveAllocOneBlock(&VidSlotBuf[1], vMacScreenNumBytes, 5, falseblnr);
+	ReserveAllocOneBlock(&VidSlotBuf[2], vMacScreenNumBytes, 5, falseblnr);
+#endif
 #if WantScalingTabl
 	ReserveAllocOneBlock(&ScalingTabl,
 		ScalingTablsz, 5, falseblnr);
@@ -5430,7 +6202,9 @@ LOCALPROC ReserveAllocAll(void)
 		dbhBufferSize, 5, falseblnr);
 #endif
 
+#if ! MayMapRAM
 	EmulationReserveAlloc();
+#endif
 }
 
 LOCALFUNC blnr AllocMyMemory(void)
@@ -5442,7 +6216,11 @@ LOCALFUNC blnr AllocMyMemory(void)
 	ReserveAllocBigBlock = nullpr;
 	ReserveAllocAll();
 	n = ReserveAllocOffset;
+#if MayMapRAM
+	ReserveAllocBigBlock = RAMMap_AllocBlock(n);
+#else
 	ReserveAllocBigBlock = (ui3p)calloc(1, n);
+#endif
 	if (NULL == ReserveAllocBigBlock) {
 		MacMsg(kStrOutOfMemTitle, kStrOutOfMemMessage, trueblnr);
 	} else {
@@ -5461,7 +6239,11 @@ LOCALFUNC blnr AllocMyMemory(void)
 LOCALPROC UnallocMyMemory(void)
 {
 	if (nullpr != ReserveAllocBigBlock) {
+#if MayMapRAM
+		RAMMap_FreeBlock(ReserveAllocBigBlock);
+#else
 		free((char *)ReserveAllocBigBlock);
+#endif
 	}
 }
 
@@ -5666,6 +6448,9 @@ LOCALFUNC blnr InitOSGLU(void)
 #endif
 	if (Screen_Init())
 	if (CreateMainWindow())
+#if MayAsyncVideo
+	if (AsyncVideo_Start())
+#endif
 	if (KC2MKCInit())
 #if EmLocalTalk
 	if (EntropyGather())
@@ -5711,6 +6496,12 @@ LOCALPROC UnInitOSGLU(void)
 		XFreeCursor(x_display, blankCursor);
 	}
 
+#if MayAsyncVideo
+	AsyncVideo_Stop();
+#endif
+#if MayUseXShm
+	UnInitXShm();
+#endif
 	if (my_image != NULL) {
 		XDestroyImage(my_image);
 	}
@@ -5721,6 +6512,9 @@ LOCALPROC UnInitOSGLU(void)
 #endif
 
 	CloseMainWindow();
+#if MayAsyncVideo
+	AsyncVideo_Close();
+#endif
 	if (x_display != NULL) {
 		XCloseDisplay(x_display);
 	}
@@ -5745,6 +6539,17 @@ int main(int argc, char **argv)
 	ZapOSGLUVars();
 	if (InitOSGLU()) {
 		ProgramMain();
+#if MayMapRAM && WantSaveStates
+		if (NULL == snap_save_path) {
+			/* nothing to save */
+		} else if (DisksPrivate) {
+			fprintf(stderr, "%s: not saved, disk changes after"
+				" --snapshot are not kept\n", snap_save_path);
+		} else if (! RAMSnap_Save(snap_save_path)) {
+			fprintf(stderr, "%s: could not save snapshot\n",
+				snap_save_path);
+		}
+#endif
 	}
 	UnInitOSGLU();
 
@@ -131,21 +131,21 @@ LOCALPROC SubTickTaskDo(void)
 {
 	SubTickNotify(SubTickCounter);
 	++SubTickCounter;
-	if (SubTickCounter < (kNumSubTicks - 1)) {
+	if (SubTickCounter >= (kNumSubTicks - 1)) {
 		/*
 			final SubTick handled by SubTickTaskEnd,
 			since CyclesScaledPerSubTick * kNumSubTicks
 			might not equal CyclesScaledPerTick.
 		*/
 
-		ICT_add(kICT_SubTick, CyclesScaledPerSubTick);
+		ICT_Cancel(kICT_SubTick);
 	}
 }
 
 LOCALPROC SubTickTaskStart(void)
 {
 	SubTickCounter = 0;
-	ICT_add(kICT_SubTick, CyclesScaledPerSubTick);
+	ICT_addPeriodic(kICT_SubTick, CyclesScaledPerSubTick);
 }
 
 LOCALPROC SubTickTaskEnd(void)
@@ -183,11 +183,18 @@ LOCALPROC SixtiethSecondNotify(void)
 	SubTickTaskStart();
 }
 
+#if WantRewind
+FORWARDPROC Rewind_Tick(void);
+#endif
+
 LOCALPROC SixtiethEndNotify(void)
 {
 	SubTickTaskEnd();
 	Mouse_EndTickNotify();
 	Screen_EndTickNotify();
+#if WantRewind
+	Rewind_Tick();
+#endif
 #if dbglog_HAVE && 0
 	dbglog_WriteNote("end Sixtieth");
 #endif
@@ -221,6 +228,57 @@ LOCALPROC ExtraTimeEndNotify(void)
 #endif
 }
 
+#if WantVarRAMSize
+
+#if (CurEmMd < kEmMd_Plus) || (CurEmMd > kEmMd_Classic)
+#error "WantVarRAMSize not supported for this model"
+#endif
+
+/*
+	The SIMM layouts of the Plus, SE and Classic. Must be called
+	before EmulationReserveAlloc, returns false (and leaves the
+	size alone) if n bytes isn't one of them.
+*/
+GLOBALFUNC blnr EmulationSetRAMSize(ui5r n)
+{
+	switch (n) {
+		case 0x00080000:
+			RAMa_Size = 0x00080000;
+			RAMb_Size = 0;
+			break;
+		case 0x00100000:
+			RAMa_Size = 0x00080000;
+			RAMb_Size = 0x00080000;
+			break;
+		case 0x00200000:
+			RAMa_Size = 0x00200000;
+			RAMb_Size = 0;
+			break;
+		case 0x00280000:
+			RAMa_Size = 0x00200000;
+			RAMb_Size = 0x00080000;
+			break;
+		case 0x00400000:
+			RAMa_Size = 0x00200000;
+			RAMb_Size = 0x00200000;
+			break;
+		default:
+			return falseblnr;
+	}
+
+	return trueblnr;
+}
+#endif
+
+GLOBALFUNC ui5r EmulationRAMSize(void)
+{
+	return kRAM_Size;
+}
+
+#if WantRewind
+FORWARDPROC Rewind_ReserveAlloc(void);
+#endif
+
 GLOBALPROC EmulationReserveAlloc(void)
 {
 	ReserveAllocOneBlock(&RAM,
@@ -232,134 +290,59 @@ GLOBALPROC EmulationReserveAlloc(void)
 	ReserveAllocOneBlock(&VidMem,
 		kVidMemRAM_Size + RAMSafetyMarginFudge, 5, trueblnr);
 #endif
-#if SmallGlobals
-	MINEM68K_ReserveAlloc();
+#if WantRAMDirtyMap
+	ReserveAllocOneBlock(&RAMDirtyMap, kRAMDirtyMapSize, 5, falseblnr);
 #endif
-}
-
-GLOBALFUNC blnr InitEmulation(void)
-{
-#if EmRTC
-	if (RTC_Init())
+#if WantRewind
+	Rewind_ReserveAlloc();
 #endif
-	if (ROM_Init())
-#if EmVidCard
-	if (Vid_Init())
+#if SmallGlobals && ! WantMachinePerThread
+	MINEM68K_ReserveAlloc();
 #endif
-	if (AddrSpac_Init())
-	{
-		EmulatedHardwareZap();
-		return trueblnr;
-	}
-	return falseblnr;
 }
 
-LOCALPROC ICT_DoTask(int taskid)
+LOCALPROC ICT_SetProcs(void)
 {
-	switch (taskid) {
-		case kICT_SubTick:
-			SubTickTaskDo();
-			break;
+	ICT_SetProc(kICT_SubTick, SubTickTaskDo);
 #if EmClassicKbrd
-		case kICT_Kybd_ReceiveEndCommand:
-			DoKybd_ReceiveEndCommand();
-			break;
-		case kICT_Kybd_ReceiveCommand:
-			DoKybd_ReceiveCommand();
-			break;
+	ICT_SetProc(kICT_Kybd_ReceiveEndCommand, DoKybd_ReceiveEndCommand);
+	ICT_SetProc(kICT_Kybd_ReceiveCommand, DoKybd_ReceiveCommand);
 #endif
 #if EmADB
-		case kICT_ADB_NewState:
-			ADB_DoNewState();
-			break;
+	ICT_SetProc(kICT_ADB_NewState, ADB_DoNewState);
 #endif
 #if EmPMU
-		case kICT_PMU_Task:
-			PMU_DoTask();
-			break;
+	ICT_SetProc(kICT_PMU_Task, PMU_DoTask);
 #endif
 #if EmVIA1
-		case kICT_VIA1_Timer1Check:
-			VIA1_DoTimer1Check();
-			break;
-		case kICT_VIA1_Timer2Check:
-			VIA1_DoTimer2Check();
-			break;
+	ICT_SetProc(kICT_VIA1_Timer1Check, VIA1_DoTimer1Check);
+	ICT_SetProc(kICT_VIA1_Timer2Check, VIA1_DoTimer2Check);
 #endif
 #if EmVIA2
-		case kICT_VIA2_Timer1Check:
-			VIA2_DoTimer1Check();
-			break;
-		case kICT_VIA2_Timer2Check:
-			VIA2_DoTimer2Check();
-			break;
+	ICT_SetProc(kICT_VIA2_Timer1Check, VIA2_DoTimer1Check);
+	ICT_SetProc(kICT_VIA2_Timer2Check, VIA2_DoTimer2Check);
+#endif
+#if Sony_AsyncIO
+	ICT_SetProc(kICT_Sony_Async, Sony_AsyncTask);
 #endif
-		default:
-			ReportAbnormalID(0x1001, "unknown taskid in ICT_DoTask");
-			break;
-	}
-}
-
-LOCALPROC ICT_DoCurrentTasks(void)
-{
-	int i = 0;
-	uimr m = ICTactive;
-
-	while (0 != m) {
-		if (0 != (m & 1)) {
-			if (i >= kNumICTs) {
-				/* shouldn't happen */
-				ICTactive &= ((1 << kNumICTs) - 1);
-				m = 0;
-			} else if (ICTwhen[i] == NextiCount) {
-				ICTactive &= ~ (1 << i);
-#ifdef _VIA_Debug
-				fprintf(stderr, "doing task %d, %d\n", NextiCount, i);
-#endif
-				ICT_DoTask(i);
-
-				/*
-					A Task may set the time of
-					any task, including itself.
-					But it cannot set any task
-					to execute immediately, so
-					one pass is sufficient.
-				*/
-			}
-		}
-		++i;
-		m >>= 1;
-	}
 }
 
-LOCALFUNC ui5b ICT_DoGetNext(ui5b maxn)
+GLOBALFUNC blnr InitEmulation(void)
 {
-	int i = 0;
-	uimr m = ICTactive;
-	ui5b v = maxn;
-
-	while (0 != m) {
-		if (0 != (m & 1)) {
-			if (i >= kNumICTs) {
-				/* shouldn't happen */
-				m = 0;
-			} else {
-				ui5b d = ICTwhen[i] - NextiCount;
-				/* at this point d must be > 0 */
-				if (d < v) {
-#ifdef _VIA_Debug
-					fprintf(stderr, "coming task %d, %d, %d\n",
-						NextiCount, i, d);
-#endif
-					v = d;
-				}
-			}
-		}
-		++i;
-		m >>= 1;
+	ICT_SetProcs();
+#if EmRTC
+	if (RTC_Init())
+#endif
+	if (ROM_Init())
+#if EmVidCard
+	if (Vid_Init())
+#endif
+	if (AddrSpac_Init())
+	{
+		EmulatedHardwareZap();
+		return trueblnr;
 	}
-
-	return v;
+	return falseblnr;
 }
 
 LOCALPROC m68k_go_nCycles_1(ui5b n)
@@ -543,6 +526,74 @@ GLOBALPROC RunEmulatedTicksToTrueTime(void)
 	}
 }
 
+#if WantSaveStates
+
+#if EmVIA2 || EmADB || EmPMU || EmASC || EmVidCard
+#error "save states not supported for this model"
+#endif
+
+/*
+	The whole emulated machine apart from RAM (EmulationRAMSize
+	bytes at RAM) and the disk images, which the caller saves
+	separately. Only between two calls of DoEmulateOneTick.
+*/
+LOCALPROC EmulationStateIO(void)
+{
+	Glue_StateIO();
+	m68k_StateIO(); /* after the memory map is restored */
+#if EmVIA1
+	VIA1_StateIO();
+#endif
+	IWM_StateIO();
+	SCC_StateIO();
+#if EmRTC
+	RTC_StateIO();
+#endif
+	SCSI_StateIO();
+	Sony_StateIO();
+#if EmClassicKbrd
+	Kybd_StateIO();
+#endif
+	StateIO_Var(SubTickCounter);
+	StateIO_Var(ExtraSubTicksToDo);
+}
+
+GLOBALFUNC ui5r EmulationStateSize(void)
+{
+	StateIO_Begin(nullpr, 0, falseblnr);
+	EmulationStateIO();
+	return StateIO_End();
+}
+
+GLOBALPROC EmulationStateSave(ui3p p)
+{
+	StateIO_Begin(p, EmulationStateSize(), falseblnr);
+	EmulationStateIO();
+	(void) StateIO_End();
+}
+
+GLOBALFUNC blnr EmulationStateLoad(ui3p p, ui5r n)
+{
+	if (n != EmulationStateSize()) {
+		return falseblnr;
+	}
+	StateIO_Begin(p, n, trueblnr);
+	EmulationStateIO();
+#if WantRAMDirtyMap
+	RAMDirty_MarkAll();
+#endif
+#if WantRewind
+	EmulationRewindForget();
+#endif
+	return (0 != StateIO_End());
+}
+
+#endif /* WantSaveStates */
+
+#if WantRewind
+#include "RWNDRING.h"
+#endif
+
 LOCALPROC MainEventLoop(void)
 {
 	for (; ; ) {
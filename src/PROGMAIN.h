@@ -21,5 +21,23 @@
 #define PROGMAIN_H
 #endif
 
+#if WantVarRAMSize
+EXPORTFUNC blnr EmulationSetRAMSize(ui5r n);
+#endif
+EXPORTFUNC ui5r EmulationRAMSize(void);
 EXPORTPROC EmulationReserveAlloc(void);
 EXPORTPROC ProgramMain(void);
+
+#if WantSaveStates
+EXPORTFUNC ui5r EmulationStateSize(void);
+EXPORTPROC EmulationStateSave(ui3p p);
+EXPORTFUNC blnr EmulationStateLoad(ui3p p, ui5r n);
+#endif
+
+#if WantRewind
+EXPORTFUNC ui5r EmulationRewindStates(void);
+EXPORTFUNC blnr EmulationRewind(void);
+EXPORTPROC EmulationRewindForget(void);
+EXPORTPROC EmulationRewindDiskWrite(tDrive Drive_No,
+	ui5r Sony_Start, ui5r Sony_Count);
+#endif
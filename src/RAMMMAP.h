@@ -0,0 +1,311 @@
+/*
+	RAMMMAP.h
+
+	Copyright (C) 2023 Jesús A. Álvarez
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	RAM Memory MAPped
+
+	Included by POSIX OSGLUs when MayMapRAM is set, after
+	PROGMAIN.h. The block from ReserveAllocAll comes from an
+	anonymous mmap instead of calloc, so its pages only take up
+	memory once they are written to. ReserveAllocAll reserves RAM
+	first, so that it starts the block, on a page boundary.
+
+	On top of that, with WantSaveStates, the whole machine can be
+	saved to a snapshot file when quitting, and started from it
+	later instead of booting. The RAM in the file is mapped
+	copy-on-write (MAP_PRIVATE) over RAM rather than read, so any
+	number of instances started from one snapshot share its pages
+	in the page cache, and each only pays for the pages it writes.
+	A snapshot on a tmpfs such as /dev/shm costs no disk at all.
+	The address space map (ATT) and MATC entries keep pointing at
+	RAM, which doesn't move.
+
+	The same disk images must be inserted, in the same order and
+	unchanged since the snapshot was saved, or the Mac boots as
+	usual. Each drive is checked by its size, its modification
+	time, and a hash of its first three and last 512 byte blocks,
+	where HFS and MFS keep the volume header and its copy. So
+	that instances started from one snapshot don't change the
+	images under each other, or under the snapshot, the OSGLU
+	opens the disks copy-on-write when resuming (see DISKMMAP.h),
+	and then doesn't save a snapshot, as the changes to the disks
+	are lost.
+
+	The OSGLU provides:
+
+	RAMSnap_DriveMTime(i)
+		modification time of the image in drive i, with any
+		changes written out first
+
+	Snapshot format (numbers big endian):
+		"vMacSNP2"
+		ui5b RAM size
+		ui5b size of the emulated hardware state
+		ui5b ROM checksum
+		ui5b inserted drives mask
+		ui5b offset of RAM in the file
+		for each drive, all 0 if not inserted:
+			ui5b image size
+			ui5b modification time
+			ui5b hash (32 bit FNV-1a) of the blocks above
+		emulated hardware state
+		zeroes up to the offset, a multiple of kRAMSnapAlign
+		RAM
+*/
+
+#ifdef RAMMMAP_H
+#error "header already included"
+#else
+#define RAMMMAP_H
+#endif
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if ! defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+EXPORTVAR(ui3p, RAM) /* see GLOBGLUE.h */
+
+LOCALVAR uimr RAMMap_BlockSize = 0;
+
+LOCALFUNC ui3p RAMMap_AllocBlock(uimr n)
+{
+	void *p = mmap(NULL, n, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (MAP_FAILED == p) {
+		return nullpr;
+	}
+	RAMMap_BlockSize = n;
+	return (ui3p)p;
+}
+
+LOCALPROC RAMMap_FreeBlock(ui3p p)
+{
+	/* also unmaps a snapshot mapped over RAM */
+	(void) munmap(p, RAMMap_BlockSize);
+}
+
+#if WantSaveStates
+
+/* bigger than any page size in use */
+#define kRAMSnapAlign 0x00010000
+#define RAMSnap_DriveInfoSize 12
+#define RAMSnap_HeaderSize (28 + RAMSnap_DriveInfoSize * NumDrives)
+
+FORWARDFUNC ui5r RAMSnap_DriveMTime(tDrive i);
+
+LOCALFUNC blnr RAMSnap_PWrite(int fd, ui3p p, ui5r n, ui5r offset)
+{
+	return pwrite(fd, p, n, offset) == (ssize_t)n;
+}
+
+LOCALFUNC blnr RAMSnap_PRead(int fd, ui3p p, ui5r n, ui5r offset)
+{
+	return pread(fd, p, n, offset) == (ssize_t)n;
+}
+
+LOCALFUNC ui5r RAMSnap_DriveHash(tDrive i, ui5r size)
+{
+	ui3b block[512];
+	ui5r nblocks = (size + 511) / 512;
+	ui5r h = 2166136261UL;
+	ui5r b;
+	ui5r j;
+	ui5r k;
+	ui5r n;
+
+	for (j = 0; (j < nblocks) && (j < 4); ++j) {
+		b = (j < 3) ? j : (nblocks - 1);
+		n = size - b * 512;
+		if (n > 512) {
+			n = 512;
+		}
+		if (mnvm_noErr != vSonyTransfer(falseblnr, block, i,
+			b * 512, n, nullpr))
+		{
+			return (ui5r) -1;
+		}
+		for (k = 0; k < n; ++k) {
+			h = (h ^ block[k]) * 16777619UL;
+		}
+	}
+	return h & 0xFFFFFFFF;
+}
+
+/* the drive's fingerprint, RAMSnap_DriveInfoSize bytes */
+LOCALPROC RAMSnap_DriveInfo(tDrive i, ui3p p)
+{
+	ui5r size = 0;
+	ui5r mtime = 0;
+	ui5r hash = 0;
+
+	if (! vSonyIsInserted(i)) {
+		/* all 0 */
+	} else if (mnvm_noErr != vSonyGetSize(i, &size)) {
+		size = (ui5r) -1; /* never matches */
+	} else {
+		mtime = RAMSnap_DriveMTime(i);
+		hash = RAMSnap_DriveHash(i, size);
+	}
+	do_put_mem_long(p, size);
+	do_put_mem_long(p + 4, mtime);
+	do_put_mem_long(p + 8, hash);
+}
+
+LOCALFUNC blnr RAMSnap_Save(char *path)
+{
+	ui5r n = EmulationStateSize();
+	ui5r hs = RAMSnap_HeaderSize;
+	ui5r offset = (hs + n + kRAMSnapAlign - 1) & ~ (kRAMSnapAlign - 1);
+	char tmp[FILENAME_MAX];
+	ui3p buff;
+	int fd = -1;
+	tDrive i;
+	blnr IsOk = falseblnr;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+	{
+		return falseblnr;
+	}
+	/* calloc, the padding is part of it */
+	buff = (ui3p)calloc(1, offset);
+	if (NULL != buff) {
+		(void) memcpy(buff, "vMacSNP2", 8);
+		do_put_mem_long(buff + 8, EmulationRAMSize());
+		do_put_mem_long(buff + 12, n);
+		do_put_mem_long(buff + 16, do_get_mem_long(ROM));
+		do_put_mem_long(buff + 20, vSonyInsertedMask);
+		do_put_mem_long(buff + 24, offset);
+		for (i = 0; i < NumDrives; ++i) {
+			RAMSnap_DriveInfo(i,
+				buff + 28 + RAMSnap_DriveInfoSize * i);
+		}
+		EmulationStateSave(buff + hs);
+
+		/*
+			a new file, instances started from the old one
+			still have it mapped
+		*/
+		fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd >= 0) {
+			IsOk = RAMSnap_PWrite(fd, buff, offset, 0)
+				&& RAMSnap_PWrite(fd, RAM, EmulationRAMSize(),
+					offset);
+			IsOk = (0 == close(fd)) && IsOk;
+		}
+		free(buff);
+	}
+
+	if (IsOk) {
+		IsOk = (0 == rename(tmp, path));
+	}
+	if (! IsOk) {
+		(void) unlink(tmp);
+	}
+	return IsOk;
+}
+
+LOCALFUNC blnr RAMSnap_Check(ui3p head, ui5r n)
+{
+	ui3b info[RAMSnap_DriveInfoSize];
+	tDrive i;
+
+	if ((0 != memcmp(head, "vMacSNP2", 8))
+		|| (do_get_mem_long(head + 8) != EmulationRAMSize())
+		|| (do_get_mem_long(head + 12) != n)
+		|| (do_get_mem_long(head + 16) != do_get_mem_long(ROM))
+		|| (do_get_mem_long(head + 20) != vSonyInsertedMask)
+		|| (0 != (do_get_mem_long(head + 24) & (kRAMSnapAlign - 1))))
+	{
+		return falseblnr;
+	}
+	for (i = 0; i < NumDrives; ++i) {
+		RAMSnap_DriveInfo(i, info);
+		if (0 != memcmp(head + 28 + RAMSnap_DriveInfoSize * i, info,
+			RAMSnap_DriveInfoSize))
+		{
+			return falseblnr;
+		}
+	}
+	return trueblnr;
+}
+
+LOCALFUNC blnr RAMSnap_SizeOk(int fd, ui5r offset)
+{
+	/*
+		in a truncated file, mapped pages past the end
+		would fault (SIGBUS) when first touched
+	*/
+	struct stat st;
+
+	return (0 == fstat(fd, &st))
+		&& (st.st_size >= (off_t)offset + EmulationRAMSize());
+}
+
+LOCALFUNC blnr RAMSnap_MapRAM(int fd, ui5r offset)
+{
+	size_t pagemask = sysconf(_SC_PAGESIZE) - 1;
+
+	if ((0 != ((size_t)RAM & pagemask)) || (0 != (offset & pagemask))) {
+		return falseblnr;
+	}
+	return MAP_FAILED != mmap(RAM, EmulationRAMSize(),
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset);
+}
+
+/*
+	Between ticks, after InitEmulation. Returns false if the
+	machine is still as it was reset.
+*/
+LOCALFUNC blnr RAMSnap_Load(char *path)
+{
+	ui5r n = EmulationStateSize();
+	ui5r hs = RAMSnap_HeaderSize;
+	ui3p buff = (ui3p)malloc(hs + n);
+	ui5r offset;
+	int fd = open(path, O_RDONLY);
+	blnr IsOk = falseblnr;
+
+	if ((fd >= 0) && (NULL != buff)
+		&& RAMSnap_PRead(fd, buff, hs + n, 0)
+		&& RAMSnap_Check(buff, n))
+	{
+		/*
+			if this fails half way, RAM is left as it is,
+			the ROM tests and clears it when booting
+		*/
+		offset = do_get_mem_long(buff + 24);
+		if (RAMSnap_SizeOk(fd, offset)
+			&& (RAMSnap_MapRAM(fd, offset)
+				|| RAMSnap_PRead(fd, RAM, EmulationRAMSize(), offset)))
+		{
+			IsOk = EmulationStateLoad(buff + hs, n);
+		}
+	}
+	if (fd >= 0) {
+		(void) close(fd); /* the mapping stays */
+	}
+	free(buff);
+
+	return IsOk;
+}
+
+#endif /* WantSaveStates */
@@ -180,6 +180,27 @@ LOCALVAR const ui3b my_disk_icon[] = {
 };
 #endif
 
+#if UseSonyPatch && Sony_AsyncIO
+LOCALVAR const ui3b sony_async_done[] = {
+/*
+	Completion of an asynchronous Prime, entered like the
+	mount callback, by a psuedo exception with the DCE
+	pointer pushed after the exception frame. Passes the
+	result the emulator left in ioResult of the current
+	request to IODone.
+*/
+0x48, 0xE7, 0xF0, 0xF0, /* movem.l d0-d3/a0-a3,-(sp) */
+0x22, 0x6F, 0x00, 0x20, /* movea.l 32(sp),a1 ; DCE */
+0x20, 0x69, 0x00, 0x08, /* movea.l 8(a1),a0 ; dCtlQHead */
+0x30, 0x28, 0x00, 0x10, /* move.w 16(a0),d0 ; ioResult */
+0x20, 0x78, 0x08, 0xFC, /* movea.l JIODone,a0 */
+0x4E, 0x90,             /* jsr (a0) */
+0x4C, 0xDF, 0x0F, 0x0F, /* movem.l (sp)+,d0-d3/a0-a3 */
+0x58, 0x4F,             /* addq.w #4,sp */
+0x4E, 0x73              /* rte */
+};
+#endif
+
 #if CurEmMd <= kEmMd_Twig43
 #define Sony_DriverBase 0x1836
 #elif CurEmMd <= kEmMd_Twiggy
@@ -196,6 +217,19 @@ LOCALVAR const ui3b my_disk_icon[] = {
 
 #define kVidMem_Base 0x00540000
 
+#if UseSonyPatch
+/* where Sony_Install puts what the driver refers to */
+LOCALPROC Sony_SetAddrs(void)
+{
+	ui5r a = kROM_Base + Sony_DriverBase + sizeof(sony_driver) + 8;
+
+	my_disk_icon_addr = a;
+#if Sony_AsyncIO
+	sony_async_done_addr = a + sizeof(my_disk_icon);
+#endif
+}
+#endif
+
 #if UseSonyPatch
 LOCALPROC Sony_Install(void)
 {
@@ -221,10 +255,15 @@ LOCALPROC Sony_Install(void)
 	do_put_mem_long(pto, kExtn_Block_Base); /* pokeaddr */
 	pto += 4;
 
-	my_disk_icon_addr = (pto - ROM) + kROM_Base;
 	MyMoveBytes((anyp)my_disk_icon, (anyp)pto, sizeof(my_disk_icon));
 	pto += sizeof(my_disk_icon);
 
+#if Sony_AsyncIO
+	MyMoveBytes((anyp)sony_async_done, (anyp)pto,
+		sizeof(sony_async_done));
+	pto += sizeof(sony_async_done);
+#endif
+
 #if UseLargeScreenHack
 	{
 		ui3p patchp = pto;
@@ -272,8 +311,27 @@ LOCALPROC ROMscrambleForMTB(void)
 }
 #endif
 
+#if WantMachinePerThread
+/*
+	Set by an OSGLU that gives all its machines the same ROM
+	image, patched once beforehand (see OSGLUBAT.c), so that
+	it is only read while they run.
+*/
+GLOBALVAR blnr ROM_AlreadyPatched = falseblnr;
+#endif
+
 GLOBALFUNC blnr ROM_Init(void)
 {
+#if UseSonyPatch
+	Sony_SetAddrs();
+#endif
+
+#if WantMachinePerThread
+	if (ROM_AlreadyPatched) {
+		return trueblnr;
+	}
+#endif
+
 #if DisableRomCheck
 
 /* skip the rom checksum */
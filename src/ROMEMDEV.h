@@ -21,3 +21,7 @@
 #endif
 
 EXPORTFUNC blnr ROM_Init(void);
+
+#if WantMachinePerThread
+EXPORTVAR(blnr, ROM_AlreadyPatched)
+#endif
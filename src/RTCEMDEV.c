@@ -515,4 +515,16 @@ GLOBALPROC RTCdataLine_ChangeNtfy(void)
 #endif
 }
 
+#if WantSaveStates
+GLOBALPROC RTC_StateIO(void)
+{
+	/*
+		LastRealDate is kept too, so the clock catches up
+		with the time spent not running.
+	*/
+	StateIO_Var(RTC);
+	StateIO_Var(LastRealDate);
+}
+#endif
+
 #endif /* EmRTC */
@@ -26,3 +26,7 @@ EXPORTPROC RTC_Interrupt(void);
 EXPORTPROC RTCunEnabled_ChangeNtfy(void);
 EXPORTPROC RTCclock_ChangeNtfy(void);
 EXPORTPROC RTCdataLine_ChangeNtfy(void);
+
+#if WantSaveStates
+EXPORTPROC RTC_StateIO(void);
+#endif
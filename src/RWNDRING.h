@@ -0,0 +1,357 @@
+/*
+	RWNDRING.h
+
+	Copyright (C) 2023 Jesús A. Álvarez
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	ReWiND RING
+
+	Included by PROGMAIN.c when WantRewind is set. Every
+	kRewindTicks ticks the machine is captured at the end of the
+	tick, and EmulationRewind goes back to the last capture, then
+	to the one before, for as long as they fit in kRewindBufSize
+	bytes. Older captures are dropped to make room.
+
+	RewindShadow is a copy of RAM as it was at the last capture.
+	Each capture in the ring holds what is needed to get from the
+	next one back to it:
+		the emulated hardware, as saved by EmulationStateIO,
+		what the Mac overwrote on disk since, read just before
+			the write (see EmulationRewindDiskWrite),
+		the previous contents, from RewindShadow, of the pages of
+			RAM written since, found with RAMDirtyMap.
+	The newest capture is still open: disk records are added to
+	it as the Mac writes, and pages when the next one is taken.
+	So capturing only costs copying the dirty pages twice and
+	saving the hardware state.
+
+	Inserting or ejecting a disk can't be undone, so the OSGLU
+	throws everything away (EmulationRewindForget), as does
+	running out of room in the middle of a capture.
+
+	The memory used is kRewindBufSize for the ring plus the size
+	of RAM for RewindShadow. When more than kRewindMaxPages pages
+	are dirty (after the RAM test when booting, or a big read
+	from disk), copying them all in one tick would stall, so
+	instead that many are saved to the open capture each tick
+	until the rest fit, and only then is the next capture taken.
+	A page saved this way may be written and saved again, undoing
+	walks the records backwards, so the oldest copy wins.
+
+	Records, after the hardware state (native endian, each a
+	multiple of 4 bytes):
+		ui5b drive number, or kRwndPage
+		ui5b offset on disk, or page number
+		ui5b byte count
+		data, padded
+		ui5b size of the whole record, to walk back
+*/
+
+#ifdef RWNDRING_H
+#error "header already included"
+#else
+#define RWNDRING_H
+#endif
+
+#if ! (WantSaveStates && WantRAMDirtyMap)
+#error "WantRewind needs WantSaveStates and WantRAMDirtyMap"
+#endif
+
+#ifndef kRewindBufSize
+#define kRewindBufSize 0x00100000
+#endif
+#ifndef kRewindTicks
+#define kRewindTicks 30
+#endif
+#ifndef kRewindMaxStates
+#define kRewindMaxStates 20
+#endif
+#ifndef kRewindMaxPages
+#define kRewindMaxPages 256 /* per tick, copied twice */
+#endif
+
+#define kRwndPage ((ui5b) -1)
+#define kRwndRecHeadSize 12
+#define RwndRound4(n) (((n) + 3) & ~ 3)
+
+LOCALVAR ui3p RewindBuf = nullpr;
+LOCALVAR ui3p RewindShadow = nullpr;
+
+/* closed captures, oldest first, circular */
+LOCALVAR ui5r RewindStart[kRewindMaxStates];
+LOCALVAR ui5r RewindSize[kRewindMaxStates];
+LOCALVAR ui5r RewindFirst = 0;
+LOCALVAR ui5r RewindCount = 0;
+
+LOCALVAR blnr RewindOpenValid = falseblnr;
+LOCALVAR ui5r RewindOpenStart = 0;
+LOCALVAR ui5r RewindOpenSize = 0;
+LOCALVAR ui5r RewindStateSize = 0;
+LOCALVAR ui5r RewindTicks = 0; /* since the open capture */
+LOCALVAR blnr RewindReplaying = falseblnr;
+
+LOCALPROC Rewind_ReserveAlloc(void)
+{
+	ReserveAllocOneBlock(&RewindBuf, kRewindBufSize, 5, falseblnr);
+	ReserveAllocOneBlock(&RewindShadow, kRAM_Size, 5, falseblnr);
+}
+
+GLOBALPROC EmulationRewindForget(void)
+{
+	/*
+		RewindShadow and RAMDirtyMap stay as they are,
+		the next capture starts again from there.
+	*/
+	RewindCount = 0;
+	RewindOpenValid = falseblnr;
+}
+
+LOCALPROC Rewind_DropOldest(void)
+{
+	RewindFirst = (RewindFirst + 1) % kRewindMaxStates;
+	--RewindCount;
+}
+
+LOCALPROC Rewind_MoveOpenToStart(void)
+{
+	/* may overlap, but only moving down */
+	ui5b *src = (ui5b *)(RewindBuf + RewindOpenStart);
+	ui5b *dst = (ui5b *)RewindBuf;
+	ui5r i;
+
+	for (i = RewindOpenSize >> 2; i != 0; --i) {
+		*dst++ = *src++;
+	}
+	RewindOpenStart = 0;
+}
+
+/* room for n more bytes at the end of the open capture */
+LOCALFUNC ui3p Rewind_Reserve(ui5r n)
+{
+	ui5r need = RewindOpenSize + n;
+	ui5r o;
+	ui3p p;
+
+	if (! RewindOpenValid) {
+		return nullpr;
+	}
+	if (need > kRewindBufSize) {
+		/* can't go back past this */
+		EmulationRewindForget();
+		return nullpr;
+	}
+
+	for (; ; ) {
+		if (0 == RewindCount) {
+			if (RewindOpenStart + need > kRewindBufSize) {
+				Rewind_MoveOpenToStart();
+			}
+			break;
+		}
+		o = RewindStart[RewindFirst];
+		if (o >= RewindOpenStart) {
+			/* equal when the ring is full */
+			if (RewindOpenStart + need <= o) {
+				break;
+			}
+		} else if (RewindOpenStart + need <= kRewindBufSize) {
+			break;
+		} else if (need <= o) {
+			Rewind_MoveOpenToStart();
+			break;
+		}
+		Rewind_DropOldest();
+	}
+
+	p = RewindBuf + RewindOpenStart + RewindOpenSize;
+	RewindOpenSize = need;
+
+	return p;
+}
+
+LOCALFUNC ui3p Rewind_AddRecord(ui5r kind, ui5r start, ui5r count)
+{
+	ui5r size = kRwndRecHeadSize + RwndRound4(count) + 4;
+	ui3p p = Rewind_Reserve(size);
+
+	if (nullpr != p) {
+		((ui5b *)p)[0] = kind;
+		((ui5b *)p)[1] = start;
+		((ui5b *)p)[2] = count;
+		*(ui5b *)(p + size - 4) = size;
+		p += kRwndRecHeadSize;
+	}
+
+	return p;
+}
+
+GLOBALPROC EmulationRewindDiskWrite(tDrive Drive_No,
+	ui5r Sony_Start, ui5r Sony_Count)
+{
+	ui3p p;
+
+	if ((! RewindReplaying) && (0 != Sony_Count)) {
+		p = Rewind_AddRecord(Drive_No, Sony_Start, Sony_Count);
+		if (nullpr != p) {
+			if (mnvm_noErr != vSonyTransfer(falseblnr, p, Drive_No,
+				Sony_Start, Sony_Count, nullpr))
+			{
+				EmulationRewindForget();
+			}
+		}
+	}
+}
+
+LOCALPROC Rewind_CopyPage(ui3p src, ui3p dst)
+{
+	MyMoveBytes((anyp)src, (anyp)dst, kRAMDirtyPageSz);
+}
+
+/* up to n dirty pages into the open capture, and clean */
+LOCALPROC Rewind_SavePages(ui5r n)
+{
+	ui5r page;
+	ui3p p;
+
+	for (page = RAMDirty_Next(0); (0 != n) && (page < kRAMDirtyNumPages);
+		page = RAMDirty_Next(page + 1))
+	{
+		ui5r offset = page << ln2RAMDirtyPageSz;
+
+		p = Rewind_AddRecord(kRwndPage, page, kRAMDirtyPageSz);
+		if (nullpr != p) {
+			Rewind_CopyPage(RewindShadow + offset, p);
+		}
+		Rewind_CopyPage(RAM + offset, RewindShadow + offset);
+		RAMDirtyMap[page] = 0;
+		--n;
+	}
+}
+
+LOCALPROC Rewind_Capture(void)
+{
+	ui5r i;
+	ui3p p;
+
+	Rewind_SavePages(kRAMDirtyNumPages);
+
+	if (RewindOpenValid) {
+		if (kRewindMaxStates == RewindCount) {
+			Rewind_DropOldest();
+		}
+		i = (RewindFirst + RewindCount) % kRewindMaxStates;
+		RewindStart[i] = RewindOpenStart;
+		RewindSize[i] = RewindOpenSize;
+		++RewindCount;
+		RewindOpenStart += RewindOpenSize;
+	}
+
+	RewindStateSize = EmulationStateSize();
+	RewindOpenValid = trueblnr;
+	RewindOpenSize = 0;
+	p = Rewind_Reserve(RwndRound4(RewindStateSize));
+	if (nullpr != p) {
+		StateIO_Begin(p, RewindStateSize, falseblnr);
+		EmulationStateIO();
+		(void) StateIO_End();
+	}
+	RewindTicks = 0;
+}
+
+LOCALPROC Rewind_Tick(void)
+{
+	if (++RewindTicks >= kRewindTicks) {
+		if (RAMDirty_Count() > kRewindMaxPages) {
+			/* too much for one tick, try again on the next */
+			Rewind_SavePages(kRewindMaxPages);
+		} else {
+			Rewind_Capture();
+		}
+	}
+}
+
+LOCALPROC Rewind_Undo(ui3p base, ui5r size)
+{
+	ui5r pos = size;
+	ui5r first = RwndRound4(RewindStateSize);
+	ui5b *r;
+
+	RewindReplaying = trueblnr;
+	while (pos > first) {
+		pos -= *(ui5b *)(base + pos - 4);
+		r = (ui5b *)(base + pos);
+		if (kRwndPage == r[0]) {
+			ui5r offset = r[1] << ln2RAMDirtyPageSz;
+
+			Rewind_CopyPage((ui3p)(r + 3), RAM + offset);
+			Rewind_CopyPage((ui3p)(r + 3), RewindShadow + offset);
+		} else {
+			(void) vSonyTransfer(trueblnr, (ui3p)(r + 3), r[0],
+				r[1], r[2], nullpr);
+		}
+	}
+	RewindReplaying = falseblnr;
+
+	StateIO_Begin(base, RewindStateSize, trueblnr);
+	EmulationStateIO();
+	(void) StateIO_End();
+}
+
+GLOBALFUNC ui5r EmulationRewindStates(void)
+{
+	/* how many times EmulationRewind can go back */
+	if (! RewindOpenValid) {
+		return 0;
+	} else if (0 == RewindTicks) {
+		return RewindCount;
+	} else {
+		return RewindCount + 1;
+	}
+}
+
+GLOBALFUNC blnr EmulationRewind(void)
+{
+	ui5r page;
+	ui5r i;
+
+	if (0 == EmulationRewindStates()) {
+		return falseblnr;
+	}
+
+	if (0 == RewindTicks) {
+		/* already there, open the one before */
+		i = (RewindFirst + RewindCount - 1) % kRewindMaxStates;
+		RewindOpenStart = RewindStart[i];
+		RewindOpenSize = RewindSize[i];
+		--RewindCount;
+	}
+
+	/* RAM written since the open capture */
+	for (page = RAMDirty_Next(0); page < kRAMDirtyNumPages;
+		page = RAMDirty_Next(page + 1))
+	{
+		ui5r offset = page << ln2RAMDirtyPageSz;
+
+		Rewind_CopyPage(RewindShadow + offset, RAM + offset);
+	}
+
+	Rewind_Undo(RewindBuf + RewindOpenStart, RewindOpenSize);
+	RewindOpenSize = RwndRound4(RewindStateSize);
+	RewindTicks = 0;
+	(void) RAMDirty_Clear();
+
+	Screen_EndTickNotify();
+
+	return trueblnr;
+}
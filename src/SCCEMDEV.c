@@ -517,7 +517,7 @@ LOCALVAR int ReadModem;
 #endif
 
 #if EmLocalTalk
-static int rx_data_offset = 0;
+LOCALVAR int rx_data_offset = 0;
 	/* when data pending, this is used */
 #endif
 
@@ -2973,3 +2973,10 @@ GLOBALFUNC ui5b SCC_Access(ui5b Data, blnr WriteMem, CPTR addr)
 
 	return Data;
 }
+
+#if WantSaveStates
+GLOBALPROC SCC_StateIO(void)
+{
+	StateIO_Var(SCC);
+}
+#endif
@@ -29,3 +29,7 @@ EXPORTFUNC blnr SCC_InterruptsEnabled(void);
 #if EmLocalTalk
 EXPORTPROC LocalTalkTick(void);
 #endif
+
+#if WantSaveStates
+EXPORTPROC SCC_StateIO(void);
+#endif
@@ -45,6 +45,14 @@
 #define ScrnMapr_Scale 1
 #endif
 
+/*
+	byte offset, in the whole destination screen, of where
+	ScrnMapr_Dst points, when it only holds part of it
+*/
+#ifndef ScrnMapr_DstOrigin
+#define ScrnMapr_DstOrigin 0
+#endif
+
 /* check of parameters */
 
 #if (ScrnMapr_SrcDepth < 0) || (ScrnMapr_SrcDepth > 3)
@@ -98,9 +106,10 @@ LOCALPROC ScrnMapr_DoMap(si4b top, si4b left,
 	ui4r SrcSkip = ScrnMapr_ScrnWB - jn;
 	ui3b *pSrc = ((ui3b *)ScrnMapr_Src)
 		+ leftB + ScrnMapr_ScrnWB * (ui5r)top;
-	ScrnMapr_TranT *pDst = ((ScrnMapr_TranT *)ScrnMapr_Dst)
-		+ ((leftB + ScrnMapr_ScrnWB * ScrnMapr_Scale * (ui5r)top)
-			* ScrnMapr_TranN);
+	ScrnMapr_TranT *pDst = (ScrnMapr_TranT *)(((ui3b *)ScrnMapr_Dst)
+		+ (((leftB + ScrnMapr_ScrnWB * ScrnMapr_Scale * (ui5r)top)
+			* ScrnMapr_TranN << ScrnMapr_TranLn2Sz)
+			- ScrnMapr_DstOrigin));
 	ui5r DstSkip = SrcSkip * ScrnMapr_TranN;
 
 	for (i = bottom - top; --i >= 0; ) {
@@ -166,3 +175,4 @@ LOCALPROC ScrnMapr_DoMap(si4b top, si4b left,
 #undef ScrnMapr_DstDepth
 #undef ScrnMapr_Map
 #undef ScrnMapr_Scale
+#undef ScrnMapr_DstOrigin
@@ -0,0 +1,189 @@
+/*
+	SCRNRCRD.h
+
+	Copyright (C) 2023 Jesús A. Álvarez
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	SCReeN ReCoRDer
+
+	Included by COMOSGLU.h when WantScreenRecord is set. Writes
+	the changed rectangle of each drawn frame, as found by
+	ScreenFindChanges, to a stream that tools/vmrec2png.c
+	converts back into images.
+
+	Stream format (all numbers big endian):
+
+	header:
+		"vMacRec1"
+		ui4b screen width in pixels
+		ui4b screen height in pixels
+
+	frame record:
+		'F'
+		ui5b tick the frame was drawn on
+		ui4b top row, bottom row (exclusive)
+		ui4b left byte, right byte (exclusive)
+		for each row in the rectangle, the row XORed with the
+		previous recorded frame, run length encoded as a
+		sequence of control bytes:
+			0x00-0x7F : (n + 1) zero bytes (row unchanged)
+			0x80-0xFF : (n - 0x7F) literal bytes follow
+		a run never crosses the end of a row.
+
+	end record:
+		'E'
+
+	The previous frame starts as all ones, like
+	screencomparebuff, so the first frame is a full picture.
+	Every later frame only makes sense on top of all the ones
+	before it, and there is no index, so a recording can only be
+	played from the start. Seeking is not supported; decode up to
+	the frame wanted instead, which is cheap.
+
+	The OSGLU must provide ScrnRec_WriteOut, and call
+	ScrnRec_ReserveAlloc from its ReserveAllocAll, ScrnRec_Start
+	once the output is open and ScrnRec_Stop before closing it.
+*/
+
+#ifdef SCRNRCRD_H
+#error "header already included"
+#else
+#define SCRNRCRD_H
+#endif
+
+FORWARDPROC ScrnRec_WriteOut(ui3p p, uimr n);
+
+#define ScrnRecBufferSize 0x8000
+
+/*
+	worst case size of a row, when changed and unchanged bytes
+	alternate: 2 bytes for each changed one, 1 for each unchanged.
+	The buffer is flushed between rows if need be, so a frame
+	may be bigger than it.
+*/
+#define ScrnRecMaxRowSize ((3 * vMacScreenMonoByteWidth + 1) / 2 + 1)
+
+LOCALVAR ui3p ScrnRecPrevBuff = nullpr;
+LOCALVAR ui3p ScrnRecOutBuff = nullpr;
+LOCALVAR uimr ScrnRecOutLen = 0;
+LOCALVAR ui5r ScrnRecTick = 0;
+LOCALVAR blnr ScrnRecActive = falseblnr;
+
+LOCALPROC ScrnRec_ReserveAlloc(void)
+{
+	ReserveAllocOneBlock(&ScrnRecPrevBuff,
+		vMacScreenMonoNumBytes, 5, trueblnr);
+	ReserveAllocOneBlock(&ScrnRecOutBuff,
+		ScrnRecBufferSize, 5, falseblnr);
+}
+
+LOCALPROC ScrnRec_Flush(void)
+{
+	if (0 != ScrnRecOutLen) {
+		ScrnRec_WriteOut(ScrnRecOutBuff, ScrnRecOutLen);
+		ScrnRecOutLen = 0;
+	}
+}
+
+LOCALPROC ScrnRec_PutWord(ui3p p, ui4r v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+LOCALPROC ScrnRec_Start(void)
+{
+	ui3p p = ScrnRecOutBuff;
+
+	MyMoveBytes((anyp)"vMacRec1", (anyp)p, 8);
+	ScrnRec_PutWord(p + 8, vMacScreenWidth);
+	ScrnRec_PutWord(p + 10, vMacScreenHeight);
+	ScrnRecOutLen = 12;
+	ScrnRecActive = trueblnr;
+}
+
+LOCALPROC ScrnRec_Stop(void)
+{
+	if (ScrnRecActive) {
+		ScrnRecOutBuff[ScrnRecOutLen++] = 'E';
+		ScrnRec_Flush();
+		ScrnRecActive = falseblnr;
+	}
+}
+
+LOCALPROC ScrnRec_Frame(ui3p screencurrentbuff,
+	si4b top, si4b left, si4b bottom, si4b right)
+{
+	si4b i;
+	si4b j;
+	ui3p src;
+	ui3p prev;
+	ui3p p;
+	si4b lbyte = left >> 3;
+	si4b rbyte = (right + 7) >> 3;
+
+	if (! ScrnRecActive) {
+		return;
+	}
+	if (ScrnRecOutLen + 13 > ScrnRecBufferSize) {
+		ScrnRec_Flush();
+	}
+
+	p = ScrnRecOutBuff + ScrnRecOutLen;
+	*p++ = 'F';
+	ScrnRec_PutWord(p, ScrnRecTick >> 16);
+	ScrnRec_PutWord(p + 2, ScrnRecTick);
+	ScrnRec_PutWord(p + 4, top);
+	ScrnRec_PutWord(p + 6, bottom);
+	ScrnRec_PutWord(p + 8, lbyte);
+	ScrnRec_PutWord(p + 10, rbyte);
+	p += 12;
+
+	for (i = top; i < bottom; ++i) {
+		if (p - ScrnRecOutBuff + ScrnRecMaxRowSize > ScrnRecBufferSize) {
+			ScrnRecOutLen = p - ScrnRecOutBuff;
+			ScrnRec_Flush();
+			p = ScrnRecOutBuff;
+		}
+		src = screencurrentbuff
+			+ i * vMacScreenMonoByteWidth + lbyte;
+		prev = ScrnRecPrevBuff
+			+ i * vMacScreenMonoByteWidth + lbyte;
+		j = rbyte - lbyte;
+		while (j > 0) {
+			si4b n = 0;
+
+			if (*src == *prev) {
+				do {
+					++src;
+					++prev;
+					++n;
+				} while ((n < j) && (n < 128) && (*src == *prev));
+				*p++ = n - 1;
+			} else {
+				ui3p c = p++;
+
+				do {
+					*p++ = *src ^ *prev;
+					*prev++ = *src++;
+					++n;
+				} while ((n < j) && (n < 128) && (*src != *prev));
+				*c = n + 0x7F;
+			}
+			j -= n;
+		}
+	}
+
+	ScrnRecOutLen = p - ScrnRecOutBuff;
+}
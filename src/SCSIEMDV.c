@@ -20,6 +20,17 @@
 	Emulates the SCSI found in the Mac Plus.
 
 	This code adapted from "SCSI.c" in vMac by Philip Cummins.
+
+	With IncludeSCSIDisks, the NCR 5380 is emulated along with
+	hard disks on the bus: the drives in vSCSIDiskMask, which the
+	Sony driver leaves alone, are the targets with the SCSI ID of
+	their drive number. Blocks are read and written with
+	vSonyTransfer, like the Sony drives, some at a time into a
+	buffer, so a pseudo-DMA (DACK) access only has to take the
+	next byte from the buffer.
+
+	The targets respond at once, so REQ is asserted whenever
+	there is a byte to transfer.
 */
 
 /* NCR5380 chip emulation by Yoav Shadmi, 1998 */
@@ -29,6 +40,8 @@
 
 #include "SCSIEMDV.h"
 
+#if ! IncludeSCSIDisks
+
 #define scsiRd   0x00
 #define scsiWr   0x01
 
@@ -147,3 +160,787 @@ GLOBALFUNC ui5b SCSI_Access(ui5b Data, blnr WriteMem, CPTR addr)
 	}
 	return Data;
 }
+
+#if WantSaveStates
+GLOBALPROC SCSI_StateIO(void)
+{
+	StateIO_Var(SCSI);
+}
+#endif
+
+#else /* IncludeSCSIDisks */
+
+/* NCR 5380 registers */
+
+#define sCDR     0 /* current scsi data register  (r/o) */
+#define sODR     0 /* output data register        (w/o) */
+#define sICR     1 /* initiator command register  (r/w) */
+#define sMR      2 /* mode register               (r/w) */
+#define sTCR     3 /* target command register     (r/w) */
+#define sCSR     4 /* current SCSI bus status     (r/o) */
+#define sSER     4 /* select enable register      (w/o) */
+#define sBSR     5 /* bus and status register     (r/o) */
+#define sDMAtx   5 /* start DMA send              (w/o) */
+#define sIDR     6 /* input data register         (r/o) */
+#define sTDMArx  6 /* start DMA target receive    (w/o) */
+#define sRESET   7 /* reset parity/interrupt      (r/o) */
+#define sIDMArx  7 /* start DMA initiator receive (w/o) */
+
+#define kICR_RST  0x80
+#define kICR_AIP  0x40 /* arbitration in progress (read) */
+#define kICR_LA   0x20 /* lost arbitration (read) */
+#define kICR_ACK  0x10
+#define kICR_BSY  0x08
+#define kICR_SEL  0x04
+#define kICR_ATN  0x02
+#define kICR_DBUS 0x01 /* assert data bus */
+
+#define kMR_DMA   0x02
+#define kMR_ARB   0x01
+
+#define kCSR_RST  0x80
+#define kCSR_BSY  0x40
+#define kCSR_REQ  0x20
+#define kCSR_SEL  0x02
+
+#define kBSR_DRQ  0x40
+#define kBSR_IRQ  0x10
+#define kBSR_PHSM 0x08 /* phase match */
+#define kBSR_ATN  0x02
+#define kBSR_ACK  0x01
+
+/*
+	Bus phases, as the MSG, C/D and I/O lines,
+	the same as in the target command register
+*/
+#define kSCSIPhaseDataOut 0
+#define kSCSIPhaseDataIn  1
+#define kSCSIPhaseCommand 2
+#define kSCSIPhaseStatus  3
+#define kSCSIPhaseMsgOut  6
+#define kSCSIPhaseMsgIn   7
+
+#define kSCSIPhaseIsIn(phase) (0 != ((phase) & 1))
+
+/* status bytes */
+#define kSCSIStatusGood 0x00
+#define kSCSIStatusCheckCondition 0x02
+
+/* sense keys */
+#define kSCSISenseNone 0x00
+#define kSCSISenseNotReady 0x02
+#define kSCSISenseMediumError 0x03
+#define kSCSISenseIllegalRequest 0x05
+#define kSCSISenseDataProtect 0x07
+
+#define kSCSI_DACK 0x08 /* added to the register number by GLOBGLUE */
+#define kSCSI_NumIDs 7
+
+#define kSCSI_ln2BlockSz 9
+#define kSCSI_BufBlocks 16
+#define kSCSI_BufSize (kSCSI_BufBlocks << kSCSI_ln2BlockSz)
+
+/* 5380 registers written by the Mac */
+LOCALVAR ui3r SCSI_ODR;
+LOCALVAR ui3r SCSI_ICR;
+LOCALVAR ui3r SCSI_MR;
+LOCALVAR ui3r SCSI_TCR;
+LOCALVAR blnr SCSI_AIP;
+LOCALVAR blnr SCSI_IRQ;
+
+/* the target that has BSY */
+LOCALVAR blnr SCSI_Connected;
+LOCALVAR blnr SCSI_WaitSelEnd; /* selected, initiator still has SEL */
+LOCALVAR tDrive SCSI_Drive;
+LOCALVAR ui3r SCSI_LUN;
+LOCALVAR ui3r SCSI_Phase;
+LOCALVAR blnr SCSI_REQ;
+LOCALVAR blnr SCSI_AckPending;
+
+/* bytes of the current phase */
+LOCALVAR ui3p SCSI_Ptr;
+LOCALVAR ui5r SCSI_Pos;
+LOCALVAR ui5r SCSI_Len;
+
+LOCALVAR ui3b SCSI_Cmd[12];
+LOCALVAR ui3b SCSI_Msg;
+LOCALVAR ui3b SCSI_StatusByte;
+LOCALVAR ui3b SCSI_Buf[kSCSI_BufSize];
+
+/* read or write command in progress */
+LOCALVAR ui5r SCSI_XferBlock;
+LOCALVAR ui5r SCSI_XferLeft; /* blocks, after the ones in SCSI_Buf */
+LOCALVAR blnr SCSI_XferToDisk;
+
+/* for REQUEST SENSE, from the last command to each target */
+LOCALVAR ui3b SCSI_Sense[kSCSI_NumIDs][3];
+
+LOCALFUNC blnr SCSI_DiskPresent(tDrive Drive_No)
+{
+	return (Drive_No < kSCSI_NumIDs)
+		&& (Drive_No < NumDrives)
+		&& (0 != (vSCSIDiskMask & ((ui5b)1 << Drive_No)))
+		&& vSonyIsInserted(Drive_No);
+}
+
+LOCALPROC SCSI_SetPhase(ui3r phase, ui3p p, ui5r L)
+{
+	SCSI_Phase = phase;
+	SCSI_Ptr = p;
+	SCSI_Pos = 0;
+	SCSI_Len = L;
+	SCSI_REQ = trueblnr;
+	if ((0 != (SCSI_MR & kMR_DMA)) && ((SCSI_TCR & 7) != phase)) {
+		/* phase mismatch ends DMA */
+		SCSI_IRQ = trueblnr;
+	}
+}
+
+LOCALPROC SCSI_Disconnect(void)
+{
+	SCSI_Connected = falseblnr;
+	SCSI_WaitSelEnd = falseblnr;
+	SCSI_REQ = falseblnr;
+	SCSI_AckPending = falseblnr;
+	SCSI_Phase = kSCSIPhaseDataOut;
+	SCSI_Len = 0;
+	SCSI_XferLeft = 0;
+}
+
+LOCALPROC SCSI_StartStatus(void)
+{
+	SCSI_StatusByte = (kSCSISenseNone == SCSI_Sense[SCSI_Drive][0])
+		? kSCSIStatusGood : kSCSIStatusCheckCondition;
+	SCSI_SetPhase(kSCSIPhaseStatus, &SCSI_StatusByte, 1);
+}
+
+LOCALPROC SCSI_Fail(ui3r key, ui3r asc)
+{
+	SCSI_Sense[SCSI_Drive][0] = key;
+	SCSI_Sense[SCSI_Drive][1] = asc;
+	SCSI_Sense[SCSI_Drive][2] = 0;
+	SCSI_XferLeft = 0;
+	SCSI_StartStatus();
+}
+
+LOCALPROC SCSI_ClearBuf(ui5r L)
+{
+	ui5r i;
+
+	for (i = 0; i < L; ++i) {
+		SCSI_Buf[i] = 0;
+	}
+}
+
+/* send L bytes of SCSI_Buf, but no more than the initiator wants */
+LOCALPROC SCSI_DataIn(ui5r L, ui5r AllocLen)
+{
+	if (L > AllocLen) {
+		L = AllocLen;
+	}
+	if (0 == L) {
+		SCSI_StartStatus();
+	} else {
+		SCSI_SetPhase(kSCSIPhaseDataIn, SCSI_Buf, L);
+	}
+}
+
+/* next part of a read or write, one host transfer at a time */
+LOCALPROC SCSI_XferNext(void)
+{
+	ui5r n = SCSI_XferLeft;
+
+	if (n > kSCSI_BufBlocks) {
+		n = kSCSI_BufBlocks;
+	}
+	SCSI_XferLeft -= n;
+	if (SCSI_XferToDisk) {
+		SCSI_SetPhase(kSCSIPhaseDataOut, SCSI_Buf,
+			n << kSCSI_ln2BlockSz);
+	} else if (mnvm_noErr != vSonyTransfer(falseblnr, SCSI_Buf,
+		SCSI_Drive, SCSI_XferBlock << kSCSI_ln2BlockSz,
+		n << kSCSI_ln2BlockSz, nullpr))
+	{
+		SCSI_Fail(kSCSISenseMediumError, 0x11);
+			/* unrecovered read error */
+	} else {
+		SCSI_XferBlock += n;
+		SCSI_SetPhase(kSCSIPhaseDataIn, SCSI_Buf,
+			n << kSCSI_ln2BlockSz);
+	}
+}
+
+LOCALPROC SCSI_StartXfer(ui5r Block, ui5r Count, blnr ToDisk)
+{
+	ui5r Size;
+	ui5r NumBlocks = 0;
+
+	if (mnvm_noErr == vSonyGetSize(SCSI_Drive, &Size)) {
+		NumBlocks = Size >> kSCSI_ln2BlockSz;
+	}
+	if ((Block > NumBlocks) || (Count > NumBlocks - Block)) {
+		SCSI_Fail(kSCSISenseIllegalRequest, 0x21);
+			/* logical block address out of range */
+	} else if (ToDisk
+		&& (0 == (vSonyWritableMask & ((ui5b)1 << SCSI_Drive))))
+	{
+		SCSI_Fail(kSCSISenseDataProtect, 0x27);
+			/* write protected */
+	} else if (0 == Count) {
+		SCSI_StartStatus();
+	} else {
+		SCSI_XferBlock = Block;
+		SCSI_XferLeft = Count;
+		SCSI_XferToDisk = ToDisk;
+		SCSI_XferNext();
+	}
+}
+
+/*
+	Identifies as a drive Apple HD SC Setup knows,
+	so it can initialize a blank image.
+*/
+LOCALVAR const ui3b SCSI_InquiryData[36] = {
+	0x00, /* direct access device */
+	0x00, /* not removable */
+	0x01, /* SCSI-1 */
+	0x01, /* CCS response format */
+	31, 0, 0, 0,
+	'S', 'E', 'A', 'G', 'A', 'T', 'E', ' ',
+	'S', 'T', '2', '2', '5', 'N', ' ', ' ',
+	' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ',
+	'1', '.', '0', ' '
+};
+
+LOCALVAR const ui3b SCSI_ApplePage[24] = {
+	0x30, 22,
+	'A', 'P', 'P', 'L', 'E', ' ', 'C', 'O', 'M', 'P', 'U', 'T',
+	'E', 'R', ',', ' ', 'I', 'N', 'C', ' ', ' ', ' '
+};
+
+/* returns the size of the page, 0 if not supported */
+LOCALFUNC ui5r SCSI_ModePage(ui3r page, ui5r NumBlocks, ui3p p)
+{
+	ui5r cyls = NumBlocks / (8 * 32);
+
+	switch (page) {
+		case 0x01: /* read-write error recovery */
+			p[0] = 0x01;
+			p[1] = 10;
+			return 12;
+		case 0x03: /* format device */
+			p[0] = 0x03;
+			p[1] = 22;
+			do_put_mem_word(p + 10, 32); /* sectors per track */
+			do_put_mem_word(p + 12, 1 << kSCSI_ln2BlockSz);
+			do_put_mem_word(p + 14, 1); /* interleave */
+			return 24;
+		case 0x04: /* rigid disk geometry */
+			p[0] = 0x04;
+			p[1] = 22;
+			p[2] = cyls >> 16;
+			p[3] = cyls >> 8;
+			p[4] = cyls;
+			p[5] = 8; /* heads */
+			return 24;
+		case 0x30:
+			MyMoveBytes((anyp)SCSI_ApplePage, (anyp)p,
+				sizeof(SCSI_ApplePage));
+			return sizeof(SCSI_ApplePage);
+		default:
+			return 0;
+	}
+}
+
+LOCALPROC SCSI_ModeSense(void)
+{
+	ui3r page = SCSI_Cmd[2] & 0x3F;
+	ui5r Size;
+	ui5r NumBlocks = 0;
+	ui5r L = 4;
+	ui5r n;
+	ui3p p = SCSI_Buf;
+
+	if (mnvm_noErr == vSonyGetSize(SCSI_Drive, &Size)) {
+		NumBlocks = Size >> kSCSI_ln2BlockSz;
+	}
+
+	SCSI_ClearBuf(256);
+	if (0 == (vSonyWritableMask & ((ui5b)1 << SCSI_Drive))) {
+		p[2] = 0x80; /* write protected */
+	}
+	if (0 == (SCSI_Cmd[1] & 0x08)) {
+		/* block descriptor */
+		p[3] = 8;
+		p[5] = NumBlocks >> 16;
+		p[6] = NumBlocks >> 8;
+		p[7] = NumBlocks;
+		p[10] = (1 << kSCSI_ln2BlockSz) >> 8;
+		L += 8;
+	}
+	if (0x3F == page) {
+		L += SCSI_ModePage(0x01, NumBlocks, p + L);
+		L += SCSI_ModePage(0x03, NumBlocks, p + L);
+		L += SCSI_ModePage(0x04, NumBlocks, p + L);
+		L += SCSI_ModePage(0x30, NumBlocks, p + L);
+	} else if (0 != (n = SCSI_ModePage(page, NumBlocks, p + L))) {
+		L += n;
+	} else if (0 != page) {
+		SCSI_Fail(kSCSISenseIllegalRequest, 0x24);
+			/* invalid field in CDB */
+		return;
+	}
+	p[0] = L - 1;
+	SCSI_DataIn(L, SCSI_Cmd[4]);
+}
+
+LOCALPROC SCSI_DoCommand(void)
+{
+	ui3p c = SCSI_Cmd;
+	ui3r op = c[0];
+	ui5r Size;
+
+	if (op < 0x20) {
+		SCSI_LUN = c[1] >> 5;
+	}
+
+	if (0x03 == op) {
+		/* REQUEST SENSE */
+		SCSI_ClearBuf(18);
+		SCSI_Buf[0] = 0x70;
+		SCSI_Buf[2] = SCSI_Sense[SCSI_Drive][0];
+		SCSI_Buf[7] = 10;
+		SCSI_Buf[12] = SCSI_Sense[SCSI_Drive][1];
+		SCSI_Buf[13] = SCSI_Sense[SCSI_Drive][2];
+		SCSI_Sense[SCSI_Drive][0] = kSCSISenseNone;
+		SCSI_DataIn(18, (0 == c[4]) ? 4 : c[4]);
+		return;
+	}
+
+	SCSI_Sense[SCSI_Drive][0] = kSCSISenseNone;
+	if (0x12 == op) {
+		/* INQUIRY */
+		MyMoveBytes((anyp)SCSI_InquiryData, (anyp)SCSI_Buf,
+			sizeof(SCSI_InquiryData));
+		if (0 != SCSI_LUN) {
+			SCSI_Buf[0] = 0x7F; /* no such logical unit */
+		}
+		SCSI_DataIn(sizeof(SCSI_InquiryData), c[4]);
+	} else if (0 != SCSI_LUN) {
+		SCSI_Fail(kSCSISenseIllegalRequest, 0x25);
+			/* logical unit not supported */
+	} else if (! SCSI_DiskPresent(SCSI_Drive)) {
+		SCSI_Fail(kSCSISenseNotReady, 0x3A);
+			/* medium not present */
+	} else {
+		switch (op) {
+			case 0x00: /* TEST UNIT READY */
+			case 0x01: /* REZERO UNIT */
+			case 0x04: /* FORMAT UNIT */
+			case 0x0B: /* SEEK(6) */
+			case 0x16: /* RESERVE */
+			case 0x17: /* RELEASE */
+			case 0x1B: /* START STOP UNIT */
+			case 0x1E: /* PREVENT ALLOW MEDIUM REMOVAL */
+			case 0x2B: /* SEEK(10) */
+			case 0x2F: /* VERIFY(10) */
+			case 0x35: /* SYNCHRONIZE CACHE */
+				SCSI_StartStatus();
+				break;
+			case 0x08: /* READ(6) */
+			case 0x0A: /* WRITE(6) */
+				SCSI_StartXfer(
+					((c[1] & 0x1F) << 16) | (c[2] << 8) | c[3],
+					(0 == c[4]) ? 256 : c[4],
+					0x0A == op);
+				break;
+			case 0x28: /* READ(10) */
+			case 0x2A: /* WRITE(10) */
+			case 0x2E: /* WRITE AND VERIFY(10) */
+				SCSI_StartXfer(do_get_mem_long(c + 2),
+					do_get_mem_word(c + 7),
+					0x28 != op);
+				break;
+			case 0x15: /* MODE SELECT(6) */
+				if (0 == c[4]) {
+					SCSI_StartStatus();
+				} else {
+					/* take the parameters, and ignore them */
+					SCSI_XferLeft = 0;
+					SCSI_XferToDisk = falseblnr;
+					SCSI_SetPhase(kSCSIPhaseDataOut, SCSI_Buf, c[4]);
+				}
+				break;
+			case 0x1A: /* MODE SENSE(6) */
+				SCSI_ModeSense();
+				break;
+			case 0x25: /* READ CAPACITY */
+				if (mnvm_noErr != vSonyGetSize(SCSI_Drive, &Size)) {
+					Size = 0;
+				}
+				do_put_mem_long(SCSI_Buf,
+					(Size >> kSCSI_ln2BlockSz) - 1);
+				do_put_mem_long(SCSI_Buf + 4, 1 << kSCSI_ln2BlockSz);
+				SCSI_DataIn(8, 8);
+				break;
+			default:
+				SCSI_Fail(kSCSISenseIllegalRequest, 0x20);
+					/* invalid command operation code */
+				break;
+		}
+	}
+}
+
+LOCALFUNC ui5r SCSI_CmdLen(ui3r op)
+{
+	switch (op >> 5) {
+		case 0:
+			return 6;
+		case 1:
+		case 2:
+			return 10;
+		case 5:
+			return 12;
+		default:
+			return 6;
+	}
+}
+
+LOCALPROC SCSI_PhaseDone(void)
+{
+	switch (SCSI_Phase) {
+		case kSCSIPhaseMsgOut:
+			if (0 != (SCSI_Msg & 0x80)) {
+				/* IDENTIFY */
+				SCSI_LUN = SCSI_Msg & 7;
+			}
+			if (0 != (SCSI_ICR & kICR_ATN)) {
+				SCSI_SetPhase(kSCSIPhaseMsgOut, &SCSI_Msg, 1);
+			} else {
+				SCSI_SetPhase(kSCSIPhaseCommand, SCSI_Cmd, 1);
+			}
+			break;
+		case kSCSIPhaseCommand:
+			if (1 == SCSI_Len) {
+				/* now know how long the command is */
+				SCSI_Len = SCSI_CmdLen(SCSI_Cmd[0]);
+			} else {
+				SCSI_DoCommand();
+			}
+			break;
+		case kSCSIPhaseDataOut:
+			if (SCSI_XferToDisk) {
+				if (mnvm_noErr != vSonyTransfer(trueblnr, SCSI_Buf,
+					SCSI_Drive, SCSI_XferBlock << kSCSI_ln2BlockSz,
+					SCSI_Len, nullpr))
+				{
+					SCSI_Fail(kSCSISenseMediumError, 0x0C);
+						/* write error */
+					break;
+				}
+				SCSI_XferBlock += SCSI_Len >> kSCSI_ln2BlockSz;
+			}
+			if (0 != SCSI_XferLeft) {
+				SCSI_XferNext();
+			} else {
+				SCSI_StartStatus();
+			}
+			break;
+		case kSCSIPhaseDataIn:
+			if (0 != SCSI_XferLeft) {
+				SCSI_XferNext();
+			} else {
+				SCSI_StartStatus();
+			}
+			break;
+		case kSCSIPhaseStatus:
+			SCSI_Msg = 0x00; /* COMMAND COMPLETE */
+			SCSI_SetPhase(kSCSIPhaseMsgIn, &SCSI_Msg, 1);
+			break;
+		case kSCSIPhaseMsgIn:
+		default:
+			SCSI_Disconnect();
+			break;
+	}
+}
+
+LOCALFUNC ui3r SCSI_InByte(void)
+{
+	ui3r v = SCSI_Ptr[SCSI_Pos];
+
+	if (++SCSI_Pos == SCSI_Len) {
+		SCSI_PhaseDone();
+	}
+
+	return v;
+}
+
+LOCALPROC SCSI_OutByte(ui3r v)
+{
+	SCSI_Ptr[SCSI_Pos] = v;
+	if (++SCSI_Pos == SCSI_Len) {
+		SCSI_PhaseDone();
+	}
+}
+
+/* look at what the initiator is doing with the bus */
+LOCALPROC SCSI_Check(void)
+{
+	if (0 != (SCSI_ICR & kICR_RST)) {
+		SCSI_Disconnect();
+		SCSI_MR &= ~ (kMR_DMA | kMR_ARB);
+		SCSI_TCR = 0;
+		SCSI_AIP = falseblnr;
+		SCSI_IRQ = trueblnr;
+		if (0 == vSCSIDiskMask) {
+			/* as when there was no SCSI emulation */
+			put_ram_word(0xb22, get_ram_word(0xb22) | 0x8000);
+		}
+		return;
+	}
+
+	if (! SCSI_Connected) {
+		SCSI_AIP = (0 != (SCSI_MR & kMR_ARB));
+		if ((0 != (SCSI_ICR & kICR_SEL))
+			&& (0 == (SCSI_ICR & kICR_BSY))
+			&& (0 != (SCSI_ICR & kICR_DBUS)))
+		{
+			/* selection, find the target */
+			tDrive i;
+
+			for (i = 0; i < kSCSI_NumIDs; ++i) {
+				if ((0 != (SCSI_ODR & (1 << i)))
+					&& SCSI_DiskPresent(i))
+				{
+					SCSI_Connected = trueblnr;
+					SCSI_WaitSelEnd = trueblnr;
+					SCSI_REQ = falseblnr;
+					SCSI_Drive = i;
+					SCSI_LUN = 0;
+					break;
+				}
+			}
+		}
+	} else if (SCSI_WaitSelEnd) {
+		if (0 == (SCSI_ICR & kICR_SEL)) {
+			SCSI_WaitSelEnd = falseblnr;
+			if (0 != (SCSI_ICR & kICR_ATN)) {
+				SCSI_SetPhase(kSCSIPhaseMsgOut, &SCSI_Msg, 1);
+			} else {
+				SCSI_SetPhase(kSCSIPhaseCommand, SCSI_Cmd, 1);
+			}
+		}
+	} else if (0 != (SCSI_ICR & kICR_ACK)) {
+		if (SCSI_REQ) {
+			/* programmed I/O handshake */
+			if (kSCSIPhaseIsIn(SCSI_Phase)) {
+				(void) SCSI_InByte();
+			} else {
+				SCSI_OutByte(SCSI_ODR);
+			}
+			SCSI_REQ = falseblnr;
+			SCSI_AckPending = trueblnr;
+		}
+	} else if (SCSI_AckPending) {
+		SCSI_AckPending = falseblnr;
+		SCSI_REQ = SCSI_Connected;
+	}
+}
+
+LOCALFUNC blnr SCSI_PhaseMatch(void)
+{
+	return SCSI_Connected && ((SCSI_TCR & 7) == SCSI_Phase);
+}
+
+LOCALFUNC blnr SCSI_DRQ(void)
+{
+	return (0 != (SCSI_MR & kMR_DMA)) && SCSI_REQ && SCSI_PhaseMatch();
+}
+
+LOCALFUNC ui3r SCSI_BusData(void)
+{
+	if (SCSI_Connected && SCSI_REQ && kSCSIPhaseIsIn(SCSI_Phase)) {
+		return SCSI_Ptr[SCSI_Pos];
+	} else if (SCSI_AIP || (0 != (SCSI_ICR & kICR_DBUS))) {
+		return SCSI_ODR;
+	} else {
+		return 0;
+	}
+}
+
+LOCALFUNC ui3r SCSI_Read(CPTR addr)
+{
+	ui3r v;
+
+	switch (addr) {
+		case sCDR:
+		case sIDR:
+			v = SCSI_BusData();
+			break;
+		case sICR:
+			v = (SCSI_ICR & ~ (kICR_AIP | kICR_LA))
+				| (SCSI_AIP ? kICR_AIP : 0);
+			break;
+		case sMR:
+			v = SCSI_MR;
+			break;
+		case sTCR:
+			v = SCSI_TCR;
+			break;
+		case sCSR:
+			v = ((SCSI_ICR & kICR_RST) ? kCSR_RST : 0)
+				| ((SCSI_Connected || SCSI_AIP
+					|| (0 != (SCSI_ICR & kICR_BSY))) ? kCSR_BSY : 0)
+				| ((SCSI_ICR & kICR_SEL) ? kCSR_SEL : 0);
+			if (SCSI_Connected && ! SCSI_WaitSelEnd) {
+				v |= (SCSI_Phase << 2) | (SCSI_REQ ? kCSR_REQ : 0);
+			}
+			break;
+		case sBSR:
+			v = (SCSI_DRQ() ? kBSR_DRQ : 0)
+				| (SCSI_IRQ ? kBSR_IRQ : 0)
+				| (SCSI_PhaseMatch() ? kBSR_PHSM : 0)
+				| ((SCSI_ICR & kICR_ATN) ? kBSR_ATN : 0)
+				| ((SCSI_ICR & kICR_ACK) ? kBSR_ACK : 0);
+			break;
+		case sRESET:
+		default:
+			SCSI_IRQ = falseblnr;
+			v = 0;
+			break;
+	}
+
+	return v;
+}
+
+LOCALPROC SCSI_Write(CPTR addr, ui3r v)
+{
+	switch (addr) {
+		case sODR:
+			SCSI_ODR = v;
+			break;
+		case sICR:
+			SCSI_ICR = v & ~ (kICR_AIP | kICR_LA);
+			break;
+		case sMR:
+			SCSI_MR = v;
+			break;
+		case sTCR:
+			SCSI_TCR = v;
+			break;
+		case sSER:
+			/* no reselection, so nothing to enable */
+			break;
+		case sDMAtx:
+		case sTDMArx:
+		case sIDMArx:
+			/* DMA mode is enough to transfer with DACK */
+			break;
+	}
+	SCSI_Check();
+}
+
+/*
+	Pseudo-DMA: an access with DACK transfers the next byte,
+	without the REQ/ACK handshake. Within a phase that is only
+	taking a byte from, or putting one into, the buffer.
+*/
+
+LOCALFUNC ui3r SCSI_DMARead(void)
+{
+	if (SCSI_DRQ() && kSCSIPhaseIsIn(SCSI_Phase)) {
+		if (SCSI_Pos + 1 < SCSI_Len) {
+			return SCSI_Ptr[SCSI_Pos++];
+		}
+		return SCSI_InByte();
+	}
+	return 0;
+}
+
+LOCALPROC SCSI_DMAWrite(ui3r v)
+{
+	if (SCSI_DRQ() && ! kSCSIPhaseIsIn(SCSI_Phase)) {
+		if (SCSI_Pos + 1 < SCSI_Len) {
+			SCSI_Ptr[SCSI_Pos++] = v;
+		} else {
+			SCSI_OutByte(v);
+		}
+	}
+}
+
+GLOBALPROC SCSI_Reset(void)
+{
+	SCSI_ODR = 0;
+	SCSI_ICR = 0;
+	SCSI_MR = 0;
+	SCSI_TCR = 0;
+	SCSI_AIP = falseblnr;
+	SCSI_IRQ = falseblnr;
+	SCSI_Disconnect();
+}
+
+GLOBALFUNC ui5b SCSI_Access(ui5b Data, blnr WriteMem, CPTR addr)
+{
+	if (0 != (addr & kSCSI_DACK)) {
+		if (WriteMem) {
+			SCSI_DMAWrite(Data);
+		} else {
+			Data = SCSI_DMARead();
+		}
+	} else if (WriteMem) {
+		SCSI_Write(addr & 7, Data);
+	} else {
+		Data = SCSI_Read(addr & 7);
+	}
+	return Data;
+}
+
+#if WantSaveStates
+GLOBALPROC SCSI_StateIO(void)
+{
+	StateIO_Var(SCSI_ODR);
+	StateIO_Var(SCSI_ICR);
+	StateIO_Var(SCSI_MR);
+	StateIO_Var(SCSI_TCR);
+	StateIO_Var(SCSI_AIP);
+	StateIO_Var(SCSI_IRQ);
+	StateIO_Var(SCSI_Connected);
+	StateIO_Var(SCSI_WaitSelEnd);
+	StateIO_Var(SCSI_Drive);
+	StateIO_Var(SCSI_LUN);
+	StateIO_Var(SCSI_Phase);
+	StateIO_Var(SCSI_REQ);
+	StateIO_Var(SCSI_AckPending);
+	StateIO_Var(SCSI_Pos);
+	StateIO_Var(SCSI_Len);
+	StateIO_Var(SCSI_Cmd);
+	StateIO_Var(SCSI_Msg);
+	StateIO_Var(SCSI_StatusByte);
+	StateIO_Var(SCSI_Buf);
+	StateIO_Var(SCSI_XferBlock);
+	StateIO_Var(SCSI_XferLeft);
+	StateIO_Var(SCSI_XferToDisk);
+	StateIO_Var(SCSI_Sense);
+
+	if (StateIO_Loading) {
+		/* each phase always uses the same bytes */
+		switch (SCSI_Phase) {
+			case kSCSIPhaseDataOut:
+			case kSCSIPhaseDataIn:
+				SCSI_Ptr = SCSI_Buf;
+				break;
+			case kSCSIPhaseCommand:
+				SCSI_Ptr = SCSI_Cmd;
+				break;
+			case kSCSIPhaseStatus:
+				SCSI_Ptr = &SCSI_StatusByte;
+				break;
+			default:
+				SCSI_Ptr = &SCSI_Msg;
+				break;
+		}
+	}
+}
+#endif
+
+#endif /* IncludeSCSIDisks */
@@ -23,3 +23,7 @@
 EXPORTPROC SCSI_Reset(void);
 
 EXPORTFUNC ui5b SCSI_Access(ui5b Data, blnr WriteMem, CPTR addr);
+
+#if WantSaveStates
+EXPORTPROC SCSI_StateIO(void);
+#endif
@@ -49,6 +49,9 @@ LOCALFUNC blnr vSonyNextPendingInsert0(tDrive *Drive_No)
 {
 	/* find next drive to Mount */
 	ui5b MountPending = vSonyInsertedMask & (~ vSonyMountedMask);
+#if IncludeSCSIDisks
+	MountPending &= ~ vSCSIDiskMask; /* see SCSIEMDV.c */
+#endif
 	if (MountPending != 0) {
 		tDrive i;
 		for (i = 0; i < NumDrives; ++i) {
@@ -77,6 +80,11 @@ LOCALFUNC tMacErr CheckReadableDrive(tDrive Drive_No)
 	return result;
 }
 
+#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+FORWARDPROC DC42Sums_Written(tDrive Drive_No,
+	ui5r Sony_Start, ui5r Sony_Count);
+#endif
+
 LOCALFUNC tMacErr vSonyTransferVM(blnr IsWrite,
 	CPTR Buffera, tDrive Drive_No,
 	ui5r Sony_Start, ui5r Sony_Count, ui5r *Sony_ActCount)
@@ -112,6 +120,12 @@ label_1:
 		}
 	}
 
+#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+	if (IsWrite) {
+		DC42Sums_Written(Drive_No, Sony_Start, Sony_Count - n);
+	}
+#endif
+
 	if (nullpr != Sony_ActCount) {
 		*Sony_ActCount = Sony_Count - n;
 	}
@@ -171,13 +185,13 @@ LOCALVAR ui5r ImageTagOffset[NumDrives];
 
 #if Sony_SupportDC42 && Sony_WantChecksumsUpdated
 LOCALFUNC tMacErr DC42BlockChecksum(tDrive Drive_No,
-	ui5r Sony_Start, ui5r Sony_Count, ui5r *r)
+	ui5r Sony_Start, ui5r Sony_Count, ui5r sum0, ui5r *r)
 {
 	tMacErr result;
 	ui5r n;
 	ui3b Buffer[ChecksumBlockSize];
 	ui3b *p;
-	ui5b sum = 0;
+	ui5b sum = sum0;
 	ui5r offset = Sony_Start;
 	ui5r remaining = Sony_Count;
 
@@ -216,64 +230,218 @@ LOCALFUNC tMacErr DC42BlockChecksum(tDrive Drive_No,
 #endif
 
 #if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+/*
+	The checksums of a Disk Copy 4.2 image are kept up to date as
+	it is written, rather than found by reading the whole image
+	again when it is ejected.
+
+	Each word is added to the checksum and then the sum is rotated,
+	so the checksum of a region can't be put together from the
+	checksums of its parts. Instead, the table holds the checksum
+	so far at the start of each chunk of the region, and the
+	finished checksum at the end. A write marks the chunks it
+	touches as stale, and Sony_Update recomputes a few stale
+	chunks every tick, first to last. If the checksum at the end
+	of a recomputed chunk comes out as before, the following chunk
+	doesn't need to be recomputed unless it was written too.
+
+	Nothing is read for a disk that is never written. The first
+	write marks every chunk as stale, which fills in the table.
+*/
+
+#define DC42SumMinShift 10 /* ChecksumBlockSize */
+#define DC42SumMaxChunks 1024
+#define DC42SumBytesPerTick 0x4000
+
+struct DC42SumR {
+	ui5r Offset; /* of the region in the image file */
+	ui5r Size;
+	ui3r ChunkShift;
+	ui5r NumChunks;
+	ui5r FirstStale; /* NumChunks if none */
+	blnr Written;
+	ui5b Sum[DC42SumMaxChunks + 1];
+	ui3b Stale[DC42SumMaxChunks];
+};
+typedef struct DC42SumR DC42SumR;
+
 #if Sony_SupportTags
-#define SizeCheckSumsToUpdate 8
+#define DC42SumsPerDrive 2 /* data, then tags */
 #else
-#define SizeCheckSumsToUpdate 4
+#define DC42SumsPerDrive 1
 #endif
+
+LOCALVAR DC42SumR DC42Sums[NumDrives][DC42SumsPerDrive];
+
+LOCALPROC DC42Sum_Init(DC42SumR *r, ui5r Offset, ui5r Size)
+{
+	ui3r shift = DC42SumMinShift;
+
+	while ((Size >> shift) >= DC42SumMaxChunks) {
+		++shift;
+	}
+	r->Offset = Offset;
+	r->Size = Size;
+	r->ChunkShift = shift;
+	r->NumChunks = (Size + ((ui5r)1 << shift) - 1) >> shift;
+	r->FirstStale = r->NumChunks;
+	r->Written = falseblnr;
+	r->Sum[0] = 0;
+}
+
+LOCALPROC DC42Sum_Written(DC42SumR *r, ui5r Start, ui5r Count)
+{
+	ui5r first;
+	ui5r last;
+	ui5r i;
+
+	if ((0 == Count) || (Start + Count <= r->Offset)
+		|| (Start >= r->Offset + r->Size))
+	{
+		/* not in this region */
+		return;
+	}
+
+	if (! r->Written) {
+		r->Written = trueblnr;
+		first = 0;
+		last = r->NumChunks - 1;
+	} else {
+		ui5r end = Start + Count - r->Offset;
+
+		if (end > r->Size) {
+			end = r->Size;
+		}
+		first = (Start > r->Offset) ? (Start - r->Offset) : 0;
+		first >>= r->ChunkShift;
+		last = (end - 1) >> r->ChunkShift;
+	}
+
+	for (i = first; i <= last; ++i) {
+		r->Stale[i] = trueblnr;
+	}
+	if (first < r->FirstStale) {
+		r->FirstStale = first;
+	}
+}
+
+/* recompute up to MaxChunks stale chunks */
+LOCALFUNC tMacErr DC42Sum_Update(tDrive Drive_No, DC42SumR *r,
+	ui5r MaxChunks)
+{
+	tMacErr result = mnvm_noErr;
+	ui5r n = r->NumChunks;
+	ui5r ChunkSize = (ui5r)1 << r->ChunkShift;
+	ui5r i = r->FirstStale;
+	ui5r start;
+	ui5r count;
+	ui5r sum;
+
+	while ((i < n) && (0 != MaxChunks)) {
+		if (r->Stale[i]) {
+			start = i << r->ChunkShift;
+			count = r->Size - start;
+			if (count > ChunkSize) {
+				count = ChunkSize;
+			}
+			result = DC42BlockChecksum(Drive_No,
+				r->Offset + start, count, r->Sum[i], &sum);
+			if (mnvm_noErr != result) {
+				break;
+			}
+			r->Stale[i] = falseblnr;
+			if (sum != r->Sum[i + 1]) {
+				r->Sum[i + 1] = sum;
+				if (i + 1 < n) {
+					r->Stale[i + 1] = trueblnr;
+				}
+			}
+			--MaxChunks;
+		}
+		++i;
+	}
+	while ((i < n) && ! r->Stale[i]) {
+		++i;
+	}
+	r->FirstStale = i;
+
+	return result;
+}
+
+LOCALPROC DC42Sums_Written(tDrive Drive_No,
+	ui5r Sony_Start, ui5r Sony_Count)
+{
+	int j;
+
+	for (j = 0; j < DC42SumsPerDrive; ++j) {
+		DC42Sum_Written(&DC42Sums[Drive_No][j],
+			Sony_Start, Sony_Count);
+	}
+}
+
+LOCALPROC DC42Sums_Idle(void)
+{
+	tDrive i;
+	int j;
+	DC42SumR *r;
+
+	for (i = 0; i < NumDrives; ++i) {
+		if (vSonyIsMounted(i)) {
+			for (j = 0; j < DC42SumsPerDrive; ++j) {
+				r = &DC42Sums[i][j];
+				if (r->FirstStale < r->NumChunks) {
+					ui5r n = DC42SumBytesPerTick >> r->ChunkShift;
+
+					(void) DC42Sum_Update(i, r, (0 == n) ? 1 : n);
+				}
+			}
+		}
+	}
+}
+
+/* finish the checksum, and write it to the header if changed */
+LOCALFUNC blnr DC42Sum_Save(tDrive Drive_No, DC42SumR *r,
+	ui5r HeaderOffset)
+{
+	blnr IsOk = trueblnr;
+	ui3b Buffer[4];
+
+	if (r->Written) {
+		if (mnvm_noErr
+			!= DC42Sum_Update(Drive_No, r, r->NumChunks))
+		{
+			r->Sum[r->NumChunks] = 0;
+			IsOk = falseblnr;
+		}
+		do_put_mem_long(Buffer, r->Sum[r->NumChunks]);
+		(void) vSonyTransfer(trueblnr, Buffer, Drive_No,
+			HeaderOffset, 4, nullpr);
+		r->Written = falseblnr;
+	}
+
+	return IsOk;
+}
 #endif
 
 #if Sony_WantChecksumsUpdated
 LOCALPROC Drive_UpdateChecksums(tDrive Drive_No)
 {
 	if (! vSonyIsLocked(Drive_No)) {
-		ui5r DataOffset = ImageDataOffset[Drive_No];
 #if Sony_SupportDC42
-		if (kDC42offset_userData == DataOffset) {
+		if (kDC42offset_userData == ImageDataOffset[Drive_No]) {
 			/* a disk copy 4.2 image */
-			tMacErr result;
-			ui5r dataChecksum;
-			ui3b Buffer[SizeCheckSumsToUpdate];
-			ui5r Sony_Count = SizeCheckSumsToUpdate;
-			ui5r DataSize = ImageDataSize[Drive_No];
-
-			/* Checksum image data */
-			result = DC42BlockChecksum(Drive_No,
-				DataOffset, DataSize, &dataChecksum);
-			if (mnvm_noErr != result) {
+			if (! DC42Sum_Save(Drive_No, &DC42Sums[Drive_No][0],
+				kDC42offset_dataChecksum))
+			{
 				ReportAbnormalID(0x0902, "Failed to find dataChecksum");
-				dataChecksum = 0;
 			}
-			do_put_mem_long(Buffer, dataChecksum);
 #if Sony_SupportTags
+			if (! DC42Sum_Save(Drive_No, &DC42Sums[Drive_No][1],
+				kDC42offset_tagChecksum))
 			{
-				ui5r tagChecksum;
-				ui5r TagOffset = ImageTagOffset[Drive_No];
-				ui5r TagSize =
-					(0 == TagOffset) ? 0 : ((DataSize >> 9) * 12);
-				if (TagSize < 12) {
-					tagChecksum = 0;
-				} else {
-					/*
-						Checksum of tags doesn't include first block.
-						presumably because of bug in original disk
-						copy program.
-					*/
-					result = DC42BlockChecksum(Drive_No,
-						TagOffset + 12, TagSize - 12, &tagChecksum);
-					if (mnvm_noErr != result) {
-						ReportAbnormalID(0x0903,
-							"Failed to find tagChecksum");
-						tagChecksum = 0;
-					}
-				}
-				do_put_mem_long(Buffer + 4, tagChecksum);
+				ReportAbnormalID(0x0903, "Failed to find tagChecksum");
 			}
 #endif
-
-			/* write Checksums */
-			vSonyTransfer(trueblnr, Buffer, Drive_No,
-				kDC42offset_dataChecksum, Sony_Count, nullpr);
 		}
 #endif
 	}
@@ -361,11 +529,11 @@ LOCALFUNC tMacErr vSonyNextPendingInsert(tDrive *Drive_No)
 								ui5r tagChecksum0 = do_get_mem_long(
 									&Temp[kDC42offset_tagChecksum]);
 								result = DC42BlockChecksum(i,
-									DataOffset0, DataSize0,
+									DataOffset0, DataSize0, 0,
 									&dataChecksum);
 								if (TagSize0 >= 12) {
 									result = DC42BlockChecksum(i,
-										TagOffset0 + 12, TagSize0 - 12,
+										TagOffset0 + 12, TagSize0 - 12, 0,
 										&tagChecksum);
 								} else {
 									tagChecksum = 0;
@@ -453,6 +621,26 @@ LOCALFUNC tMacErr vSonyNextPendingInsert(tDrive *Drive_No)
 				ImageDataSize[i] = DataSize;
 #if Sony_SupportTags
 				ImageTagOffset[i] = TagOffset;
+#endif
+#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+				if (kDC42offset_userData == DataOffset) {
+					DC42Sum_Init(&DC42Sums[i][0], DataOffset, DataSize);
+				} else {
+					DC42Sum_Init(&DC42Sums[i][0], 0, 0);
+				}
+#if Sony_SupportTags
+				if ((0 != TagOffset) && (DataSize >= (2 << 9))) {
+					/*
+						Checksum of tags doesn't include first block.
+						presumably because of bug in original disk
+						copy program.
+					*/
+					DC42Sum_Init(&DC42Sums[i][1], TagOffset + 12,
+						(DataSize >> 9) * 12 - 12);
+				} else {
+					DC42Sum_Init(&DC42Sums[i][1], 0, 0);
+				}
+#endif
 #endif
 
 				*Drive_No = i;
@@ -479,6 +667,10 @@ LOCALVAR CPTR MountCallBack = 0;
 /* This checks to see if a disk (image) has been inserted */
 GLOBALPROC Sony_Update (void)
 {
+#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+	DC42Sums_Idle();
+#endif
+
 	if (DelayUntilNextInsert != 0) {
 		--DelayUntilNextInsert;
 	} else {
@@ -550,6 +742,70 @@ LOCALFUNC tMacErr Drive_Transfer(blnr IsWrite, CPTR Buffera,
 	return result;
 }
 
+#if Sony_AsyncIO
+/*
+	Asynchronous Prime. A large queued read or write returns to
+	the driver as pending (a positive result), and is then done a
+	chunk at a time by kICT_Sony_Async, so emulation continues in
+	between. When it is done, the result is passed to IODone by the
+	sony_async_done code in ROM, entered with a psuedo exception
+	like the mount callback. That ignores the interrupt mask, so
+	it is only done with interrupts enabled, never inside a
+	section the OS has masked, however long that takes.
+
+	The Device Manager only has one request for the driver in
+	progress at a time, so there is at most one pending.
+*/
+
+#define Sony_AsyncMinCount 0x4000
+#define Sony_AsyncChunk 0x2000
+#define Sony_AsyncCycles (130240UL * kMyClockMult * kCycleScale / 8)
+	/* eight chunks per sixtieth of a second */
+
+#define kSonyPrimePending ((tMacErr) 0x0001)
+
+LOCALVAR blnr SonyAsyncPending = falseblnr;
+LOCALVAR blnr SonyAsyncIsWrite;
+LOCALVAR tDrive SonyAsyncDrive;
+LOCALVAR CPTR SonyAsyncBuffer;
+LOCALVAR ui5r SonyAsyncStart;
+LOCALVAR ui5r SonyAsyncCount;
+LOCALVAR ui5r SonyAsyncActCount;
+LOCALVAR tMacErr SonyAsyncResult;
+LOCALVAR CPTR SonyAsyncParamBlk;
+LOCALVAR CPTR SonyAsyncDeviceCtl;
+
+LOCALFUNC blnr Sony_AsyncTransferDone(void)
+{
+	return (mnvm_noErr != SonyAsyncResult)
+		|| (SonyAsyncActCount == SonyAsyncCount);
+}
+
+LOCALPROC Sony_AsyncTransfer(ui5r n)
+{
+	ui5r actual;
+	ui5r left = SonyAsyncCount - SonyAsyncActCount;
+
+	if (n > left) {
+		n = left;
+	}
+	SonyAsyncResult = Drive_Transfer(SonyAsyncIsWrite,
+		SonyAsyncBuffer + SonyAsyncActCount, SonyAsyncDrive,
+		SonyAsyncStart + SonyAsyncActCount, n, &actual);
+	SonyAsyncActCount += actual;
+}
+
+/* finish the transfer now, before the disk goes away */
+LOCALPROC Sony_AsyncFlush(tDrive Drive_No)
+{
+	if (SonyAsyncPending && (SonyAsyncDrive == Drive_No)
+		&& ! Sony_AsyncTransferDone())
+	{
+		Sony_AsyncTransfer(SonyAsyncCount);
+	}
+}
+#endif
+
 LOCALVAR blnr QuitOnEject = falseblnr;
 
 GLOBALPROC Sony_SetQuitOnEject(void)
@@ -563,6 +819,9 @@ LOCALFUNC tMacErr Drive_Eject(tDrive Drive_No)
 
 	result = CheckReadableDrive(Drive_No);
 	if (mnvm_noErr == result) {
+#if Sony_AsyncIO
+		Sony_AsyncFlush(Drive_No);
+#endif
 		vSonyMountedMask &= ~ ((ui5b)1 << Drive_No);
 #if Sony_WantChecksumsUpdated
 		Drive_UpdateChecksums(Drive_No);
@@ -604,6 +863,9 @@ GLOBALPROC Sony_EjectAllDisks(void)
 	vSonyMountedMask = 0;
 	for (i = 0; i < NumDrives; ++i) {
 		if (vSonyIsInserted(i)) {
+#if Sony_AsyncIO
+			Sony_AsyncFlush(i);
+#endif
 #if Sony_WantChecksumsUpdated
 			Drive_UpdateChecksums(i);
 #endif
@@ -617,6 +879,9 @@ GLOBALPROC Sony_Reset(void)
 	DelayUntilNextInsert = 0;
 	QuitOnEject = falseblnr;
 	MountCallBack = 0;
+#if Sony_AsyncIO
+	SonyAsyncPending = falseblnr;
+#endif
 }
 
 /*
@@ -909,6 +1174,7 @@ GLOBALPROC ExtnDisk_Access(CPTR p)
 #define kioActCount   40 /* Actual Number of Bytes obtained */
 #define kioPosMode    44 /* Positioning Mode */
 #define kioPosOffset  46 /* Position Offset */
+#define kioParamSize  50
 
 /* Positioning Modes */
 
@@ -1124,6 +1390,79 @@ label_fail:
 }
 #endif
 
+LOCALPROC Sony_PrimeSetResult(CPTR ParamBlk, tMacErr result,
+	ui5r Sony_ActCount)
+{
+	put_vm_word(ParamBlk + kioResult, result);
+	put_vm_long(ParamBlk + kioActCount, Sony_ActCount);
+
+	if (mnvm_noErr != result) {
+		put_vm_word(0x0142 /* DskErr */, result);
+	}
+}
+
+#if Sony_AsyncIO
+LOCALFUNC blnr Sony_AsyncBegin(blnr IsWrite, CPTR Buffera,
+	tDrive Drive_No, ui5r Sony_Start, ui5r Sony_Count,
+	ui4r IOTrap, CPTR ParamBlk, CPTR DeviceCtl)
+{
+	if ((0 == sony_async_done_addr)
+		|| SonyAsyncPending
+		|| (0 != (IOTrap & 0x0200)) /* immediate */
+		|| (Sony_Count < Sony_AsyncMinCount)
+		|| (0 != GetInterruptMask()))
+	{
+		return falseblnr;
+	}
+
+	SonyAsyncPending = trueblnr;
+	SonyAsyncIsWrite = IsWrite;
+	SonyAsyncDrive = Drive_No;
+	SonyAsyncBuffer = Buffera;
+	SonyAsyncStart = Sony_Start;
+	SonyAsyncCount = Sony_Count;
+	SonyAsyncActCount = 0;
+	SonyAsyncResult = mnvm_noErr;
+	SonyAsyncParamBlk = ParamBlk;
+	SonyAsyncDeviceCtl = DeviceCtl;
+
+	Sony_AsyncTransfer(Sony_AsyncChunk);
+	ICT_add(kICT_Sony_Async, Sony_AsyncCycles);
+
+	return trueblnr;
+}
+
+GLOBALPROC Sony_AsyncTask(void)
+{
+	if (! SonyAsyncPending) {
+		/* cancelled by reset */
+		return;
+	}
+
+	if (! Sony_AsyncTransferDone()) {
+		Sony_AsyncTransfer(Sony_AsyncChunk);
+	} else if (0 == GetInterruptMask()) {
+#if Sony_SupportTags
+		if (mnvm_noErr == SonyAsyncResult) {
+			SonyAsyncResult = Sony_PrimeTags(SonyAsyncDrive,
+				SonyAsyncStart, SonyAsyncCount, SonyAsyncIsWrite);
+		}
+#endif
+		put_vm_long(SonyAsyncDeviceCtl + kdCtlPosition,
+			SonyAsyncStart + SonyAsyncActCount);
+		Sony_PrimeSetResult(SonyAsyncParamBlk, SonyAsyncResult,
+			SonyAsyncActCount);
+		SonyAsyncPending = falseblnr;
+
+		DiskInsertedPsuedoException(sony_async_done_addr,
+			SonyAsyncDeviceCtl);
+		return;
+	}
+
+	ICT_add(kICT_Sony_Async, Sony_AsyncCycles);
+}
+#endif
+
 /* Handles I/O to disks */
 LOCALFUNC tMacErr Sony_Prime(CPTR p)
 {
@@ -1131,11 +1470,21 @@ LOCALFUNC tMacErr Sony_Prime(CPTR p)
 	ui5r Sony_Count;
 	ui5r Sony_Start;
 	ui5r Sony_ActCount = 0;
-	CPTR ParamBlk = get_vm_long(p + ExtnDat_params + 0);
-	CPTR DeviceCtl = get_vm_long(p + ExtnDat_params + 4);
-	tDrive Drive_No = get_vm_word(ParamBlk + kioVRefNum) - 1;
-	ui4r IOTrap = get_vm_word(ParamBlk + kioTrap);
-	CPTR dvl = DriveVarsLocation(Drive_No);
+	CPTR ParamBlk;
+	CPTR DeviceCtl;
+	tDrive Drive_No;
+	ui4r IOTrap;
+	CPTR dvl;
+	ui3b xp[8];
+	ui3b pb[kioParamSize];
+
+	get_vm_block(p + ExtnDat_params, xp, sizeof(xp));
+	ParamBlk = do_get_mem_long(xp + 0);
+	DeviceCtl = do_get_mem_long(xp + 4);
+	get_vm_block(ParamBlk, pb, sizeof(pb));
+	Drive_No = do_get_mem_word(pb + kioVRefNum) - 1;
+	IOTrap = do_get_mem_word(pb + kioTrap);
+	dvl = DriveVarsLocation(Drive_No);
 
 	if (0 == dvl) {
 #if Sony_dolog
@@ -1175,7 +1524,7 @@ LOCALFUNC tMacErr Sony_Prime(CPTR p)
 		}
 
 #if 0
-		ui4r PosMode = get_vm_word(ParamBlk + kioPosMode);
+		ui4r PosMode = do_get_mem_word(pb + kioPosMode);
 
 		if (0 != (PosMode & 64)) {
 #if ExtraAbnormalReports
@@ -1199,7 +1548,7 @@ LOCALFUNC tMacErr Sony_Prime(CPTR p)
 			evidence found in Basilisk II emulator,
 			and disassembly of Mac Plus disk driver.)
 		*/
-		ui5r PosOffset = get_vm_long(ParamBlk + kioPosOffset);
+		ui5r PosOffset = do_get_mem_long(pb + kioPosOffset);
 		switch (PosMode) {
 			case kfsAtMark:
 				Sony_Start = get_vm_long(DeviceCtl + kdCtlPosition);
@@ -1230,7 +1579,7 @@ LOCALFUNC tMacErr Sony_Prime(CPTR p)
 #endif
 		Sony_Start = get_vm_long(DeviceCtl + kdCtlPosition);
 
-		Sony_Count = get_vm_long(ParamBlk + kioReqCount);
+		Sony_Count = do_get_mem_long(pb + kioReqCount);
 
 #if Sony_dolog
 		dbglog_StartLine();
@@ -1256,7 +1605,14 @@ LOCALFUNC tMacErr Sony_Prime(CPTR p)
 		} else if (IsWrite && (get_vm_byte(dvl + kWriteProt) != 0)) {
 			result = mnvm_wPrErr;
 		} else {
-			CPTR Buffera = get_vm_long(ParamBlk + kioBuffer);
+			CPTR Buffera = do_get_mem_long(pb + kioBuffer);
+#if Sony_AsyncIO
+			if (Sony_AsyncBegin(IsWrite, Buffera, Drive_No,
+				Sony_Start, Sony_Count, IOTrap, ParamBlk, DeviceCtl))
+			{
+				return kSonyPrimePending;
+			}
+#endif
 			result = Drive_Transfer(IsWrite, Buffera, Drive_No,
 					Sony_Start, Sony_Count, &Sony_ActCount);
 #if Sony_SupportTags
@@ -1271,12 +1627,7 @@ LOCALFUNC tMacErr Sony_Prime(CPTR p)
 	}
 
 label_fail:
-	put_vm_word(ParamBlk + kioResult, result);
-	put_vm_long(ParamBlk + kioActCount, Sony_ActCount);
-
-	if (mnvm_noErr != result) {
-		put_vm_word(0x0142 /* DskErr */, result);
-	}
+	Sony_PrimeSetResult(ParamBlk, result, Sony_ActCount);
 	return result;
 }
 
@@ -1286,7 +1637,11 @@ LOCALFUNC tMacErr Sony_Control(CPTR p)
 	tMacErr result;
 	CPTR ParamBlk = get_vm_long(p + ExtnDat_params + 0);
 	/* CPTR DeviceCtl = get_vm_long(p + ExtnDat_params + 4); */
-	ui4r OpCode = get_vm_word(ParamBlk + kcsCode);
+	ui4r OpCode;
+	ui3b pb[kcsParam + 4];
+
+	get_vm_block(ParamBlk, pb, sizeof(pb));
+	OpCode = do_get_mem_word(pb + kcsCode);
 
 	if (kKillIO == OpCode) {
 #if Sony_dolog
@@ -1300,7 +1655,7 @@ LOCALFUNC tMacErr Sony_Control(CPTR p)
 #endif
 
 #if Sony_SupportTags
-		TheTagBuffer = get_vm_long(ParamBlk + kcsParam);
+		TheTagBuffer = do_get_mem_long(pb + kcsParam);
 		result = mnvm_noErr;
 #else
 		result = mnvm_controlErr;
@@ -1314,8 +1669,8 @@ LOCALFUNC tMacErr Sony_Control(CPTR p)
 		result = mnvm_controlErr;
 #else
 #if 0
-		ui3r Arg1 = get_vm_byte(ParamBlk + kcsParam);
-		ui3r Arg2 = get_vm_byte(ParamBlk + kcsParam + 1);
+		ui3r Arg1 = do_get_mem_byte(pb + kcsParam);
+		ui3r Arg2 = do_get_mem_byte(pb + kcsParam + 1);
 		if (0 == Arg1) {
 			/* disable track cache */
 		} else {
@@ -1331,7 +1686,7 @@ LOCALFUNC tMacErr Sony_Control(CPTR p)
 			/* not implemented, but pretend we did it */
 #endif
 	} else {
-		tDrive Drive_No = get_vm_word(ParamBlk + kioVRefNum) - 1;
+		tDrive Drive_No = do_get_mem_word(pb + kioVRefNum) - 1;
 		CPTR dvl = DriveVarsLocation(Drive_No);
 
 		if (0 == dvl) {
@@ -1683,3 +2038,42 @@ GLOBALPROC ExtnSony_Access(CPTR p)
 
 	put_vm_word(p + ExtnDat_result, result);
 }
+
+#if WantSaveStates
+/*
+	The drive table itself belongs to the OSGLU, which puts
+	the same images back in the same drives before this is
+	loaded.
+*/
+GLOBALPROC Sony_StateIO(void)
+{
+	StateIO_Var(vSonyMountedMask);
+#if IncludeSonyRawMode
+	StateIO_Var(vSonyRawMode);
+#endif
+	StateIO_Var(ImageDataOffset);
+	StateIO_Var(ImageDataSize);
+#if Sony_SupportTags
+	StateIO_Var(ImageTagOffset);
+	StateIO_Var(TheTagBuffer);
+#endif
+#if Sony_SupportDC42 && Sony_WantChecksumsUpdated
+	StateIO_Var(DC42Sums);
+#endif
+	StateIO_Var(DelayUntilNextInsert);
+	StateIO_Var(MountCallBack);
+#if Sony_AsyncIO
+	StateIO_Var(SonyAsyncPending);
+	StateIO_Var(SonyAsyncIsWrite);
+	StateIO_Var(SonyAsyncDrive);
+	StateIO_Var(SonyAsyncBuffer);
+	StateIO_Var(SonyAsyncStart);
+	StateIO_Var(SonyAsyncCount);
+	StateIO_Var(SonyAsyncActCount);
+	StateIO_Var(SonyAsyncResult);
+	StateIO_Var(SonyAsyncParamBlk);
+	StateIO_Var(SonyAsyncDeviceCtl);
+#endif
+	StateIO_Var(QuitOnEject);
+}
+#endif
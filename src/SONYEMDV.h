@@ -29,3 +29,10 @@ EXPORTPROC Sony_EjectAllDisks(void);
 EXPORTPROC Sony_Reset(void);
 
 EXPORTPROC Sony_Update(void);
+#if Sony_AsyncIO
+EXPORTPROC Sony_AsyncTask(void);
+#endif
+
+#if WantSaveStates
+EXPORTPROC Sony_StateIO(void);
+#endif
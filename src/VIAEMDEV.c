@@ -1253,4 +1253,19 @@ GLOBALPROC VIA1_iCB2_PulseNtfy(void)
 }
 #endif
 
+#if WantSaveStates
+GLOBALPROC VIA1_StateIO(void)
+{
+	StateIO_Var(VIA1_D);
+	StateIO_Var(VIA1_T1_Active);
+	StateIO_Var(VIA1_T2_Active);
+	StateIO_Var(VIA1_T1IntReady);
+	StateIO_Var(VIA1_T1Running);
+	StateIO_Var(VIA1_T1LastTime);
+	StateIO_Var(VIA1_T2Running);
+	StateIO_Var(VIA1_T2C_ShortTime);
+	StateIO_Var(VIA1_T2LastTime);
+}
+#endif
+
 #endif /* EmVIA1 */
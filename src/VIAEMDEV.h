@@ -46,3 +46,7 @@ EXPORTFUNC ui4b VIA1_GetT1InvertTime(void);
 
 EXPORTPROC VIA1_ShiftInData(ui3b v);
 EXPORTFUNC ui3b VIA1_ShiftOutData(void);
+
+#if WantSaveStates
+EXPORTPROC VIA1_StateIO(void);
+#endif
@@ -0,0 +1,225 @@
+/*
+	mkdsz.c
+
+	Copyright (C) 2023 Jesús A. Álvarez
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	Converter for compressed disk images
+	(see src/DSKCMPRS.h for the file format).
+
+	Build on the host:
+		cc -O2 -o mkdsz tools/mkdsz.c
+
+	Compress a disk image, in chunks of 16K by default:
+		mkdsz [-c kilobytes] System.dsk System.dsz
+
+	Get the original image back:
+		mkdsz -d System.dsz System.dsk
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned char ui3b;
+typedef unsigned char *ui3p;
+typedef unsigned int ui3r;
+typedef unsigned int ui5b;
+typedef unsigned int ui5r;
+typedef void *anyp;
+typedef int blnr;
+#define trueblnr 1
+#define falseblnr 0
+#define nullpr NULL
+#define LOCALVAR static
+#define LOCALFUNC static
+#define MyMoveBytes(src, dst, n) memmove((dst), (src), (n))
+
+#define DskCmp_WantEncode 1
+#include "../src/DSKCMPRS.h"
+
+static ui3p ReadWholeFile(const char *path, ui5r *size)
+{
+	FILE *f = fopen(path, "rb");
+	ui3p p = NULL;
+	long n;
+
+	if (NULL == f) {
+		perror(path);
+		return NULL;
+	}
+	if ((0 == fseek(f, 0, SEEK_END)) && ((n = ftell(f)) > 0)
+		&& (0 == fseek(f, 0, SEEK_SET))
+		&& (NULL != (p = malloc(n)))
+		&& (fread(p, 1, n, f) == (size_t)n))
+	{
+		*size = n;
+	} else {
+		fprintf(stderr, "%s: could not read\n", path);
+		free(p);
+		p = NULL;
+	}
+	fclose(f);
+	return p;
+}
+
+static void Put32(ui3p p, ui5r v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static int DoCompress(const char *in, const char *out, ui5r chunk)
+{
+	ui5r size;
+	ui3p image = ReadWholeFile(in, &size);
+	ui5r n;
+	ui5r i;
+	ui5r pos;
+	ui3p file;
+	ui3p check;
+	FILE *f;
+
+	if (NULL == image) {
+		return 1;
+	}
+	n = (size + chunk - 1) / chunk;
+	pos = DskCmp_HeaderSize + (n + 1) * 4;
+	file = malloc(pos + size);
+	check = malloc(chunk);
+	if ((NULL == file) || (NULL == check)) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	memcpy(file, "vMacDSZ1", 8);
+	Put32(file + 8, size);
+	Put32(file + 12, chunk);
+	for (i = 0; i < n; ++i) {
+		ui3p src = image + i * chunk;
+		ui5r len = (i == n - 1) ? size - i * chunk : chunk;
+		ui5r clen = DskCmp_Encode(src, len, file + pos);
+
+		if (0 == clen) {
+			memcpy(file + pos, src, len);
+			clen = len;
+		}
+		if ((! DskCmp_Decode(file + pos, clen, check, len))
+			|| (0 != memcmp(check, src, len)))
+		{
+			fprintf(stderr, "chunk %u does not round trip\n", i);
+			return 1;
+		}
+		Put32(file + DskCmp_HeaderSize + i * 4, pos);
+		pos += clen;
+	}
+	Put32(file + DskCmp_HeaderSize + n * 4, pos);
+
+	f = fopen(out, "wb");
+	if ((NULL == f) || (fwrite(file, 1, pos, f) != pos)
+		|| (0 != fclose(f)))
+	{
+		perror(out);
+		return 1;
+	}
+	printf("%s: %u -> %u bytes (%u%%), %u chunks of %uK\n",
+		out, size, pos, (ui5r)((unsigned long long)pos * 100 / size),
+		n, chunk >> 10);
+	return 0;
+}
+
+static int DoDecompress(const char *in, const char *out)
+{
+	ui5r fsize;
+	ui3p file = ReadWholeFile(in, &fsize);
+	ui5r size;
+	ui5r chunk;
+	ui5r n;
+	ui5r i;
+	ui3p image;
+	FILE *f;
+
+	if (NULL == file) {
+		return 1;
+	}
+	if ((fsize < DskCmp_HeaderSize)
+		|| (! DskCmp_CheckHeader(file, &size, &chunk, &n))
+		|| (fsize < DskCmp_HeaderSize + (n + 1) * 4))
+	{
+		fprintf(stderr, "%s: not a compressed disk image\n", in);
+		return 1;
+	}
+	image = malloc(size);
+	if (NULL == image) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	for (i = 0; i < n; ++i) {
+		ui5r start = DskCmp_Get32(file + DskCmp_HeaderSize + i * 4);
+		ui5r end = DskCmp_Get32(file + DskCmp_HeaderSize + i * 4 + 4);
+		ui5r len = (i == n - 1) ? size - i * chunk : chunk;
+
+		if ((end < start) || (end > fsize)
+			|| (! DskCmp_Decode(file + start, end - start,
+				image + i * chunk, len)))
+		{
+			fprintf(stderr, "%s: chunk %u is corrupt\n", in, i);
+			return 1;
+		}
+	}
+
+	f = fopen(out, "wb");
+	if ((NULL == f) || (fwrite(image, 1, size, f) != size)
+		|| (0 != fclose(f)))
+	{
+		perror(out);
+		return 1;
+	}
+	return 0;
+}
+
+static void Usage(void)
+{
+	fprintf(stderr,
+		"usage: mkdsz [-c kilobytes] image.dsk image.dsz\n"
+		"       mkdsz -d image.dsz image.dsk\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	ui5r chunk = 16 * 1024;
+
+	if ((4 == argc) && (0 == strcmp(argv[1], "-d"))) {
+		return DoDecompress(argv[2], argv[3]);
+	}
+	if ((5 == argc) && (0 == strcmp(argv[1], "-c"))) {
+		chunk = atoi(argv[2]) * 1024;
+		if ((chunk < DskCmp_MinChunkSize)
+			|| (chunk > DskCmp_MaxChunkSize)
+			|| (0 != (chunk & (chunk - 1))))
+		{
+			fprintf(stderr, "chunk size must be 4, 8, 16 or 32\n");
+			return 2;
+		}
+		argv += 2;
+		argc -= 2;
+	}
+	if (3 != argc) {
+		Usage();
+	}
+	return DoCompress(argv[1], argv[2], chunk);
+}
@@ -0,0 +1,355 @@
+/*
+	vmrec2png.c
+
+	Copyright (C) 2023 Jesús A. Álvarez
+
+	You can redistribute this file and/or modify it under the terms
+	of version 2 of the GNU General Public License as published by
+	the Free Software Foundation.  You should have received a copy
+	of the license along with this file; see the file COPYING.
+
+	This file is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	license for more details.
+*/
+
+/*
+	Decoder for screen recordings made with WantScreenRecord
+	(see src/SCRNRCRD.h for the stream format).
+
+	Build on the host:
+		cc -O2 -o vmrec2png tools/vmrec2png.c
+
+	Write one PNG per recorded frame, named by tick:
+		vmrec2png recording.vmr frames/frame
+
+	Frames are decoded in order from the start of the recording,
+	the format has no index to seek with.
+
+	Write raw 8 bit gray frames at the emulated 60.15 Hz to
+	stdout, repeating frames as needed, for a video encoder:
+		vmrec2png -raw recording.vmr | ffmpeg -f rawvideo \
+			-pix_fmt gray -s 400x240 -r 60.15 -i - out.mp4
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned char ui3b;
+typedef unsigned int ui5b;
+
+static FILE *InF;
+static unsigned Width;
+static unsigned Height;
+static unsigned RowBytes;
+static ui3b *Frame;
+
+static int GetByte(void)
+{
+	int c = getc(InF);
+
+	if (EOF == c) {
+		fprintf(stderr, "unexpected end of recording\n");
+		exit(1);
+	}
+	return c;
+}
+
+static unsigned GetWord(void)
+{
+	unsigned v = GetByte() << 8;
+
+	return v | GetByte();
+}
+
+/* --- minimal PNG writer, uncompressed deflate blocks --- */
+
+static ui5b CrcTable[256];
+
+static void InitCrcTable(void)
+{
+	ui5b c;
+	int n;
+	int k;
+
+	for (n = 0; n < 256; n++) {
+		c = (ui5b)n;
+		for (k = 0; k < 8; k++) {
+			c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+		}
+		CrcTable[n] = c;
+	}
+}
+
+static ui5b Crc(ui5b crc, const ui3b *p, size_t n)
+{
+	while (n-- != 0) {
+		crc = CrcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+static void PutLong(ui3b *p, ui5b v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void WriteChunk(FILE *f, const char *type, const ui3b *p, size_t n)
+{
+	ui3b b[4];
+	ui5b crc;
+
+	PutLong(b, (ui5b)n);
+	fwrite(b, 1, 4, f);
+	fwrite(type, 1, 4, f);
+	fwrite(p, 1, n, f);
+	crc = Crc(0xFFFFFFFF, (const ui3b *)type, 4);
+	crc = Crc(crc, p, n) ^ 0xFFFFFFFF;
+	PutLong(b, crc);
+	fwrite(b, 1, 4, f);
+}
+
+static int WritePNG(const char *path)
+{
+	static const ui3b sig[8] =
+		{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	size_t rawlen = (size_t)Height * (RowBytes + 1);
+	size_t nblocks = (rawlen + 65534) / 65535;
+	size_t zlen = 2 + rawlen + 5 * nblocks + 4;
+	ui3b *raw = malloc(rawlen);
+	ui3b *z = malloc(zlen);
+	ui3b ihdr[13];
+	ui3b *p;
+	size_t i;
+	ui5b a = 1;
+	ui5b b = 0;
+	FILE *f;
+
+	if ((NULL == raw) || (NULL == z)) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	/* Mac pixels are 1 for black, PNG gray 1 is white */
+	for (i = 0; i < Height; i++) {
+		size_t j;
+
+		raw[i * (RowBytes + 1)] = 0;
+		for (j = 0; j < RowBytes; j++) {
+			raw[i * (RowBytes + 1) + 1 + j] =
+				~Frame[i * RowBytes + j];
+		}
+	}
+
+	p = z;
+	*p++ = 0x78;
+	*p++ = 0x01;
+	for (i = 0; i < rawlen; i += 65535) {
+		size_t n = rawlen - i;
+
+		if (n > 65535) {
+			n = 65535;
+		}
+		*p++ = (i + n == rawlen) ? 1 : 0;
+		*p++ = n;
+		*p++ = n >> 8;
+		*p++ = ~n;
+		*p++ = (~n) >> 8;
+		memcpy(p, raw + i, n);
+		p += n;
+	}
+	for (i = 0; i < rawlen; i++) {
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	PutLong(p, (b << 16) | a);
+
+	PutLong(ihdr, Width);
+	PutLong(ihdr + 4, Height);
+	ihdr[8] = 1; /* bit depth */
+	ihdr[9] = 0; /* grayscale */
+	ihdr[10] = 0;
+	ihdr[11] = 0;
+	ihdr[12] = 0;
+
+	f = fopen(path, "wb");
+	if (NULL == f) {
+		perror(path);
+		exit(1);
+	}
+	fwrite(sig, 1, 8, f);
+	WriteChunk(f, "IHDR", ihdr, 13);
+	WriteChunk(f, "IDAT", z, zlen);
+	WriteChunk(f, "IEND", NULL, 0);
+	fclose(f);
+
+	free(raw);
+	free(z);
+	return 0;
+}
+
+/* --- raw gray output --- */
+
+static void WriteRaw(unsigned count)
+{
+	static ui3b *row = NULL;
+	unsigned i;
+	unsigned j;
+
+	if (NULL == row) {
+		row = malloc((size_t)Width * Height);
+		if (NULL == row) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+	for (i = 0; i < Height; i++) {
+		for (j = 0; j < Width; j++) {
+			row[i * Width + j] =
+				((Frame[i * RowBytes + (j >> 3)] >> (7 - (j & 7))) & 1)
+					? 0 : 255;
+		}
+	}
+	while (count-- != 0) {
+		fwrite(row, 1, (size_t)Width * Height, stdout);
+	}
+}
+
+/* --- decoding --- */
+
+static void DecodeFrame(void)
+{
+	unsigned top = GetWord();
+	unsigned bottom = GetWord();
+	unsigned left = GetWord();
+	unsigned right = GetWord();
+	unsigned i;
+
+	if ((bottom > Height) || (right > RowBytes)
+		|| (top > bottom) || (left > right))
+	{
+		fprintf(stderr, "bad frame rectangle\n");
+		exit(1);
+	}
+	for (i = top; i < bottom; i++) {
+		ui3b *p = Frame + i * RowBytes + left;
+		unsigned j = right - left;
+
+		while (j > 0) {
+			unsigned c = GetByte();
+			unsigned n;
+
+			if (c < 0x80) {
+				n = c + 1;
+				if (n > j) {
+					goto corrupt;
+				}
+				p += n;
+			} else {
+				n = c - 0x7F;
+				if (n > j) {
+					goto corrupt;
+				}
+				for (c = 0; c < n; c++) {
+					*p++ ^= GetByte();
+				}
+			}
+			j -= n;
+		}
+	}
+	return;
+
+corrupt:
+	fprintf(stderr, "bad run in frame\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	char magic[8];
+	int raw = 0;
+	const char *prefix = "frame";
+	ui5b tick;
+	ui5b lasttick = 0;
+	unsigned nframes = 0;
+	int c;
+
+	if ((argc > 1) && (0 == strcmp(argv[1], "-raw"))) {
+		raw = 1;
+		argv++;
+		argc--;
+	}
+	if ((argc < 2) || (argc > 3) || (raw && (argc > 2))) {
+		fprintf(stderr,
+			"usage: %s recording.vmr [prefix]\n"
+			"       %s -raw recording.vmr > frames.gray\n",
+			argv[0], argv[0]);
+		return 2;
+	}
+	if (argc > 2) {
+		prefix = argv[2];
+	}
+
+	InF = fopen(argv[1], "rb");
+	if (NULL == InF) {
+		perror(argv[1]);
+		return 1;
+	}
+	if ((1 != fread(magic, 8, 1, InF))
+		|| (0 != memcmp(magic, "vMacRec1", 8)))
+	{
+		fprintf(stderr, "%s: not a screen recording\n", argv[1]);
+		return 1;
+	}
+	Width = GetWord();
+	Height = GetWord();
+	RowBytes = Width / 8;
+	Frame = malloc((size_t)RowBytes * Height);
+	if (NULL == Frame) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	memset(Frame, 0xFF, (size_t)RowBytes * Height);
+	InitCrcTable();
+
+	while (EOF != (c = getc(InF))) {
+		if ('E' == c) {
+			break;
+		} else if ('F' != c) {
+			fprintf(stderr, "bad record type 0x%02X\n", c);
+			return 1;
+		}
+		tick = (ui5b)GetWord() << 16;
+		tick |= GetWord();
+		if (raw && (0 != nframes)) {
+			/* previous frame stays up until this tick */
+			WriteRaw(tick - lasttick);
+		}
+		DecodeFrame();
+		if (! raw) {
+			char path[1024];
+
+			snprintf(path, sizeof(path), "%s_%08u.png",
+				prefix, (unsigned)tick);
+			WritePNG(path);
+		}
+		lasttick = tick;
+		nframes++;
+	}
+	if (raw && (0 != nframes)) {
+		WriteRaw(1);
+	}
+	if (EOF == c) {
+		fprintf(stderr, "warning: recording not closed\n");
+	}
+
+	fprintf(stderr, "%u frames, %u ticks\n", nframes,
+		(unsigned)lasttick);
+	fclose(InF);
+	return 0;
+}